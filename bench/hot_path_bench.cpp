@@ -0,0 +1,571 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ *
+ * @Brief   : Microbenchmarks of the per-packet and per-frame hot path
+ *
+ * @Created : 17-Oct-2026
+ *
+ * @Updated : 17-Oct-2026
+ *
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#include "../include/transcoder.hpp"
+#include "../include/latency.hpp"
+#include "../include/logger.hpp"
+#include "../include/media_pool.hpp"
+#include "../include/spsc_queue.hpp"
+#include "../include/motion.hpp"
+#include "../include/frame_converter.hpp"
+#include "pattern.hpp"
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+extern "C" {
+	#include <libswscale/swscale.h>
+}
+
+// One benchmark, run() performs the operation the given number of times and
+// returns false when it cannot run on this machine
+struct BenchCase {
+	std::string name;
+	const char *unit;        // what one iteration handles
+	std::function<bool(size_t)> run;
+};
+
+struct BenchResult {
+	std::string name;
+	const char *unit;
+	size_t iterations;       // per sample
+	double median;           // ns per iteration
+	double min;
+	double deviation;        // median absolute deviation, percent of the median
+};
+
+struct HarnessOptions {
+	const char *filter = NULL;         // substring of the case names to run
+	int repeat = 9;                    // timed samples per case
+	double min_time = 0.2;             // s a sample should take at least
+	int cpu = -1;                      // core to pin the thread to, -1 leaves it free
+	const char *encoder_name = "libx264";   // encodes the packets the decoder and muxer cases use
+	const char *json = NULL;
+	bool list = false;
+};
+
+// Encoded test pattern: one GOP of packets and the parameters to decode or mux
+// them. Encoded by the first (untimed) run of a case that uses it.
+struct Clip {
+	int width;
+	int height;
+	const char *encoder_name;
+	bool encoded;
+	AVCodecParameters *params;           // NULL when the encoder is missing or failed
+	std::vector<AVPacket*> packets;
+};
+
+static void print_usage()
+{
+	printf("USAGE: ./hot_path_bench [options]\n\n"
+	"Options:\n"
+	"  --filter <text>       run only the cases whose name contains the text\n"
+	"  --list                print the case names and exit\n"
+	"  --repeat <n>          timed samples per case, the median is reported (default 9)\n"
+	"  --min-time <ms>       length of one sample, the iteration count is calibrated to it (default 200)\n"
+	"  --cpu <n>             pin the benchmark to this core, steadier numbers on a busy machine\n"
+	"  --codec <name>        encoder of the packets the decode and mux cases use (default libx264)\n"
+	"  --json <file>         also write the results to this file\n");
+}
+
+static int parse_options(int argc, char **argv, HarnessOptions *opts)
+{
+	static const struct option long_options[] = {
+		{"filter",   required_argument, NULL, 'f'},
+		{"list",     no_argument,       NULL, 'L'},
+		{"repeat",   required_argument, NULL, 'r'},
+		{"min-time", required_argument, NULL, 'm'},
+		{"cpu",      required_argument, NULL, 'c'},
+		{"codec",    required_argument, NULL, 'e'},
+		{"json",     required_argument, NULL, 'j'},
+		{"help",     no_argument,       NULL, 'h'},
+		{NULL, 0, NULL, 0}
+	};
+
+	int opt;
+	while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+		switch (opt) {
+		case 'f':
+			opts->filter = optarg;
+			break;
+		case 'L':
+			opts->list = true;
+			break;
+		case 'r':
+			opts->repeat = atoi(optarg);
+			if (opts->repeat < 1) {
+				printf("\nERROR: Repeat count must be at least 1.\n");
+				return -1;
+			}
+			break;
+		case 'm':
+			opts->min_time = atof(optarg) / 1000;
+			break;
+		case 'c':
+			opts->cpu = atoi(optarg);
+			break;
+		case 'e':
+			opts->encoder_name = optarg;
+			break;
+		case 'j':
+			opts->json = optarg;
+			break;
+		default:
+			return -1;
+		}
+	}
+	return optind;
+}
+
+// Grows the iteration count until a sample takes min_time, then times
+// repeat samples of that many iterations. The median and its deviation are
+// what regressions are judged by, a single sample is noise.
+static bool measure(const BenchCase &bench, const HarnessOptions *opts, BenchResult *result)
+{
+	uint64_t min_time = (uint64_t)(opts->min_time * 1e9);
+	size_t iterations = 1;
+
+	// The first pass prepares the inputs and warms caches and pools up
+	if (!bench.run(1))
+		return false;
+	for (;;) {
+		uint64_t start = latency_now();
+		bench.run(iterations);
+		uint64_t elapsed = latency_now() - start;
+		if (elapsed >= min_time)
+			break;
+		double scale = elapsed ? 1.2 * min_time / elapsed : 10;
+		iterations = std::max(iterations + 1, (size_t)(iterations * std::min(scale, 10.0)));
+	}
+
+	std::vector<double> samples;
+	for (int i = 0; i < opts->repeat; ++i) {
+		uint64_t start = latency_now();
+		bench.run(iterations);
+		samples.push_back((double)(latency_now() - start) / iterations);
+	}
+	std::sort(samples.begin(), samples.end());
+	double median = samples[samples.size() / 2];
+
+	std::vector<double> deviations;
+	for (double sample : samples)
+		deviations.push_back(std::fabs(sample - median));
+	std::sort(deviations.begin(), deviations.end());
+
+	*result = BenchResult{bench.name, bench.unit, iterations, median, samples.front(),
+		median > 0 ? deviations[deviations.size() / 2] * 100 / median : 0};
+	return true;
+}
+
+static AVFrame *alloc_picture(int width, int height, enum AVPixelFormat format)
+{
+	AVFrame *frame = av_frame_alloc();
+	frame->width = width;
+	frame->height = height;
+	frame->format = format;
+	if (av_frame_get_buffer(frame, 0) < 0)
+		av_frame_free(&frame);
+	return frame;
+}
+
+// One GOP of the test pattern, the decoder cases loop over it
+static bool clip_ready(Clip *clip)
+{
+	if (clip->encoded)
+		return clip->params != NULL;
+	clip->encoded = true;
+
+	const AVCodec *codec = avcodec_find_encoder_by_name(clip->encoder_name);
+	if (!codec) {
+		log_message(LOG_LEVEL_ERROR, "Encoder %s not found\n", clip->encoder_name);
+		return false;
+	}
+	AVCodecContext *codec_ctx = avcodec_alloc_context3(codec);
+	codec_ctx->width = clip->width;
+	codec_ctx->height = clip->height;
+	codec_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+	codec_ctx->time_base = AVRational{1, 30};
+	codec_ctx->framerate = AVRational{30, 1};
+	codec_ctx->gop_size = encoder_gop_size;
+	codec_ctx->max_b_frames = 0;
+	codec_ctx->thread_count = 1;      // same packets on every run
+	av_opt_set(codec_ctx->priv_data, "preset", "ultrafast", 0);
+
+	AVFrame *frame = alloc_picture(clip->width, clip->height, AV_PIX_FMT_YUV420P);
+	AVPacket *packet = av_packet_alloc();
+	uint32_t seed = 42;
+	int ret = frame ? avcodec_open2(codec_ctx, codec, NULL) : -1;
+
+	for (int i = 0; i <= encoder_gop_size && ret >= 0; ++i) {
+		if (i < encoder_gop_size) {
+			av_frame_make_writable(frame);
+			fill_pattern(frame, i, &seed);
+			frame->pts = i;
+		}
+		ret = avcodec_send_frame(codec_ctx, i < encoder_gop_size ? frame : NULL);
+		while (ret >= 0) {
+			ret = avcodec_receive_packet(codec_ctx, packet);
+			if (ret < 0)
+				break;
+			clip->packets.push_back(av_packet_clone(packet));
+			av_packet_unref(packet);
+		}
+		if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+			ret = 0;
+	}
+	if (ret >= 0 && !clip->packets.empty()) {
+		clip->params = avcodec_parameters_alloc();
+		avcodec_parameters_from_context(clip->params, codec_ctx);
+	}
+	else
+		log_message(LOG_LEVEL_ERROR, "Could not encode the %dp clip with %s\n", clip->height, clip->encoder_name);
+	av_packet_free(&packet);
+	av_frame_free(&frame);
+	avcodec_free_context(&codec_ctx);
+	return clip->params != NULL;
+}
+
+static void free_clip(Clip *clip)
+{
+	for (auto &packet : clip->packets)
+		av_packet_free(&packet);
+	clip->packets.clear();
+	avcodec_parameters_free(&clip->params);
+}
+
+// Timestamp handling every demuxed and encoded packet goes through
+static void add_packet_cases(std::vector<BenchCase> &cases)
+{
+	cases.push_back({"packet/rescale_ts", "packet", [](size_t iterations) {
+		static AVPacket *packet = av_packet_alloc();
+		for (size_t i = 0; i < iterations; ++i) {
+			packet->pts = packet->dts = (int64_t)i * 3000;
+			packet->duration = 3000;
+			av_packet_rescale_ts(packet, AVRational{1, 90000}, AVRational{1, 15360});
+		}
+		return true;
+	}});
+	cases.push_back({"packet/rebase", "packet", [](size_t iterations) {
+		static AVPacket *packet = av_packet_alloc();
+		OutputUtils out_state = {};
+		out_state.copy_ts_offset = AV_NOPTS_VALUE;
+		packet->flags = AV_PKT_FLAG_KEY;
+		for (size_t i = 0; i < iterations; ++i) {
+			packet->pts = packet->dts = 900000 + (int64_t)i * 3000;
+			rebase_packet(NULL, &out_state, packet);
+		}
+		return true;
+	}});
+	cases.push_back({"packet/pool_get_put", "packet", [](size_t iterations) {
+		static PacketPool pool(64);
+		for (size_t i = 0; i < iterations; ++i)
+			pool.put(pool.get());
+		return true;
+	}});
+	cases.push_back({"packet/spsc_push_pop", "packet", [](size_t iterations) {
+		static SpscQueue<AVPacket*> queue(256);
+		AVPacket *packet = NULL;
+		for (size_t i = 0; i < iterations; ++i) {
+			queue.try_push(packet);
+			queue.try_pop(packet);
+		}
+		return true;
+	}});
+	cases.push_back({"latency/record", "sample", [](size_t iterations) {
+		static LatencyHistogram histogram;
+		for (size_t i = 0; i < iterations; ++i)
+			histogram.record(1000 + (i & 0xffff) * 37);
+		return true;
+	}});
+}
+
+// write_packet() into an MPEG-TS muxer writing to /dev/null: rescaling,
+// the DTS check, interleaving and muxing, without a disk in the way
+static void add_mux_case(std::vector<BenchCase> &cases, Clip *clip)
+{
+	char name[64];
+	snprintf(name, sizeof(name), "mux/write_packet_mpegts_%dp", clip->height);
+	cases.push_back({name, "packet", [clip](size_t iterations) {
+		OutputUtils out_state = {};
+		if (!clip_ready(clip) || setup_output_stream(&out_state, "hot_path_bench.ts") != 0)
+			return false;
+		avcodec_parameters_copy(out_state.output_stream->codecpar, clip->params);
+		out_state.output_stream->time_base = AVRational{1, 90000};
+		out_state.packet_time_base = AVRational{1, 90000};
+		if (open_output_stream(&out_state, "/dev/null") != 0) {
+			avformat_free_context(out_state.output_fmt_ctx);
+			return false;
+		}
+		AVPacket *packet = av_packet_alloc();
+		for (size_t i = 0; i < iterations; ++i) {
+			av_packet_ref(packet, clip->packets[i % clip->packets.size()]);
+			packet->pts = packet->dts = (int64_t)i * 3000;
+			packet->duration = 3000;
+			write_packet(&out_state, packet);
+			av_packet_unref(packet);
+		}
+		av_packet_free(&packet);
+		close_output_stream(&out_state);
+		return true;
+	}});
+}
+
+// setup_decoder() on the clip, single threaded, one iteration sends a
+// packet and receives its frame. The clip restarts on its keyframe.
+static void add_decode_case(std::vector<BenchCase> &cases, Clip *clip)
+{
+	const AVCodec *encoder = avcodec_find_encoder_by_name(clip->encoder_name);
+	char name[64];
+	snprintf(name, sizeof(name), "decode/%s_%dp", encoder ? avcodec_get_name(encoder->id) : clip->encoder_name, clip->height);
+	cases.push_back({name, "frame", [clip](size_t iterations) {
+		if (!clip_ready(clip))
+			return false;
+		InputUtils in_state = {};
+		in_state.input_codec_params = clip->params;
+		in_state.input_codec = avcodec_find_decoder(clip->params->codec_id);
+		if (!in_state.input_codec || setup_decoder(&in_state, 1, AVDISCARD_DEFAULT) != 0) {
+			avcodec_free_context(&in_state.input_codec_ctx);
+			frame_buffer_pool_free(&in_state.frame_buffer_pool);
+			return false;
+		}
+		AVFrame *frame = av_frame_alloc();
+		for (size_t i = 0; i < iterations; ++i) {
+			size_t index = i % clip->packets.size();
+			if (index == 0 && i > 0)
+				avcodec_flush_buffers(in_state.input_codec_ctx);
+			avcodec_send_packet(in_state.input_codec_ctx, clip->packets[index]);
+			while (avcodec_receive_frame(in_state.input_codec_ctx, frame) >= 0)
+				av_frame_unref(frame);
+		}
+		av_frame_free(&frame);
+		avcodec_free_context(&in_state.input_codec_ctx);
+		frame_buffer_pool_free(&in_state.frame_buffer_pool);
+		return true;
+	}});
+}
+
+// libswscale conversions of a 1080p decoded picture: the pixel format change
+// hardware encoders want and the downscale of a preview rendition
+static void add_convert_cases(std::vector<BenchCase> &cases)
+{
+	struct Conversion {
+		const char *name;
+		int width;
+		int height;
+		enum AVPixelFormat format;
+	};
+	static const Conversion conversions[] = {
+		{"convert/yuv420p_to_nv12_1080p", 1920, 1080, AV_PIX_FMT_NV12},
+		{"convert/scale_1080p_to_720p", 1280, 720, AV_PIX_FMT_YUV420P},
+		{"convert/scale_1080p_to_360p", 640, 360, AV_PIX_FMT_YUV420P},
+	};
+	for (const Conversion &conversion : conversions) {
+		const Conversion *target = &conversion;
+		cases.push_back({conversion.name, "frame", [target](size_t iterations) {
+			AVFrame *source = alloc_picture(1920, 1080, AV_PIX_FMT_YUV420P);
+			AVFrame *output = alloc_picture(target->width, target->height, target->format);
+			struct SwsContext *sws = sws_getContext(1920, 1080, AV_PIX_FMT_YUV420P,
+				target->width, target->height, target->format, SWS_BILINEAR, NULL, NULL, NULL);
+			bool ok = source && output && sws;
+			if (ok) {
+				uint32_t seed = 42;
+				fill_pattern(source, 0, &seed);
+				for (size_t i = 0; i < iterations; ++i)
+					sws_scale(sws, source->data, source->linesize, 0, source->height, output->data, output->linesize);
+			}
+			sws_freeContext(sws);
+			av_frame_free(&output);
+			av_frame_free(&source);
+			return ok;
+		}});
+	}
+}
+
+// The conversion stage ahead of the encoder, per resolution: nv12 and
+// yuvj422p camera frames to the yuv420p of libx264 on one slice thread and on
+// every core, and a frame that already matches and skips the stage
+static void add_converter_cases(std::vector<BenchCase> &cases)
+{
+	struct Source {
+		const char *name;
+		enum AVPixelFormat format;
+		int threads;
+	};
+	static const Source sources[] = {
+		{"nv12_1t", AV_PIX_FMT_NV12, 1},
+		{"nv12_mt", AV_PIX_FMT_NV12, 0},
+		{"yuvj422p_mt", AV_PIX_FMT_YUVJ422P, 0},
+		{"passthrough", AV_PIX_FMT_YUV420P, 0},
+	};
+	static const int sizes[][2] = {{640, 360}, {1280, 720}, {1920, 1080}};
+	for (auto &size : sizes) {
+		for (const Source &source : sources) {
+			int width = size[0], height = size[1];
+			const Source *input = &source;
+			std::string name = std::string("convert/stage_") + source.name + "_" + std::to_string(height) + "p";
+			cases.push_back({name, "frame", [input, width, height](size_t iterations) {
+				AVCodecContext *codec_ctx = avcodec_alloc_context3(NULL);
+				AVFrame *frame = alloc_picture(width, height, input->format);
+				AVFrame *output = av_frame_alloc();
+				FrameConverter converter(input->threads);
+				bool ok = codec_ctx && frame && output;
+				if (ok) {
+					codec_ctx->width = width;
+					codec_ctx->height = height;
+					codec_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+					uint32_t seed = 42;
+					fill_pattern(frame, 0, &seed);
+					// As the pipeline does: only frames that need it are converted
+					for (size_t i = 0; i < iterations && ok; ++i) {
+						if (frame_converter_needed(frame, codec_ctx))
+							ok = frame_convert(&converter, codec_ctx, frame, output) >= 0;
+						else
+							frame_converter_pass(&converter, codec_ctx);
+						av_frame_unref(output);
+					}
+				}
+				av_frame_free(&output);
+				av_frame_free(&frame);
+				avcodec_free_context(&codec_ctx);
+				return ok;
+			}});
+		}
+	}
+}
+
+// SIMD kernels and their scalar reference on a 1080p luma plane
+static void add_kernel_cases(std::vector<BenchCase> &cases)
+{
+	struct Kernel {
+		const char *name;
+		MotionSadFunc sad;
+	};
+	std::vector<Kernel> kernels = {{"simd/motion_sad_scalar_1080p", motion_sad_scalar}};
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2"))
+		kernels.push_back({"simd/motion_sad_sse2_1080p", motion_sad_sse2});
+	if (__builtin_cpu_supports("avx2"))
+		kernels.push_back({"simd/motion_sad_avx2_1080p", motion_sad_avx2});
+#endif
+
+	for (const Kernel &kernel : kernels) {
+		MotionSadFunc sad = kernel.sad;
+		cases.push_back({kernel.name, "frame", [sad](size_t iterations) {
+			const int width = 1920, height = 1080;
+			const int block_cols = width / MOTION_BLOCK_WIDTH;
+			std::vector<uint8_t> a((size_t)width * height), b((size_t)width * height);
+			std::vector<uint32_t> block_sad((size_t)block_cols * (height / MOTION_BLOCK_HEIGHT + 1));
+			uint32_t seed = 42;
+			for (size_t i = 0; i < a.size(); ++i) {
+				seed ^= seed << 13;
+				seed ^= seed >> 17;
+				seed ^= seed << 5;
+				a[i] = seed & 0xff;
+				b[i] = a[i] ^ ((seed >> 8) & 0x0f);
+			}
+			for (size_t i = 0; i < iterations; ++i)
+				for (int y = 0; y < height; y += MOTION_ROW_STEP)
+					sad(&a[(size_t)y * width], &b[(size_t)y * width], block_cols,
+						&block_sad[(size_t)(y / MOTION_BLOCK_HEIGHT) * block_cols]);
+			return true;
+		}});
+	}
+}
+
+static void write_json(const char *filename, const std::vector<BenchResult> &results)
+{
+	FILE *file = fopen(filename, "w");
+	if (!file) {
+		fprintf(stderr, "Could not open %s\n", filename);
+		return;
+	}
+	fprintf(file, "{\n  \"ffmpeg\": \"%s\",\n  \"results\": [", av_version_info());
+	for (size_t i = 0; i < results.size(); ++i) {
+		const BenchResult &result = results[i];
+		fprintf(file, "%s\n    {\"name\": \"%s\", \"unit\": \"%s\", \"iterations\": %zu, "
+			"\"median_ns\": %.1f, \"min_ns\": %.1f, \"deviation_pct\": %.2f}",
+			i ? "," : "", result.name.c_str(), result.unit, result.iterations,
+			result.median, result.min, result.deviation);
+	}
+	fputs("\n  ]\n}\n", file);
+	fclose(file);
+}
+
+int main(int argc, char **argv)
+{
+	HarnessOptions opts;
+	if (parse_options(argc, argv, &opts) != argc) {
+		print_usage();
+		return 1;
+	}
+	log_init(LOG_LEVEL_ERROR);
+
+	if (opts.cpu >= 0) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(opts.cpu, &set);
+		if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+			log_message(LOG_LEVEL_ERROR, "Could not pin to core %d\n", opts.cpu);
+	}
+
+	// One clip per resolution, the muxer only needs one of them
+	std::vector<std::unique_ptr<Clip>> clips;
+	const int sizes[][2] = {{640, 360}, {1280, 720}, {1920, 1080}};
+	for (auto &size : sizes)
+		clips.emplace_back(new Clip{size[0], size[1], opts.encoder_name, false, NULL, {}});
+
+	std::vector<BenchCase> cases;
+	add_packet_cases(cases);
+	add_mux_case(cases, clips[1].get());
+	for (auto &clip : clips)
+		add_decode_case(cases, clip.get());
+	add_convert_cases(cases);
+	add_converter_cases(cases);
+	add_kernel_cases(cases);
+
+	if (opts.list) {
+		for (const BenchCase &bench : cases)
+			printf("%s\n", bench.name.c_str());
+		return 0;
+	}
+
+	printf("%-34s %12s %12s %8s %12s\n", "case", "median ns", "min ns", "+/- %", "iterations");
+	std::vector<BenchResult> results;
+	for (const BenchCase &bench : cases) {
+		if (opts.filter && bench.name.find(opts.filter) == std::string::npos)
+			continue;
+		BenchResult result;
+		if (!measure(bench, &opts, &result)) {
+			printf("%-34s skipped, see the error above\n", bench.name.c_str());
+			continue;
+		}
+		printf("%-34s %12.1f %12.1f %8.2f %12zu  per %s\n", result.name.c_str(), result.median, result.min,
+			result.deviation, result.iterations, result.unit);
+		fflush(stdout);
+		results.push_back(result);
+	}
+	if (opts.json)
+		write_json(opts.json, results);
+
+	for (auto &clip : clips)
+		free_clip(clip.get());
+	return 0;
+}
@@ -0,0 +1,100 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Throughput of the motion detection SAD kernels
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#include "../include/motion.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+// Runs the kernel over the compared rows of a frame the way MotionDetector does
+static void sad_frame(MotionSadFunc sad, const std::vector<uint8_t> &a, const std::vector<uint8_t> &b,
+		int width, int height, std::vector<uint32_t> &block_sad)
+{
+	int block_cols = width / MOTION_BLOCK_WIDTH;
+	int block_rows = height / MOTION_BLOCK_HEIGHT;
+
+	std::fill(block_sad.begin(), block_sad.end(), 0);
+	for (int block_row = 0; block_row < block_rows; ++block_row)
+		for (int y = 0; y < MOTION_BLOCK_HEIGHT; y += MOTION_ROW_STEP) {
+			size_t offset = (size_t)(block_row * MOTION_BLOCK_HEIGHT + y) * width;
+			sad(&a[offset], &b[offset], block_cols, &block_sad[block_row * block_cols]);
+		}
+}
+
+int main(int argc, char **argv)
+{
+	int width = argc > 1 ? atoi(argv[1]) : 1920;
+	int height = argc > 2 ? atoi(argv[2]) : 1080;
+	int iterations = argc > 3 ? atoi(argv[3]) : 2000;
+
+	if (width < MOTION_BLOCK_WIDTH || height < MOTION_BLOCK_HEIGHT || iterations < 1) {
+		printf("USAGE: ./motion_bench [width] [height] [iterations]\n");
+		return 1;
+	}
+
+	// Two frames of noise, the second one differs by a few levels everywhere
+	std::mt19937 random(42);
+	std::vector<uint8_t> a((size_t)width * height), b((size_t)width * height);
+	for (size_t i = 0; i < a.size(); ++i) {
+		a[i] = random() & 0xff;
+		b[i] = a[i] ^ (random() & 0x0f);
+	}
+
+	struct Kernel {
+		const char *name;
+		MotionSadFunc sad;
+	};
+	std::vector<Kernel> kernels = {{"scalar", motion_sad_scalar}};
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2"))
+		kernels.push_back({"sse2", motion_sad_sse2});
+	if (__builtin_cpu_supports("avx2"))
+		kernels.push_back({"avx2", motion_sad_avx2});
+#endif
+
+	size_t blocks = (size_t)(width / MOTION_BLOCK_WIDTH) * (height / MOTION_BLOCK_HEIGHT);
+	std::vector<uint32_t> expected(blocks), block_sad(blocks);
+	sad_frame(motion_sad_scalar, a, b, width, height, expected);
+
+	// Bytes read per frame: both compared rows
+	double bytes = 2.0 * (width / MOTION_BLOCK_WIDTH * MOTION_BLOCK_WIDTH) *
+		(height / MOTION_BLOCK_HEIGHT * MOTION_BLOCK_HEIGHT / MOTION_ROW_STEP);
+	const char *best;
+	motion_sad_best(&best);
+
+	printf("%dx%d, %d iterations, runtime choice: %s\n\n", width, height, iterations, best);
+	printf("%-8s %12s %10s %8s\n", "kernel", "us/frame", "GB/s", "speedup");
+
+	double scalar_time = 0;
+	int failed = 0;
+	for (auto &kernel : kernels) {
+		sad_frame(kernel.sad, a, b, width, height, block_sad);
+		if (block_sad != expected) {
+			printf("%-8s result differs from scalar\n", kernel.name);
+			failed = 1;
+			continue;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations; ++i)
+			sad_frame(kernel.sad, a, b, width, height, block_sad);
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		double per_frame = elapsed.count() / iterations;
+		if (kernel.sad == motion_sad_scalar)
+			scalar_time = per_frame;
+		printf("%-8s %12.1f %10.2f %7.1fx\n", kernel.name, per_frame * 1e6, bytes / per_frame / 1e9, scalar_time / per_frame);
+	}
+	return failed;
+}
@@ -0,0 +1,59 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ *
+ * @Brief   : Synthetic test picture shared by the benchmarks
+ *
+ * @Created : 17-Oct-2026
+ *
+ * @Updated : 17-Oct-2026
+ *
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#ifndef pattern_hpp
+#define pattern_hpp
+
+#include <cstddef>
+#include <cstdint>
+extern "C" {
+	#include <libavutil/frame.h>
+	#include <libavutil/imgutils.h>
+	#include <libavutil/pixdesc.h>
+}
+
+// Luma gradient and a box moving across a planar or semi-planar YUV
+// picture, with a little noise so an encoder works about as hard as on a
+// camera picture. The same seed gives the same sequence, runs stay
+// comparable.
+inline void fill_pattern(AVFrame *frame, int index, uint32_t *seed)
+{
+	int box = frame->height / 4;
+	int box_x = (index * 4) % (frame->width - box);
+	int box_y = (frame->height - box) / 2;
+
+	for (int y = 0; y < frame->height; ++y) {
+		uint8_t *row = frame->data[0] + (size_t)y * frame->linesize[0];
+		for (int x = 0; x < frame->width; ++x) {
+			// xorshift32, cheap enough to run per pixel
+			*seed ^= *seed << 13;
+			*seed ^= *seed >> 17;
+			*seed ^= *seed << 5;
+			bool in_box = x >= box_x && x < box_x + box && y >= box_y && y < box_y + box;
+			int value = in_box ? 235 : 16 + ((x + y + index * 2) & 0x7f);
+			row[x] = (uint8_t)(value + (*seed & 0x07));
+		}
+	}
+	// Chroma planes of any subsampling, NV12 has both in one
+	const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((enum AVPixelFormat)frame->format);
+	int chroma_height = frame->height >> desc->log2_chroma_h;
+	for (int plane = 1; plane < 3 && frame->data[plane]; ++plane) {
+		int bytes = av_image_get_linesize((enum AVPixelFormat)frame->format, frame->width, plane);
+		for (int y = 0; y < chroma_height; ++y) {
+			uint8_t *row = frame->data[plane] + (size_t)y * frame->linesize[plane];
+			for (int x = 0; x < bytes; ++x)
+				row[x] = (uint8_t)(plane == 1 ? 64 + (x * 128) / bytes : 64 + (y * 128) / chroma_height);
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,367 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ *
+ * @Brief   : Offline throughput of the transcoder on a file or a generated test pattern
+ *
+ * @Created : 17-Oct-2026
+ *
+ * @Updated : 17-Oct-2026
+ *
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#include "../include/transcoder.hpp"
+#include "../include/latency.hpp"
+#include "../include/logger.hpp"
+#include "pattern.hpp"
+#include <getopt.h>
+#include <sys/resource.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+extern "C" {
+	#include <libavutil/avutil.h>
+}
+
+// Ctrl+C ends the pattern and the transcode early
+static std::atomic<bool> interrupted(false);
+
+static void inthand(int)
+{
+	interrupted = true;
+}
+
+// Settings of the run, the transcoder ones go to TranscodeOptions
+struct BenchOptions {
+	int pattern_width = 0;             // 0: the input is a file
+	int pattern_height = 0;
+	int pattern_fps = 30;
+	double pattern_duration = 10;      // s of generated video
+	const char *pattern_codec = "libx264";
+	const char *output = NULL;         // NULL: a temporary file, removed afterwards
+	const char *json = NULL;           // NULL: stdout
+	LogLevel log_level = LOG_LEVEL_WARNING;
+};
+
+static void print_usage()
+{
+	printf("USAGE: ./rtsp_ffmpeg_bench [options] <input_filename>\n"
+	"       ./rtsp_ffmpeg_bench [options] --pattern <WxH>\n\n"
+	"Transcodes as fast as possible (or paced with --realtime) and prints the results as JSON.\n\n"
+	"Options:\n"
+	"  --pattern <WxH>       generate a moving test pattern instead of reading a file\n"
+	"  --pattern-fps <n>     frame rate of the pattern (default 30)\n"
+	"  --pattern-duration <s> length of the pattern (default 10)\n"
+	"  --pattern-codec <name> encoder of the pattern, what the decoder sees (default libx264)\n"
+	"  --realtime            read the input no faster than its timestamps\n"
+	"  --copy                stream copy instead of re-encoding\n"
+	"  --codec <name>        output encoder (default libx264)\n"
+	"  --crf <n>             output rate factor\n"
+	"  --preset <name>       output encoder preset (default veryfast)\n"
+	"  --codec-threads <n>   threads of the decoder and the encoder (default libav default)\n"
+	"  --output <file>       keep the output in this file (default a temporary file)\n"
+	"  --json <file>         write the results to this file instead of stdout\n"
+	"  --log-level <level>   quiet, error, warning, info or debug (default warning)\n");
+}
+
+static int parse_options(int argc, char **argv, TranscodeOptions *opts, BenchOptions *bench)
+{
+	static const struct option long_options[] = {
+		{"pattern",          required_argument, NULL, 'P'},
+		{"pattern-fps",      required_argument, NULL, 'r'},
+		{"pattern-duration", required_argument, NULL, 'd'},
+		{"pattern-codec",    required_argument, NULL, 'k'},
+		{"realtime",         no_argument,       NULL, 'R'},
+		{"copy",             no_argument,       NULL, 'C'},
+		{"codec",            required_argument, NULL, 'c'},
+		{"crf",              required_argument, NULL, 'q'},
+		{"preset",           required_argument, NULL, 'p'},
+		{"codec-threads",    required_argument, NULL, 't'},
+		{"output",           required_argument, NULL, 'o'},
+		{"json",             required_argument, NULL, 'j'},
+		{"log-level",        required_argument, NULL, 'l'},
+		{"help",             no_argument,       NULL, 'h'},
+		{NULL, 0, NULL, 0}
+	};
+	int level;
+
+	int opt;
+	while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+		switch (opt) {
+		case 'P':
+			if (sscanf(optarg, "%dx%d", &bench->pattern_width, &bench->pattern_height) != 2 ||
+					bench->pattern_width < 16 || bench->pattern_height < 16) {
+				printf("\nERROR: Pattern size must be <width>x<height>, at least 16x16, got %s.\n", optarg);
+				return -1;
+			}
+			// 4:2:0 needs even sizes
+			bench->pattern_width &= ~1;
+			bench->pattern_height &= ~1;
+			break;
+		case 'r':
+			bench->pattern_fps = atoi(optarg);
+			if (bench->pattern_fps < 1) {
+				printf("\nERROR: Pattern frame rate must be at least 1.\n");
+				return -1;
+			}
+			break;
+		case 'd':
+			bench->pattern_duration = atof(optarg);
+			break;
+		case 'k':
+			bench->pattern_codec = optarg;
+			break;
+		case 'R':
+			opts->realtime = true;
+			break;
+		case 'C':
+			opts->copy_mode = COPY_ALWAYS;
+			break;
+		case 'c':
+			opts->encoder_name = optarg;
+			break;
+		case 'q':
+			opts->crf = optarg;
+			break;
+		case 'p':
+			opts->preset = optarg;
+			break;
+		case 't':
+			opts->codec_threads = atoi(optarg);
+			break;
+		case 'o':
+			bench->output = optarg;
+			break;
+		case 'j':
+			bench->json = optarg;
+			break;
+		case 'l':
+			level = log_level_from_name(optarg);
+			if (level < LOG_LEVEL_QUIET) {
+				printf("\nERROR: Unknown log level %s.\n", optarg);
+				return -1;
+			}
+			bench->log_level = (LogLevel)level;
+			break;
+		default:
+			return -1;
+		}
+	}
+	// Files are read as fast as they decode, drops would only hide a slow encoder
+	if (!opts->realtime)
+		opts->drop_policy = DROP_NEVER;
+	opts->stats_interval = 0;
+	opts->writer.fsync_interval = -1;
+	return optind;
+}
+
+static int write_encoded(AVCodecContext *codec_ctx, AVFormatContext *fmt_ctx, AVStream *stream, AVFrame *frame, AVPacket *packet)
+{
+	int ret = avcodec_send_frame(codec_ctx, frame);
+	while (ret >= 0) {
+		ret = avcodec_receive_packet(codec_ctx, packet);
+		if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+			return 0;
+		if (ret < 0)
+			return ret;
+		av_packet_rescale_ts(packet, codec_ctx->time_base, stream->time_base);
+		packet->stream_index = stream->index;
+		ret = av_interleaved_write_frame(fmt_ctx, packet);
+	}
+	return ret;
+}
+
+// Encodes the test pattern into a file the transcoder then reads like any other input
+static int write_pattern(const char *filename, const BenchOptions *bench)
+{
+	const AVCodec *codec = avcodec_find_encoder_by_name(bench->pattern_codec);
+	if (!codec) {
+		log_message(LOG_LEVEL_ERROR, "Pattern encoder %s not found\n", bench->pattern_codec);
+		return 1;
+	}
+
+	AVFormatContext *fmt_ctx = NULL;
+	avformat_alloc_output_context2(&fmt_ctx, NULL, NULL, filename);
+	if (!fmt_ctx)
+		return 1;
+	AVStream *stream = avformat_new_stream(fmt_ctx, NULL);
+	AVCodecContext *codec_ctx = avcodec_alloc_context3(codec);
+	AVFrame *frame = av_frame_alloc();
+	AVPacket *packet = av_packet_alloc();
+	int ret = -1;
+
+	codec_ctx->width = bench->pattern_width;
+	codec_ctx->height = bench->pattern_height;
+	codec_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+	codec_ctx->time_base = AVRational{1, bench->pattern_fps};
+	codec_ctx->framerate = AVRational{bench->pattern_fps, 1};
+	codec_ctx->gop_size = encoder_gop_size;
+	codec_ctx->max_b_frames = 0;     // cameras send no B-frames
+	av_opt_set(codec_ctx->priv_data, "preset", "ultrafast", 0);
+	if (fmt_ctx->oformat->flags & AVFMT_GLOBALHEADER)
+		codec_ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+	frame->format = codec_ctx->pix_fmt;
+	frame->width = codec_ctx->width;
+	frame->height = codec_ctx->height;
+
+	if (avcodec_open2(codec_ctx, codec, NULL) < 0 || av_frame_get_buffer(frame, 0) < 0) {
+		log_message(LOG_LEVEL_ERROR, "Could not set up the pattern encoder\n");
+		goto end;
+	}
+	stream->time_base = codec_ctx->time_base;
+	avcodec_parameters_from_context(stream->codecpar, codec_ctx);
+	if (avio_open(&fmt_ctx->pb, filename, AVIO_FLAG_WRITE) < 0 || avformat_write_header(fmt_ctx, NULL) < 0) {
+		log_message(LOG_LEVEL_ERROR, "Could not write the pattern to %s\n", filename);
+		goto end;
+	}
+
+	{
+		int frames = (int)(bench->pattern_duration * bench->pattern_fps);
+		uint32_t seed = 42;
+		ret = 0;
+		for (int i = 0; i < frames && ret >= 0 && !interrupted; ++i) {
+			ret = av_frame_make_writable(frame);
+			if (ret < 0)
+				break;
+			fill_pattern(frame, i, &seed);
+			frame->pts = i;
+			ret = write_encoded(codec_ctx, fmt_ctx, stream, frame, packet);
+		}
+		if (ret >= 0)
+			ret = write_encoded(codec_ctx, fmt_ctx, stream, NULL, packet);
+		av_write_trailer(fmt_ctx);
+	}
+
+end:
+	if (fmt_ctx->pb)
+		avio_closep(&fmt_ctx->pb);
+	av_packet_free(&packet);
+	av_frame_free(&frame);
+	avcodec_free_context(&codec_ctx);
+	avformat_free_context(fmt_ctx);
+	return ret < 0 ? 1 : 0;
+}
+
+static void json_string(FILE *file, const char *value)
+{
+	if (!value) {
+		fputs("null", file);
+		return;
+	}
+	fputc('"', file);
+	for (const char *c = value; *c; ++c) {
+		if (*c == '"' || *c == '\\')
+			fprintf(file, "\\%c", *c);
+		else if ((unsigned char)*c < 0x20)
+			fprintf(file, "\\u%04x", *c);
+		else
+			fputc(*c, file);
+	}
+	fputc('"', file);
+}
+
+static double cpu_seconds(const struct rusage &usage)
+{
+	return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+		usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+int main(int argc, char **argv)
+{
+	signal(SIGINT, inthand);
+
+	TranscodeOptions opts;
+	BenchOptions bench;
+	int first_arg = parse_options(argc, argv, &opts, &bench);
+	bool pattern = bench.pattern_width > 0;
+	if (first_arg < 0 || argc - first_arg != (pattern ? 0 : 1)) {
+		print_usage();
+		return 1;
+	}
+	log_init(bench.log_level);
+
+	std::string temp_dir = std::experimental::filesystem::temp_directory_path().string();
+	std::string input = pattern ? temp_dir + "/rtsp_ffmpeg_bench_pattern.mkv" : argv[first_arg];
+	std::string output = bench.output ? bench.output : temp_dir + "/rtsp_ffmpeg_bench_output.mkv";
+	char pattern_name[64] = "";
+
+	if (pattern) {
+		snprintf(pattern_name, sizeof(pattern_name), "%dx%d@%d", bench.pattern_width, bench.pattern_height, bench.pattern_fps);
+		if (write_pattern(input.c_str(), &bench) != 0)
+			return 1;
+	}
+
+	InputUtils in_state = {};
+	OutputUtils out_state = {};
+	in_state.stop_request = &interrupted;
+	std::unique_ptr<LatencySnapshot[]> latency(new LatencySnapshot[STAGE_COUNT]());
+
+	struct rusage usage_start, usage_end;
+	if (setup_streams(&in_state, &out_state, &opts, input.c_str(), output.c_str()) != 0)
+		return 1;
+	getrusage(RUSAGE_SELF, &usage_start);
+	uint64_t start = latency_now();
+	int ret = transcode(&in_state, &out_state, &opts, latency.get());
+	double wall = (latency_now() - start) / 1e9;
+	getrusage(RUSAGE_SELF, &usage_end);
+
+	// One encode per frame, in stream copy mode every video packet is muxed as it is
+	uint64_t frames = latency[opts.stream_copy ? STAGE_MUX : STAGE_ENCODE].total();
+	double cpu = cpu_seconds(usage_end) - cpu_seconds(usage_start);
+	AVRational frame_rate = in_state.input_framerate;
+	double media = frame_rate.num > 0 ? frames * av_q2d(av_inv_q(frame_rate)) : 0;
+	close_streams(&in_state, &out_state);
+
+	std::error_code error;
+	std::uintmax_t output_size = std::experimental::filesystem::file_size(output, error);
+	if (error)
+		output_size = 0;
+	if (!bench.output)
+		std::experimental::filesystem::remove(output, error);
+	if (pattern)
+		std::experimental::filesystem::remove(input, error);
+	log_shutdown();
+
+	FILE *file = bench.json ? fopen(bench.json, "w") : stdout;
+	if (!file) {
+		fprintf(stderr, "Could not open %s\n", bench.json);
+		return 1;
+	}
+	fputs("{\n  \"input\": ", file);
+	json_string(file, pattern ? NULL : input.c_str());
+	fputs(",\n  \"pattern\": ", file);
+	json_string(file, pattern ? pattern_name : NULL);
+	fputs(",\n  \"encoder\": ", file);
+	json_string(file, opts.stream_copy ? NULL : opts.encoder_name);
+	fputs(",\n  \"preset\": ", file);
+	json_string(file, opts.preset);
+	fputs(",\n  \"crf\": ", file);
+	json_string(file, opts.crf);
+	fprintf(file, ",\n  \"stream_copy\": %s,\n  \"realtime\": %s,\n  \"codec_threads\": %d,\n",
+		opts.stream_copy ? "true" : "false", opts.realtime ? "true" : "false", opts.codec_threads);
+	fputs("  \"ffmpeg\": ", file);
+	json_string(file, av_version_info());
+	fprintf(file, ",\n  \"result\": %d,\n  \"frames\": %llu,\n  \"wall_s\": %.3f,\n  \"fps\": %.2f,\n  \"speed\": %.3f,\n",
+		ret, (unsigned long long)frames, wall, wall > 0 ? frames / wall : 0, wall > 0 ? media / wall : 0);
+	fprintf(file, "  \"cpu_s\": %.3f,\n  \"cpu_ms_per_frame\": %.3f,\n  \"cpu_cores\": %.2f,\n",
+		cpu, frames ? cpu * 1e3 / frames : 0, wall > 0 ? cpu / wall : 0);
+	// ru_maxrss is in kB on Linux and covers the whole process, the pattern encoder included
+	fprintf(file, "  \"peak_rss_kb\": %ld,\n  \"output_bytes\": %llu,\n  \"stages\": {",
+		usage_end.ru_maxrss, (unsigned long long)output_size);
+	for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+		const LatencySnapshot &snapshot = latency[stage];
+		fprintf(file, "%s\n    \"%s\": {\"count\": %llu, \"p50_ms\": %.3f, \"p90_ms\": %.3f, \"p99_ms\": %.3f, \"max_ms\": %.3f}",
+			stage ? "," : "", latency_stage_name(stage), (unsigned long long)snapshot.total(),
+			snapshot.percentile(50) / 1e6, snapshot.percentile(90) / 1e6,
+			snapshot.percentile(99) / 1e6, snapshot.max() / 1e6);
+	}
+	fputs("\n  }\n}\n", file);
+	if (file != stdout)
+		fclose(file);
+
+	return ret == 0 ? 0 : 1;
+}
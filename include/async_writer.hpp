@@ -0,0 +1,77 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Output files written by a dedicated thread through a custom AVIOContext
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#ifndef async_writer_hpp
+#define async_writer_hpp
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "transcoder.hpp"
+#include "spsc_queue.hpp"
+
+// One positioned write, its buffer goes back to the muxer once done
+struct WriteRequest {
+	uint8_t *data;
+	size_t size;
+	int64_t offset;
+};
+
+// avio_open() writes the file from the mux stage in 32 KB pieces, so every
+// slow write() or a disk latency spike holds up the muxer and, behind its
+// queue, the encoder. Here the AVIOContext buffers up to buffer_size bytes,
+// copies them into an aligned buffer and queues it for the writer thread,
+// which issues positioned writes (batched through io_uring when built with
+// liburing, pwrite otherwise). The muxer only waits when max_buffered bytes
+// are queued. Positioned writes in queue order keep the muxer's seeks back
+// to patch headers correct. Space is reserved ahead with fallocate() and
+// the fsync policy is applied by the writer thread as well.
+struct AsyncWriter {
+	AsyncWriter(const WriterSettings *settings, int fd, const char *filename);
+	~AsyncWriter();
+
+	const WriterSettings *settings;
+	int fd;
+	std::string filename;
+
+	std::vector<WriteRequest> requests;   // every buffer, allocated on first use
+	size_t allocated;
+	SpscQueue<WriteRequest*> pending;     // muxer -> writer thread
+	SpscQueue<WriteRequest*> done;        // writer thread -> muxer
+	std::atomic<bool> failed;             // wakes a muxer waiting for a buffer
+	std::atomic<int> error;               // first write error, returned by the next AVIO call
+	std::thread thread;
+
+	// Muxer side
+	int64_t position;
+	int64_t size;                         // end of the furthest write
+	uint64_t waits;                       // times the muxer found every buffer queued
+	uint64_t wait_time;                   // ns
+
+	// Writer thread side
+	int64_t reserved;                     // fallocate()d up to here
+	uint64_t last_sync;
+	uint64_t bytes;
+	uint64_t writes;
+	uint64_t max_write_time;              // ns
+	uint64_t syncs;
+};
+
+// Opens output_fmt_ctx->pb on filename, returns 1 if the file could not be created
+int async_writer_open(OutputUtils *out_state, const char *filename);
+// Flushes, waits for the queued writes, closes the file and logs its write statistics
+int async_writer_close(OutputUtils *out_state);
+// Local files only, other protocols keep avio_open()
+bool async_writer_usable(const char *filename);
+
+#endif
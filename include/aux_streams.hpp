@@ -0,0 +1,51 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Audio and other streams copied into the output next to the video
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#ifndef aux_streams_hpp
+#define aux_streams_hpp
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "transcoder.hpp"
+
+// One input stream written as it is, the packets are never decoded
+struct AuxStream {
+	int input_index;
+	int output_index;
+	AVRational time_base;        // of the input stream
+	int64_t last_dts;            // in the output stream time base
+};
+
+// Everything but the video goes straight from the demuxer to the muxer:
+// av_interleaved_write_frame() puts it in order with the video, which reaches
+// the muxer later because of the decoder and encoder in between. Audio costs a
+// timestamp rescale and a copy of a few hundred bytes per packet.
+struct AuxStreams {
+	std::vector<AuxStream> streams;
+	std::vector<int> by_input;   // input stream index -> streams index, -1 when not copied
+
+	// Written by the mux stage, dropped by the demux stage too
+	std::atomic<uint64_t> packets;
+	std::atomic<uint64_t> bytes;
+	std::atomic<uint64_t> dropped;   // before the first video keyframe or at a full queue
+};
+
+// Adds the output streams, between setup_output_stream() and open_output_stream()
+int aux_streams_setup(InputUtils *in_state, OutputUtils *out_state, const TranscodeOptions *opts);
+const AuxStream *aux_stream_of(const OutputUtils *out_state, const AVPacket *packet);
+// Takes a demuxed packet, timestamps in the time base of its input stream
+int write_aux_packet(OutputUtils *out_state, AVPacket *packet);
+void aux_streams_free(OutputUtils *out_state);
+void aux_streams_report(const AuxStreams *aux);
+
+#endif
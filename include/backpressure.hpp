@@ -0,0 +1,70 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Frame dropping policy for live inputs the encoder cannot keep up with
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#ifndef backpressure_hpp
+#define backpressure_hpp
+
+#include <atomic>
+#include <cstdint>
+#include "transcoder.hpp"
+
+// How far the pipeline goes to stay real time
+enum BackpressureLevel {
+	BACKPRESSURE_NONE,
+	BACKPRESSURE_SKIP_NONREF,   // the decoder skips non-reference frames
+	BACKPRESSURE_DECIMATE,      // and every second decoded frame is dropped before the encoder
+};
+
+// A live camera does not wait for us: if reading slows down, the RTSP/TCP
+// buffers fill and the stream breaks. The encode stage measures how far the
+// frame it takes lags behind the wall clock, the decode stage sheds work
+// accordingly and no stage ever blocks on a full queue. A full input queue
+// drops packets up to the next keyframe, a full frame queue drops the frame.
+struct Backpressure {
+	Backpressure(const TranscodeOptions *opts, AVRational time_base);
+
+	AVRational time_base;
+	int64_t max_lag;              // ns, the first level starts above it
+
+	// Written by the encode stage only
+	int64_t base_wall;            // wall clock of the stream time base_pts
+	int64_t base_pts;
+	std::atomic<int64_t> lag;     // ns, of the last frame handed to the encoder
+	std::atomic<int64_t> peak_lag;
+	std::atomic<int> level;
+
+	// Written by the decode stage only
+	unsigned decimate;
+	// Written by the demux stage only
+	bool skip_to_keyframe;
+
+	// Drop counters, exported by the report
+	std::atomic<uint64_t> nonref_skipped;     // non-reference pictures the decoder discarded
+	std::atomic<uint64_t> frames_decimated;
+	std::atomic<uint64_t> frames_queue_full;
+	std::atomic<uint64_t> packets_dropped;
+};
+
+bool is_live_input(const InputUtils *in_state);
+bool backpressure_enabled(const InputUtils *in_state, const TranscodeOptions *opts);
+// Encode stage, for every frame it takes
+void backpressure_update(Backpressure *backpressure, const AVFrame *frame);
+// Decode stage
+enum AVDiscard backpressure_skip_frame(const Backpressure *backpressure);
+bool backpressure_keep_frame(Backpressure *backpressure);
+// True for an H.264 or HEVC packet the decoder discards under AVDISCARD_NONREF
+bool backpressure_nonref_packet(const AVCodecContext *codec_ctx, const AVPacket *packet);
+// Demux stage, for a packet the input queue has no room for or that follows one
+bool backpressure_drop_packet(Backpressure *backpressure, const AVPacket *packet, bool queue_full);
+void backpressure_report(const Backpressure *backpressure);
+
+#endif
@@ -0,0 +1,67 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Closed-loop preset/CRF control of the output encoder
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#ifndef encoder_control_hpp
+#define encoder_control_hpp
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include "transcoder.hpp"
+
+// A fixed preset is either too slow for a busy scene or wastes the headroom
+// of a quiet one. The controller compares the mean encode time of a window of
+// frames with the frame interval: above 85% of it the encoder gets faster
+// (preset first, then a higher CRF), below 50% it gets better again (CRF
+// first, then a slower preset, never past the configured slowest one).
+// A libx264 CRF change applies to the next frame, everything else reopens the
+// encoder on the next GOP boundary; the headers are repeated in-band on every
+// IDR, so the decoder of the output follows the switch.
+struct EncoderController {
+	EncoderController(const TranscodeOptions *opts, const EncoderSettings &base, AVCodecID codec_id, AVRational frame_rate);
+
+	AVCodecID codec_id;
+	EncoderSettings settings;     // what the encoder is opened with, points into preset/crf
+	std::string preset;
+	std::string crf;
+
+	int slowest;                  // index in the preset ladder
+	int base_crf;
+	int crf_range;
+	int64_t frame_interval;       // ns
+
+	// Written by the encode stage only
+	int window_frames;
+	int window_count;
+	uint64_t window_time;
+	int settle;                   // windows ignored after a change
+	int gop_frames;               // frames sent since the encoder was opened
+	bool reopen;                  // preset/CRF changed, waiting for the GOP boundary
+
+	// Exported by the report
+	std::atomic<int> preset_index;
+	std::atomic<int> crf_offset;
+	std::atomic<int> load;        // percent of the frame interval, last window
+	std::atomic<uint64_t> steps_faster;
+	std::atomic<uint64_t> steps_better;
+	std::atomic<uint64_t> reopens;
+};
+
+bool encoder_preset_known(const char *name);
+bool encoder_control_supported(const OutputUtils *out_state, const TranscodeOptions *opts);
+// Encode stage, before a frame is sent to the encoder
+int encoder_control_apply(EncoderController *controller, Pipeline *pipeline);
+// Encode stage, with the time the encoder took for that frame
+void encoder_control_frame(EncoderController *controller, OutputUtils *out_state, uint64_t elapsed);
+void encoder_control_report(const EncoderController *controller);
+
+#endif
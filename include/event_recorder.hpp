@@ -0,0 +1,75 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Pre-event packet ring that is written to disk only around events
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#ifndef event_recorder_hpp
+#define event_recorder_hpp
+
+#include <atomic>
+#include <deque>
+#include "transcoder.hpp"
+#include "media_pool.hpp"
+
+
+// Raised by SIGUSR1, every session in the process sees the trigger
+extern volatile sig_atomic_t event_signal;
+void event_hand(int signum);
+
+// Packets of one GOP held in the ring, the first one is a keyframe
+struct EventGop {
+	int64_t start_pts;
+	size_t packets;
+	int64_t bytes;
+};
+
+// Keeps the newest pre_event seconds of encoded packets in memory, cut at
+// GOP boundaries so a flush always starts on a keyframe. A trigger writes
+// the ring out and then writes through until post_event seconds after the
+// last trigger. The ring never holds more than memory_limit bytes, the
+// oldest GOPs are dropped first when it would.
+struct EventRecorder {
+	EventRecorder(OutputUtils *out, PacketPool *pool, const TranscodeOptions *opts);
+	~EventRecorder();
+
+	OutputUtils *out_state;
+	PacketPool *packet_pool;
+
+	double pre_event;
+	double post_event;
+	int64_t memory_limit;
+	const char *trigger_file;
+
+	std::deque<AVPacket*> ring;
+	std::deque<EventGop> gops;
+
+	std::atomic<bool> recording;
+	bool keyframe_wait;          // triggered with an empty ring, the clip starts on the next keyframe
+	int64_t record_until;        // pts in the packet time base
+	sig_atomic_t seen_signal;
+	int64_t trigger_mtime;       // of trigger_file when last polled
+	uint64_t next_poll;          // latency_now() time of the next trigger_file poll
+
+	// Read by the report from another thread
+	std::atomic<int64_t> ring_bytes;
+	std::atomic<size_t> ring_packets;
+	std::atomic<uint64_t> events;
+	std::atomic<uint64_t> dropped_gops;   // pushed out by the memory cap, not by age
+};
+
+bool event_recording_enabled(const TranscodeOptions *opts);
+// Takes ownership of the packet, it goes back to the pool once written or expired
+int event_recorder_write(EventRecorder *recorder, AVPacket *packet);
+// At the end of the input, after the encoder was flushed: an event still
+// being recorded, or triggered since the last packet, gets the ring written
+int event_recorder_close(EventRecorder *recorder);
+void event_recorder_report(const EventRecorder *recorder);
+
+#endif
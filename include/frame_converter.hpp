@@ -0,0 +1,58 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ *
+ * @Brief   : Decoded frames converted to the size and pixel format of an encoder
+ *
+ * @Created : 17-Oct-2026
+ *
+ * @Updated : 17-Oct-2026
+ *
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#ifndef frame_converter_hpp
+#define frame_converter_hpp
+
+#include <atomic>
+#include <cstdint>
+#include "transcoder.hpp"
+#include "media_pool.hpp"
+extern "C" {
+	#include <libswscale/swscale.h>
+}
+
+
+// The decoder delivers what the camera sends (yuvj420p, nv12, 4:2:2 ...), the
+// encoder takes the pixel formats of its codec and the size of its output.
+// Frames that already match skip the converter without a copy. The others
+// go through libswscale, sliced over threads, into pictures of a pool. The
+// scaler is set up again when the decoder changes size or format.
+struct FrameConverter {
+	FrameConverter(int threads);
+	~FrameConverter();
+
+	SwsContext *sws;
+	int threads;                    // slice threads, 0 lets libswscale use every core
+	int source_width;
+	int source_height;
+	int source_format;
+	FrameBufferPool *buffer_pool;   // converted pictures
+
+	// Written by the converting thread, read by the report. The target is a
+	// copy, the adaptive controller may free and reopen the encoder meanwhile.
+	std::atomic<int> target_width;
+	std::atomic<int> target_height;
+	std::atomic<int> target_format;
+	std::atomic<uint64_t> converted;
+	std::atomic<uint64_t> passed;   // already in the encoder's size and format
+	std::atomic<uint64_t> convert_time;   // ns
+};
+
+bool frame_converter_needed(const AVFrame *frame, const AVCodecContext *codec_ctx);
+// Counts a frame that goes to the encoder as it is
+void frame_converter_pass(FrameConverter *converter, const AVCodecContext *codec_ctx);
+// Fills output, an empty frame, with frame in the encoder's size and format
+int frame_convert(FrameConverter *converter, const AVCodecContext *codec_ctx, const AVFrame *frame, AVFrame *output);
+void frame_converter_report(const FrameConverter *converter);
+
+#endif
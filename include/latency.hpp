@@ -0,0 +1,78 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Low overhead per-stage latency histograms
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#ifndef latency_hpp
+#define latency_hpp
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+
+enum LatencyStage {
+	STAGE_READ,
+	STAGE_DECODE,
+	STAGE_ENCODE,
+	STAGE_MUX,
+	STAGE_COUNT
+};
+
+// Log-linear buckets in the spirit of HdrHistogram: 32 linear sub-buckets per
+// power of two keep every value within ~3% from 1 ns up to ~68 s.
+const int latency_sub_bits = 5;
+const int latency_max_bits = 36;
+const int latency_buckets = (latency_max_bits - latency_sub_bits + 1) << latency_sub_bits;
+
+// Monotonic time in nanoseconds
+inline uint64_t latency_now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Point in time copy of a histogram, used for percentiles and interval deltas
+struct LatencySnapshot {
+	uint64_t counts[latency_buckets];
+
+	uint64_t total() const;
+	uint64_t percentile(double percent) const;
+	uint64_t max() const;
+	void subtract(const LatencySnapshot &earlier);
+};
+
+// Recording is a bucket lookup and a relaxed increment. Only one thread may
+// record into a histogram at a time, any thread may take snapshots.
+class LatencyHistogram {
+public:
+	LatencyHistogram();
+
+	void record(uint64_t nanoseconds)
+	{
+		auto &count = counts[bucket_index(nanoseconds)];
+		count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	void record_since(uint64_t start) { record(latency_now() - start); }
+
+	void snapshot(LatencySnapshot *out) const;
+
+	static int bucket_index(uint64_t value);
+	static uint64_t bucket_value(int index);   // highest value that lands in the bucket
+
+private:
+	std::atomic<uint64_t> counts[latency_buckets];
+};
+
+const char *latency_stage_name(int stage);
+void latency_report(const LatencySnapshot snapshots[STAGE_COUNT]);
+
+#endif
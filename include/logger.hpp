@@ -0,0 +1,40 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Asynchronous logger, a lock-free ring drained by a background thread
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#ifndef logger_hpp
+#define logger_hpp
+
+
+enum LogLevel {
+	LOG_LEVEL_QUIET = -1,
+	LOG_LEVEL_ERROR,
+	LOG_LEVEL_WARNING,
+	LOG_LEVEL_INFO,
+	LOG_LEVEL_DEBUG
+};
+
+// Starts the writer thread and routes av_log() through the ring as well.
+// Until then (and after log_shutdown) messages are written synchronously.
+void log_init(LogLevel level);
+
+// Writes out everything still queued and stops the writer thread
+void log_shutdown();
+
+// Formats into a ring slot and returns, never blocks on I/O. When the ring is
+// full the message is dropped and counted. Errors and warnings with the same
+// format string are limited to a few per second, the rest is summarised.
+void log_message(LogLevel level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+bool log_enabled(LogLevel level);
+int log_level_from_name(const char *name);
+
+#endif
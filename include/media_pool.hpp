@@ -0,0 +1,89 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Recycled AVPacket/AVFrame shells and pooled decoder frame buffers
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#ifndef media_pool_hpp
+#define media_pool_hpp
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+extern "C" {
+	#include <libavcodec/avcodec.h>
+	#include <libavutil/frame.h>
+	#include <libavutil/buffer.h>
+}
+
+
+// Allocation counters, allocations stop growing once a session is warmed up
+struct PoolCounters {
+	std::atomic<uint64_t> allocated;   // new objects created because the pool was empty
+	std::atomic<uint64_t> reused;      // requests served from the pool
+};
+
+// Keeps unreferenced AVPacket structs for reuse. Packets are taken and
+// returned from different stage threads, so the free list is locked; the
+// lock is held for a push or pop only.
+class PacketPool {
+public:
+	explicit PacketPool(size_t max_free);
+	~PacketPool();
+
+	AVPacket *get();
+	void put(AVPacket *packet);   // unreferences the packet
+
+	PoolCounters counters;
+
+private:
+	std::mutex lock;
+	std::vector<AVPacket*> free_list;
+	size_t max_free;
+};
+
+// Same as PacketPool for AVFrame structs
+class FramePool {
+public:
+	explicit FramePool(size_t max_free);
+	~FramePool();
+
+	AVFrame *get();
+	void put(AVFrame *frame);     // unreferences the frame
+
+	PoolCounters counters;
+
+private:
+	std::mutex lock;
+	std::vector<AVFrame*> free_list;
+	size_t max_free;
+};
+
+// Backs the decoder's get_buffer2 with an AVBufferPool sized for the stream
+// resolution, so picture memory is recycled instead of reallocated per frame.
+// The pool is rebuilt when the decoder changes size or pixel format.
+struct FrameBufferPool {
+	std::mutex lock;
+	AVBufferPool *pool;
+	int width;
+	int height;
+	int format;
+	int aligned_height;           // plane offsets leave room for the rows decoders write past the height
+	int linesize[4];
+	size_t size;
+	std::atomic<uint64_t> allocated;   // buffers the AVBufferPool had to allocate
+};
+
+void frame_buffer_pool_attach(AVCodecContext *codec_ctx, FrameBufferPool *buffer_pool);
+// For frames no decoder produced: the caller sets width, height and format
+int frame_buffer_pool_get(FrameBufferPool *buffer_pool, AVFrame *frame);
+void frame_buffer_pool_free(FrameBufferPool **buffer_pool);
+
+#endif
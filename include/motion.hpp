@@ -0,0 +1,75 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Luma SAD motion detection used to skip encoding static scenes
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#ifndef motion_hpp
+#define motion_hpp
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "transcoder.hpp"
+
+// A block is 16 pixels wide and 16 rows high, of which every second row is compared
+#define MOTION_BLOCK_WIDTH 16
+#define MOTION_BLOCK_HEIGHT 16
+#define MOTION_ROW_STEP 2
+
+// Adds the SAD of each 16 byte block of row a against row b to block_sad[i]
+typedef void (*MotionSadFunc)(const uint8_t *a, const uint8_t *b, int blocks, uint32_t *block_sad);
+
+void motion_sad_scalar(const uint8_t *a, const uint8_t *b, int blocks, uint32_t *block_sad);
+#if defined(__x86_64__) || defined(__i386__)
+void motion_sad_sse2(const uint8_t *a, const uint8_t *b, int blocks, uint32_t *block_sad);
+void motion_sad_avx2(const uint8_t *a, const uint8_t *b, int blocks, uint32_t *block_sad);
+#endif
+
+// Fastest kernel the CPU supports, picked once
+MotionSadFunc motion_sad_best(const char **name);
+
+// Decides per decoded frame whether it goes on to the encoder. Frames pass
+// while blocks inside the regions change, for hold seconds after the last
+// change, and at idle_fps while the scene is static.
+struct MotionDetector {
+	MotionDetector(const TranscodeOptions *opts, AVRational time_base);
+
+	MotionSadFunc sad;
+	const char *kernel;
+	AVRational time_base;
+
+	double threshold;            // mean absolute luma difference of a changed block
+	double area;                 // fraction of the region blocks that must change
+	int64_t hold;                // in time_base
+	int64_t idle_interval;       // in time_base, 0 drops every static frame
+	std::vector<MotionRegion> regions;
+
+	int width;
+	int height;
+	int block_cols;
+	int block_rows;
+	int region_blocks;
+	std::vector<uint8_t> reference;   // compared rows of the previous frame
+	std::vector<uint32_t> block_sad;
+	std::vector<uint8_t> block_mask;  // 1 for blocks inside a region
+
+	int64_t last_motion;
+	int64_t last_pass;
+
+	// Read by the report from another thread
+	std::atomic<uint64_t> frames;
+	std::atomic<uint64_t> motion_frames;
+	std::atomic<uint64_t> dropped;
+};
+
+bool motion_detector_accept(MotionDetector *detector, const AVFrame *frame);
+void motion_detector_report(const MotionDetector *detector);
+
+#endif
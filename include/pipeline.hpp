@@ -0,0 +1,107 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Demux, decode, encode and mux stages running on their own threads
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#ifndef pipeline_hpp
+#define pipeline_hpp
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "transcoder.hpp"
+#include "spsc_queue.hpp"
+#include "latency.hpp"
+#include "media_pool.hpp"
+#include "event_recorder.hpp"
+#include "motion.hpp"
+#include "snapshot.hpp"
+#include "backpressure.hpp"
+#include "encoder_control.hpp"
+#include "reconnect.hpp"
+#include "shm_ring.hpp"
+#include "restream.hpp"
+#include "frame_converter.hpp"
+
+
+struct Rendition;
+
+// Occupancy samples of one queue, taken by the monitoring thread
+struct QueueStats {
+	const char *name;
+	size_t samples;
+	size_t total;
+};
+
+// Stages and the queues connecting them:
+//   demux -> packet_queue -> decode -> frame_queue -> encode -> mux_queue -> mux
+//   demux -> aux_queue -> mux (passthrough streams)
+//
+// With inline_stages set only the packet queue is used: decode, encode and mux
+// run back to back in pipeline_process(), which a session schedules on the
+// shared worker pool whenever on_packet tells it new input arrived.
+struct Pipeline {
+	Pipeline(InputUtils *in, OutputUtils *out, const TranscodeOptions *options);
+	~Pipeline();
+
+	InputUtils *in_state;
+	OutputUtils *out_state;
+	const TranscodeOptions *opts;
+
+	SpscQueue<AVPacket*> packet_queue;
+	SpscQueue<AVFrame*> frame_queue;
+	SpscQueue<AVPacket*> mux_queue;
+	SpscQueue<AVPacket*> aux_queue;   // only when re-encoding, stream copy and inline stages use packet_queue
+	QueueStats packet_stats;
+	QueueStats frame_stats;
+	QueueStats mux_stats;
+	QueueStats aux_stats;
+
+	LatencyHistogram latency[STAGE_COUNT];
+	LatencySnapshot last_latency[STAGE_COUNT];   // at the previous interval report
+
+	PacketPool packet_pool;      // demuxed and encoded packets
+	FramePool frame_pool;        // decoded frames
+	std::unique_ptr<EventRecorder> events;   // set in event recording mode, holds pool packets
+	std::unique_ptr<MotionDetector> motion;  // set when static frames are kept from the encoder
+	std::vector<std::unique_ptr<Rendition>> renditions;   // fed with references of the decoded frames
+	std::unique_ptr<Snapshotter> snapshots;  // set when keyframe thumbnails are taken
+	std::unique_ptr<Backpressure> backpressure;   // set when frames are dropped to stay real time
+	std::unique_ptr<EncoderController> encoder_control;   // set when the main encoder adapts its preset/CRF
+	std::unique_ptr<Reconnector> reconnect;  // set when a lost input is opened again
+	std::unique_ptr<ShmPublisher> shm;       // set when frames or packets go to shared memory
+	std::unique_ptr<Restreamer> restream;    // set when the output is served to local clients
+	std::unique_ptr<FrameConverter> converter;   // set when re-encoding, ahead of the main encoder
+
+	std::atomic<bool> abort;     // raised by the first stage that fails
+	std::atomic<int> result;     // error of that stage, 0 on success
+	std::atomic<int> running;    // stages still alive
+
+	bool inline_stages;
+	std::function<void()> on_packet;   // called by the demuxer after each push and at the end
+
+	// Set by an embedding application, see RtspSession. They run on the mux
+	// and decode threads and see the packet or frame before the output does.
+	std::function<void(const AVPacket*, AVRational)> packet_sink;   // every video packet, in that time base
+	std::function<void(const AVFrame*)> frame_sink;   // every decoded frame, none in stream copy mode
+};
+
+// Creates the optional stages, once setup_streams() has opened the streams
+int pipeline_setup(Pipeline *pipeline);
+int pipeline_push_frame(Pipeline *pipeline, AVFrame *frame);
+int pipeline_push_packet(Pipeline *pipeline, AVPacket *packet);
+void pipeline_demux(Pipeline *pipeline);
+bool pipeline_process(Pipeline *pipeline, int budget);
+int pipeline_run(Pipeline *pipeline);
+void pipeline_sample(Pipeline *pipeline);
+void pipeline_report(Pipeline *pipeline, bool interval);
+
+#endif
@@ -0,0 +1,45 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Stream parameters remembered per input URL for a short probe
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#ifndef probe_cache_hpp
+#define probe_cache_hpp
+
+#include <string>
+#include "transcoder.hpp"
+
+// avformat_find_stream_info() reads up to 5 s of a live stream just to learn
+// what the camera told us the last time. With the parameters of an earlier
+// open the video stream is filled in up front and the probe stops after a
+// fraction of that; the result is checked against the hint and a mismatch
+// falls back to a full probe.
+struct ProbeInfo {
+	ProbeInfo();
+	~ProbeInfo();
+	ProbeInfo(const ProbeInfo &) = delete;
+	ProbeInfo &operator=(const ProbeInfo &) = delete;
+
+	AVCodecParameters *params;
+	AVRational time_base;
+	AVRational frame_rate;
+};
+
+void probe_info_from_input(ProbeInfo *info, const InputUtils *in_state);
+// Before avformat_find_stream_info(): fills the video stream from the hint and shortens the probe
+void probe_info_apply(const ProbeInfo *info, AVFormatContext *input_fmt_ctx);
+// After it: false when the input is not what the hint described
+bool probe_info_matches(const ProbeInfo *info, const AVFormatContext *input_fmt_ctx);
+
+// One small text file per URL in the cache directory
+bool probe_cache_load(const char *directory, const char *url, ProbeInfo *info);
+int probe_cache_store(const char *directory, const char *url, const InputUtils *in_state);
+
+#endif
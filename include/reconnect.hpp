@@ -0,0 +1,67 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Reconnecting a lost input without breaking the recording
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#ifndef reconnect_hpp
+#define reconnect_hpp
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include "transcoder.hpp"
+#include "probe_cache.hpp"
+
+// A camera blip used to end the recording. The demux stage now reopens the
+// input with jittered exponential backoff and swaps the new connection in,
+// the decoder, encoder and output stay as they are as long as the stream
+// parameters did not change, which also lets the new connection skip most of
+// the probe. Packets of the new connection are dropped up to
+// the first keyframe and shifted so their timestamps continue where the old
+// connection stopped, plus the time the input was away.
+struct Reconnector {
+	Reconnector(const InputUtils *in_state, const TranscodeOptions *opts);
+
+	std::string url;
+	ProbeInfo probe;              // of the first connection, shortens the probe of a new one that must match it
+	bool stream_copy;             // the output was made from params, extradata must match too
+	AVRational time_base;         // in_state->input_time_base
+	AVRational stream_time_base;  // of the current connection
+	int64_t frame_duration;       // in time_base, for packets without a duration
+
+	int64_t base_delay;           // ns
+	int max_attempts;
+
+	// Written by the demux stage only
+	int64_t ts_offset;            // added to the packets of the current connection
+	int64_t next_dts;             // expected after the last packet read
+	uint64_t last_packet;         // wall clock of that packet, of the setup before the first one
+	bool rebase;                  // new connection, waiting for its first keyframe
+
+	// Exported by the report
+	std::atomic<uint64_t> reconnects;
+	std::atomic<uint64_t> failed_attempts;
+	std::atomic<uint64_t> packets_dropped;
+	std::atomic<uint64_t> last_outage;    // ns, last packet of the old connection to first of the new
+	std::atomic<uint64_t> max_outage;
+	std::atomic<uint64_t> total_outage;
+};
+
+bool reconnect_enabled(const InputUtils *in_state, const TranscodeOptions *opts);
+// Demux stage, after av_read_frame() failed. Returns 0 once in_state reads
+// from a new connection, a negative error when the recording has to end.
+int input_reconnect(Reconnector *reconnector, InputUtils *in_state, const std::atomic<bool> &abort);
+// Demux stage, for every video packet. False drops the packet.
+bool reconnect_packet(Reconnector *reconnector, AVPacket *packet);
+// Same for a passthrough packet, dropped until the video resumed
+bool reconnect_aux_packet(const Reconnector *reconnector, AVPacket *packet, AVRational time_base);
+void reconnect_report(const Reconnector *reconnector);
+
+#endif
@@ -0,0 +1,45 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Extra outputs scaled and encoded from the decoded frames of a session
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#ifndef rendition_hpp
+#define rendition_hpp
+
+#include <memory>
+#include <string>
+#include "transcoder.hpp"
+#include "media_pool.hpp"
+#include "frame_converter.hpp"
+
+struct Pipeline;
+
+// One rung of the ladder. Decoded frames are shared by reference, the
+// rendition scales them with libswscale and runs its own encoder and muxer.
+// Its Pipeline runs inline: frame_queue feeds a thread of pipeline_run()
+// (or the session worker), encode and mux follow on the same thread.
+struct Rendition {
+	Rendition(const RenditionOptions &rendition_options);
+	~Rendition();
+
+	RenditionOptions options;
+	EncoderSettings settings;
+	std::string output_filename;
+	OutputUtils out_state;
+	std::unique_ptr<Pipeline> pipeline;
+
+	FrameConverter converter;       // to the size and pixel format of the rendition encoder
+};
+
+int rendition_open(Rendition *rendition, InputUtils *in_state, const char *main_filename, const TranscodeOptions *opts);
+// Returns a frame of the rendition pipeline's pool holding the scaled picture
+int rendition_scale(Rendition *rendition, const AVFrame *frame, AVFrame **scaled);
+
+#endif
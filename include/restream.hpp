@@ -0,0 +1,82 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ *
+ * @Brief   : Output stream served again as MPEG-TS over TCP to any number of local clients
+ *
+ * @Created : 17-Oct-2026
+ *
+ * @Updated : 17-Oct-2026
+ *
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#ifndef restream_hpp
+#define restream_hpp
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "transcoder.hpp"
+#include "spsc_queue.hpp"
+
+
+// One connected client. The mux thread queues references of the packets it
+// writes, the client thread muxes them into MPEG-TS on the socket. Only this
+// client waits for its socket, a full queue is handled by the drop policy.
+struct RestreamClient {
+	RestreamClient(int fd, const std::string &peer, size_t queue_depth);
+	~RestreamClient();      // after the thread ended, releases what is still queued
+
+	int fd;
+	std::string peer;
+	SpscQueue<AVPacket*> queue;         // mux thread -> client thread
+	bool keyframe_wait;                 // mux thread: nothing is queued before the next keyframe
+	std::atomic<bool> closing;          // ends the client thread without writing the rest
+	std::atomic<bool> finished;         // the client thread returned, the acceptor reaps it
+	std::thread thread;
+
+	std::atomic<uint64_t> sent;
+	std::atomic<uint64_t> dropped;
+};
+
+// Listens on [address:]port, 127.0.0.1 unless an address is given. Every
+// client that connects gets the video stream from the next keyframe on, so
+// one camera connection serves any number of viewers and recorders:
+//   ffplay tcp://127.0.0.1:8554
+// The packets are shared by reference, every client holds its own AVPacket
+// on the same buffer. A client whose queue is full loses the rest of the
+// GOP and goes on at the next keyframe, or is disconnected (RESTREAM_DROP_CLOSE).
+struct Restreamer {
+	Restreamer(const TranscodeOptions *opts);
+	~Restreamer();          // writes the queued packets to every client that keeps up, then disconnects all
+
+	std::string address;
+	std::string port;
+	size_t queue_depth;
+	RestreamDrop drop;
+
+	AVCodecParameters *params;          // of the restreamed packets
+	AVRational time_base;
+	int listen_fd;
+	std::atomic<bool> stopping;
+	std::thread acceptor;
+
+	std::mutex lock;                    // clients, between the acceptor, the mux thread and the report
+	std::vector<std::unique_ptr<RestreamClient>> clients;
+	uint64_t joined;
+	uint64_t left_sent;                 // counters of the clients already reaped
+	uint64_t left_dropped;
+	uint64_t too_slow;                  // clients disconnected by RESTREAM_DROP_CLOSE
+	std::atomic<uint64_t> packets;
+};
+
+// Listens on the restream address, returns 1 if the socket could not be bound
+int restream_open(Restreamer *restreamer, const OutputUtils *out_state);
+// From the mux thread, with every video packet in out_state->packet_time_base
+void restream_packet(Restreamer *restreamer, const AVPacket *packet);
+void restream_report(Restreamer *restreamer);
+
+#endif
@@ -0,0 +1,90 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ *
+ * @Brief   : Library interface, one camera transcoded inside another application
+ *
+ * @Created : 17-Oct-2026
+ *
+ * @Updated : 17-Oct-2026
+ *
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#ifndef rtsp_ffmpeg_hpp
+#define rtsp_ffmpeg_hpp
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include "transcoder.hpp"
+
+
+struct Pipeline;
+
+// One input transcoded on threads of its own, as rtsp_ffmpeg does for a
+// single camera. Nothing is shared with other sessions of the process: every
+// session stops on its own and owns all of its FFmpeg state.
+//
+// The callbacks see the encoded video packets and the decoded frames without
+// a copy. Both are reference counted, av_packet_ref()/av_frame_ref() keep
+// one past the callback. Packets arrive on the mux thread, frames on the
+// decode thread, so a slow callback holds that stage up.
+//
+//   RtspSession session("rtsp://camera/stream", "");    // no file, callbacks only
+//   session.set_packet_callback([&](const AVPacket *packet, AVRational time_base) { ... });
+//   if (session.start() == 0)
+//       session.wait();
+class RtspSession {
+public:
+	typedef std::function<void(const AVPacket *packet, AVRational time_base)> PacketCallback;
+	typedef std::function<void(const AVFrame *frame)> FrameCallback;
+
+	// An empty output_filename writes no file. Segments, snapshots and
+	// renditions then need file names of their own in the options.
+	RtspSession(const std::string &input_filename, const std::string &output_filename,
+		const TranscodeOptions &options = TranscodeOptions());
+	~RtspSession();     // stops the session and waits for it
+
+	RtspSession(const RtspSession &) = delete;
+	RtspSession &operator=(const RtspSession &) = delete;
+
+	// Set before start()
+	void set_packet_callback(PacketCallback callback);
+	void set_frame_callback(FrameCallback callback);   // never called in stream copy mode
+
+	// Opens the input and the output and starts the stages, 0 on success
+	int start();
+	// Ends the input, the frames already read are still encoded and written
+	void stop();
+	// Until the input ended or was stopped, returns 0 or the first error
+	int wait();
+	bool running() const { return active; }
+
+	// Of the packets the callback gets, valid once start() succeeded
+	const AVCodecParameters *codec_parameters() const { return params; }
+	AVRational time_base() const { return out_state.packet_time_base; }
+	const TranscodeOptions &options() const { return opts; }
+
+private:
+	std::string input_filename;
+	std::string output_filename;
+	TranscodeOptions opts;
+	InputUtils in_state;
+	OutputUtils out_state;
+	std::unique_ptr<Pipeline> pipeline;
+	AVCodecParameters *params;
+
+	PacketCallback packet_callback;
+	FrameCallback frame_callback;
+
+	std::thread runner;
+	std::atomic<bool> stop_request;
+	std::atomic<bool> active;
+	bool started;
+	bool closed;        // streams closed, wait() only returns the result
+	int result;
+};
+
+#endif
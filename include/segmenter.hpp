@@ -0,0 +1,54 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : GOP aligned segmented recording with rolling files and a manifest
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#ifndef segmenter_hpp
+#define segmenter_hpp
+
+#include <deque>
+#include <string>
+#include <vector>
+#include "transcoder.hpp"
+
+
+struct SegmentEntry {
+	int index;
+	std::string filename;
+	double duration;     // seconds
+};
+
+// Cuts the recording into numbered files. A cut happens on the first keyframe
+// after segment_time seconds or segment_size bytes, so every file starts with
+// a keyframe. It runs in the mux stage, the encoder is never waiting on it.
+struct Segmenter {
+	std::string pattern;             // printf pattern with a single %d
+	std::string manifest_filename;   // playlist of the finished segments
+	std::string format_name;
+	bool hls;                        // MPEG-TS segments in an HLS playlist, others in an ffconcat list
+	std::string filename;            // current segment
+
+	double segment_time;
+	int64_t segment_size;
+	int wrap;                        // segments kept on disk, 0 keeps all
+
+	int index;
+	int64_t start_pts;               // in the packet time base
+	int64_t end_pts;
+	std::vector<AVRational> time_bases;   // requested per stream, muxers may change them
+	std::deque<SegmentEntry> segments;
+};
+
+bool segmenter_enabled(const TranscodeOptions *opts);
+int segmenter_init(OutputUtils *out_state, const char *output_filename, const TranscodeOptions *opts);
+int segmenter_check(OutputUtils *out_state, AVPacket *packet);
+void segmenter_finish(OutputUtils *out_state);
+
+#endif
@@ -0,0 +1,53 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Several camera sessions in one process on a shared worker pool
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#ifndef session_hpp
+#define session_hpp
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "transcoder.hpp"
+#include "pipeline.hpp"
+
+
+// One input -> output mapping. The demuxer runs on the session's own I/O
+// thread (it mostly sleeps on the socket), decode/encode/mux run as tasks
+// on the worker pool shared by every session.
+struct Session {
+	int id;
+	std::string input_filename;
+	std::string output_filename;
+
+	InputUtils in_state;
+	OutputUtils out_state;
+	TranscodeOptions opts;
+	std::unique_ptr<Pipeline> pipeline;
+
+	std::thread io_thread;
+	std::atomic<bool> scheduled;    // a processing task is queued or running
+	std::atomic<int> pending;       // demuxing and processing both end before the streams are closed
+	std::atomic<bool> started;      // streams are open and the pipeline is set up
+	std::atomic<bool> finished;
+	std::mutex report_lock;         // the interval report against the closing of the streams
+	bool closing;                   // under report_lock, the streams are being or were closed
+	int result;
+};
+
+int load_sessions(const char *list_filename, const TranscodeOptions *opts,
+		std::vector<std::unique_ptr<Session>> &sessions);
+int run_sessions(std::vector<std::unique_ptr<Session>> &sessions, unsigned workers);
+
+#endif
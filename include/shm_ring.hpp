@@ -0,0 +1,132 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ *
+ * @Brief   : Decoded frames and encoded packets published to local processes through shared memory
+ *
+ * @Created : 17-Oct-2026
+ *
+ * @Updated : 17-Oct-2026
+ *
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#ifndef shm_ring_hpp
+#define shm_ring_hpp
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include "transcoder.hpp"
+
+
+// A ring is one POSIX shared memory object, /dev/shm/<name>_frames or
+// /dev/shm/<name>_packets: a ShmRingHeader followed by slot_count slots of
+// slot_size bytes, each a ShmSlot and its data. Item n goes to slot
+// n % slot_count and overwrites whatever was there, the publisher never
+// waits for a reader. Readers map the ring read-only and use the data in
+// place; the sequence of a slot tells them whether the item they read was
+// overwritten meanwhile (a seqlock), a reader that fell behind by more than
+// the ring skips ahead to the oldest item still kept.
+const uint32_t shm_ring_magic = 0x52534652;     // "RFSR"
+const uint32_t shm_ring_version = 1;
+const size_t shm_extradata_max = 4096;
+const size_t shm_packet_slot_size = 2 << 20;   // bytes of packet data per slot, larger packets are dropped
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory needs lock-free 64 bit atomics");
+
+enum ShmRingKind {
+	SHM_RING_FRAMES = 1,
+	SHM_RING_PACKETS = 2
+};
+
+struct ShmRingHeader {
+	uint32_t magic;                 // written last, the ring is complete once it matches
+	uint32_t version;
+	uint32_t kind;                  // ShmRingKind
+	uint32_t slot_count;
+	uint64_t slot_size;             // ShmSlot and data, multiple of 64
+	int32_t time_base_num;          // of pts/dts
+	int32_t time_base_den;
+	int32_t codec_id;               // packet rings: AVCodecID of the packets
+	int32_t width;                  // frame rings: geometry every frame has
+	int32_t height;
+	int32_t format;                 // AVPixelFormat
+	uint32_t extradata_size;        // packet rings: codec extradata, 0 when none or too large
+	std::atomic<uint32_t> closed;   // the publisher ended, nothing more will be written
+	std::atomic<uint64_t> written;  // items published so far, the newest is written - 1
+	uint8_t extradata[shm_extradata_max];
+};
+
+struct alignas(64) ShmSlot {
+	std::atomic<uint64_t> sequence; // 2n+1 while item n is written, 2n+2 once it is complete
+	uint32_t size;                  // bytes of data after the slot header
+	int32_t flags;                  // AV_PKT_FLAG_KEY for keyframes, packets and frames alike
+	int64_t pts;
+	int64_t dts;                    // packets only
+	int32_t linesize[4];            // frames: planes are packed without padding
+	uint32_t offset[4];             // frames: of every plane from the start of the data
+};
+
+// Publishing side of one ring, one writer thread
+struct ShmRing {
+	std::string name;               // without the leading slash
+	int fd;
+	uint8_t *base;
+	size_t size;
+	ShmRingHeader *header;
+	uint64_t written;
+};
+
+// Publishes the decoded frames (from the decode thread) and/or the encoded
+// video packets (from the mux thread) of one pipeline. The frame ring is
+// created on the first frame, once the decoder's pixel format is known.
+struct ShmPublisher {
+	ShmPublisher(const InputUtils *in, const TranscodeOptions *opts);
+	~ShmPublisher();
+
+	std::string name;
+	uint32_t slot_count;
+	bool publish_frames;
+	bool publish_packets;
+	AVRational frame_time_base;
+	bool frame_ring_failed;         // no frames are published after a failed create
+	ShmRing frames;
+	ShmRing packets;
+
+	// Read by the report from another thread
+	std::atomic<uint64_t> frames_published;
+	std::atomic<uint64_t> packets_published;
+	std::atomic<uint64_t> dropped;  // too large for a slot or of another geometry than the ring
+};
+
+int shm_publisher_open(ShmPublisher *publisher, const OutputUtils *out_state);
+void shm_publish_frame(ShmPublisher *publisher, const AVFrame *frame);
+void shm_publish_packet(ShmPublisher *publisher, const AVPacket *packet);
+void shm_publisher_report(const ShmPublisher *publisher);
+
+// Reading side, for the consuming processes
+struct ShmRingReader {
+	int fd;
+	const uint8_t *base;
+	size_t size;
+	const ShmRingHeader *header;
+	uint64_t next;                  // sequence of the next item to read
+	uint64_t skipped;               // items overwritten before this reader got to them
+};
+
+// Maps <name>_frames or <name>_packets read-only, reading starts at the newest
+// item. AVERROR(ENOENT) until the publisher created the ring and AVERROR(EAGAIN)
+// while it sets it up, both are worth a retry. The frame ring appears with the
+// first decoded frame.
+int shm_ring_open(ShmRingReader *reader, const char *name, ShmRingKind kind);
+// The next complete item, NULL when the reader is up to date. *sequence
+// receives the item number for shm_ring_valid().
+const ShmSlot *shm_ring_next(ShmRingReader *reader, uint64_t *sequence);
+// After using the data in place: false when the publisher overwrote it meanwhile
+bool shm_ring_valid(const ShmSlot *slot, uint64_t sequence);
+inline const uint8_t *shm_slot_data(const ShmSlot *slot) { return (const uint8_t *)(slot + 1); }
+// Only after a successful open. A ring whose header has closed set gets no
+// more items, the publisher may have created a new one under the same name.
+void shm_ring_close(ShmRingReader *reader);
+
+#endif
@@ -0,0 +1,69 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : JPEG/PNG thumbnails decoded from keyframes only
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#ifndef snapshot_hpp
+#define snapshot_hpp
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include "transcoder.hpp"
+#include "latency.hpp"
+#include "spsc_queue.hpp"
+extern "C" {
+	#include <libswscale/swscale.h>
+}
+
+// Takes a thumbnail from a keyframe once per interval. It has its own
+// keyframe only decoder (AVDISCARD_NONKEY) and image encoder, both opened
+// once and reused, so the recording path is untouched and works the same
+// in stream copy mode. The demux thread only hands a reference to the due
+// keyframe over, the snapshot thread decodes, encodes and writes it. A
+// keyframe that comes while the previous snapshot is still busy is skipped,
+// the next one is taken instead.
+struct Snapshotter {
+	Snapshotter(const InputUtils *in, const TranscodeOptions *opts);
+	~Snapshotter();
+
+	InputUtils in_state;            // shares the input stream, owns the decoder
+	AVCodecContext *encoder_ctx;
+	SwsContext *sws;
+	AVFrame *frame;                 // decoded keyframe
+	AVFrame *picture;               // scaled for the image encoder
+	AVPacket *packet;               // encoded image
+
+	SpscQueue<AVPacket*> queue;     // demux thread -> snapshot thread, one keyframe
+	std::atomic<bool> busy;         // a keyframe is queued or being turned into a snapshot
+	std::atomic<bool> closing;
+	std::thread thread;
+
+	enum AVCodecID codec_id;
+	std::string pattern;            // a %d is replaced by the snapshot number
+	int width;                      // as requested, resolved per decoded size
+	int height;
+	int64_t interval;               // in the input stream time base
+	int64_t last_pts;
+	int index;
+
+	// Read by the report from another thread
+	std::atomic<uint64_t> written;
+	std::atomic<uint64_t> failed;
+	std::atomic<uint64_t> skipped;  // due while the previous snapshot was busy
+	LatencyHistogram latency;       // decode, scale, encode and write of one snapshot
+};
+
+int snapshot_open(Snapshotter *snapshotter, const char *main_filename);
+// Called for every demuxed video packet from the demux thread, never waits
+void snapshot_packet(Snapshotter *snapshotter, const AVPacket *packet);
+void snapshot_report(const Snapshotter *snapshotter);
+
+#endif
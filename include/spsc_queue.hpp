@@ -0,0 +1,137 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Bounded lock-free single-producer/single-consumer queue
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#ifndef spsc_queue_hpp
+#define spsc_queue_hpp
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+
+// Ring of fixed capacity connecting exactly one producer thread to exactly one
+// consumer thread. Used to hand refcounted AVPacket/AVFrame pointers between
+// the pipeline stages, so T is expected to be a cheap copyable handle.
+template <typename T>
+class SpscQueue {
+public:
+	explicit SpscQueue(size_t capacity)
+		: capacity_(capacity ? capacity : 1), head_(0), tail_(0), closed_(false), peak_(0)
+	{
+		// storage is rounded up to a power of two so indices can be masked,
+		// the usable depth stays exactly what was asked for
+		size_t storage = 1;
+		while (storage < capacity_)
+			storage <<= 1;
+		slots_.resize(storage);
+		mask_ = storage - 1;
+	}
+
+	SpscQueue(const SpscQueue &) = delete;
+	SpscQueue &operator=(const SpscQueue &) = delete;
+
+	// Producer side. Returns false when the queue is full.
+	bool try_push(const T &item)
+	{
+		const size_t tail = tail_.load(std::memory_order_relaxed);
+		const size_t head = head_.load(std::memory_order_acquire);
+		if (tail - head >= capacity_)
+			return false;
+		slots_[tail & mask_] = item;
+		tail_.store(tail + 1, std::memory_order_release);
+
+		const size_t occupancy = tail + 1 - head;
+		if (occupancy > peak_.load(std::memory_order_relaxed))
+			peak_.store(occupancy, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Consumer side. Returns false when the queue is empty.
+	bool try_pop(T &item)
+	{
+		const size_t head = head_.load(std::memory_order_relaxed);
+		const size_t tail = tail_.load(std::memory_order_acquire);
+		if (head == tail)
+			return false;
+		item = slots_[head & mask_];
+		head_.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Blocks while the queue is full. Returns false if abort was raised first.
+	bool push(const T &item, const std::atomic<bool> &abort)
+	{
+		unsigned spins = 0;
+		while (!try_push(item)) {
+			if (abort.load(std::memory_order_relaxed))
+				return false;
+			backoff(spins);
+		}
+		return true;
+	}
+
+	// Blocks while the queue is empty. Returns false once the producer has
+	// closed the queue and everything was drained, or if abort was raised.
+	bool pop(T &item, const std::atomic<bool> &abort)
+	{
+		unsigned spins = 0;
+		while (!try_pop(item)) {
+			if (closed_.load(std::memory_order_acquire))
+				return try_pop(item);
+			if (abort.load(std::memory_order_relaxed))
+				return false;
+			backoff(spins);
+		}
+		return true;
+	}
+
+	// Called by the producer after its last push.
+	void close() { closed_.store(true, std::memory_order_release); }
+	bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+	// Approximate when read from a third thread, good enough for reporting.
+	size_t size() const
+	{
+		const size_t tail = tail_.load(std::memory_order_acquire);
+		const size_t head = head_.load(std::memory_order_acquire);
+		return tail - head;
+	}
+	size_t capacity() const { return capacity_; }
+	size_t peak() const { return peak_.load(std::memory_order_relaxed); }
+
+	// Spin briefly, then yield, then sleep so an idle stage does not burn a core.
+	// Public for stages polling more than one queue.
+	static void backoff(unsigned &spins)
+	{
+		if (spins < 64)
+			++spins;
+		else if (spins < 128) {
+			++spins;
+			std::this_thread::yield();
+		}
+		else
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+	}
+
+private:
+	std::vector<T> slots_;
+	size_t mask_;
+	const size_t capacity_;
+	alignas(64) std::atomic<size_t> head_;    // written by the consumer only
+	alignas(64) std::atomic<size_t> tail_;    // written by the producer only
+	alignas(64) std::atomic<bool> closed_;
+	std::atomic<size_t> peak_;                // written by the producer only
+};
+
+#endif
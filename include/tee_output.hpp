@@ -0,0 +1,70 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ *
+ * @Brief   : Packets of the output written to further containers, without encoding them again
+ *
+ * @Created : 17-Oct-2026
+ *
+ * @Updated : 17-Oct-2026
+ *
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#ifndef tee_output_hpp
+#define tee_output_hpp
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "transcoder.hpp"
+#include "spsc_queue.hpp"
+
+
+// One more container for the packets of the main output. The mux thread
+// queues references, the sink's own thread muxes them, so a slow or broken
+// sink never holds up or fails the main output. A sink that fails stops
+// alone, one whose queue is full goes on at the next video keyframe.
+struct TeeSink {
+	TeeSink(const std::string &spec);
+	~TeeSink();             // after the thread ended, releases what is still queued
+
+	std::string url;
+	std::string format;                 // empty: guessed from the url
+	AVFormatContext *fmt_ctx;
+	int fd;                             // pipe or FIFO written through its own AVIOContext, -1 otherwise
+	std::vector<int> stream_map;        // main output stream -> sink stream, -1 when the container cannot hold it
+	std::vector<AVRational> time_base;  // of every main output stream
+	std::vector<int64_t> last_dts;      // per sink stream, in its time base
+	SpscQueue<AVPacket*> queue;         // mux thread -> sink thread
+	bool keyframe_wait;                 // mux thread: nothing is queued before the next video keyframe
+	std::atomic<bool> closing;          // interrupts a network or pipe write at the end
+	std::atomic<bool> failed;
+	std::atomic<bool> finished;         // the sink thread returned
+	std::thread thread;
+
+	uint64_t queued;                    // mux thread
+	std::atomic<uint64_t> packets;
+	std::atomic<uint64_t> bytes;
+	std::atomic<uint64_t> dropped;
+};
+
+// All sinks of one output, the packets are encoded once whatever their number
+struct TeeOutput {
+	std::vector<std::unique_ptr<TeeSink>> sinks;
+	int video_index;                    // output stream of the video, keyframes resync a sink
+};
+
+// After open_output_stream(): every sink gets the streams of the main output.
+// A sink that cannot be opened is left out with an error, the others and the
+// main output go on. Returns 1 only when memory runs out. A pipe sink whose
+// reader went away fails with EPIPE, as long as the process ignores SIGPIPE.
+int tee_open(OutputUtils *out_state, const TranscodeOptions *opts);
+// Packets already rescaled for the main output, from the mux thread
+void tee_write(TeeOutput *tee, const AVPacket *packet);
+// Waits for every sink to write its queue and the trailer
+void tee_close(OutputUtils *out_state);
+void tee_report(const TeeOutput *tee);
+
+#endif
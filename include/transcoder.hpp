@@ -13,7 +13,11 @@
 #ifndef transcoder_hpp
 #define transcoder_hpp
 
+#include <atomic>
 #include <iostream>
+#include <cstddef>
+#include <string>
+#include <vector>
 #include <signal.h>
 #include <experimental/filesystem>  // used for calculating the output file size
 extern "C" {
@@ -34,6 +38,13 @@ struct InputUtils {
     AVFrame *input_frame;
     AVPacket *input_packet;
     AVRational input_framerate;
+    AVRational input_time_base;        // of the video stream, kept across reconnects
+    int video_stream_idx;
+    struct FrameBufferPool *frame_buffer_pool;   // backs the decoder's get_buffer2
+    int64_t io_timeout;                // ns a blocking read may take, 0 for no limit
+    int64_t io_deadline;               // armed before every blocking call on the input
+    bool probe_cached;                 // the probe was shortened with known stream parameters
+    const std::atomic<bool> *stop_request;   // stops this input, NULL when only its end does
 };
 
 // Output Utilities
@@ -42,16 +53,180 @@ struct OutputUtils {
     AVStream *output_stream;
     const AVCodec *output_codec;
     AVCodecContext *output_codec_ctx;
+    AVRational packet_time_base;       // time base of the packets handed to write_packet()
+    int64_t copy_ts_offset;            // first input DTS in stream copy mode
+    int64_t last_dts;                  // last written DTS, in the output stream time base
+    struct Segmenter *segmenter;       // rolls the output over to new files, NULL when off
+    uint64_t start_time;               // wall clock the input was opened at, 0 once a packet was written
+    struct AuxStreams *aux_streams;    // audio and other streams copied as they are, NULL when none
+    AVDictionary *muxer_options;       // for every header written, segments included
+    const struct WriterSettings *writer;   // NULL or synchronous: files are opened with avio_open()
+    struct AsyncWriter *async_writer;  // behind output_fmt_ctx->pb while a file is open through it
+    bool fragmented;                   // fragmented MP4, flushed to the file on every keyframe
+    struct TeeOutput *tee;             // further containers of the same packets, NULL when none
+    bool trailer_written;              // a segment cut closed the file and could not open the next one
 };
 
-void inthand(int signum);
-int open_input_stream(InputUtils *in_state, const char *input_filename);
-int setup_decoder(InputUtils *in_state);
+// When packets are written as they come instead of being re-encoded
+enum CopyMode {
+    COPY_AUTO,      // copy when the input already uses the codec of the requested encoder
+    COPY_ALWAYS,
+    COPY_NEVER
+};
+
+// What a live input does when the encoder falls behind real time
+enum DropPolicy {
+    DROP_AUTO,      // drop for network inputs and paced files, wait for other files
+    DROP_NEVER,
+    DROP_FRAMES
+};
+
+// What happens when the input connection is lost or ends
+enum ReconnectPolicy {
+    RECONNECT_AUTO,     // reconnect network inputs, files end the recording
+    RECONNECT_NEVER,
+    RECONNECT_ALWAYS    // files are opened again too, which loops them
+};
+
+// Part of the picture watched for motion, in fractions of the width and height
+struct MotionRegion {
+    double x, y, w, h;
+};
+
+// Frames per GOP of the x264/x265 encoders, every GOP starts with an IDR
+const int encoder_gop_size = 60;
+
+// What one encoder produces, the main output and every extra rendition have their own
+struct EncoderSettings {
+    const char *encoder_name;
+    int width;                  // 0 keeps the input size
+    int height;
+    const char *crf;            // NULL keeps the default of the codec
+    const char *preset;
+    int threads;                // 0 keeps the libav default
+    bool repeat_headers;        // x264/x265: SPS/PPS before every keyframe, even with global headers
+};
+
+// How output files are written, see AsyncWriter
+struct WriterSettings {
+    bool async = true;                 // local files go through a writer thread
+    size_t buffer_size = 1 << 20;      // bytes per write
+    size_t max_buffered = 64 << 20;    // bytes queued for the disk before the muxer waits
+    int64_t preallocate = 64 << 20;    // bytes reserved ahead with fallocate(), 0 disables
+    double fsync_interval = -1;        // s between fdatasync() calls, 0 only on close, < 0 never
+};
+
+// Extra output encoded from the same decoded frames, see Rendition
+struct RenditionOptions {
+    std::string output_filename;   // empty: <output>_<height>p.<ext>
+    std::string encoder_name;      // empty: same as the main output
+    int width = 0;                 // -1 follows the aspect ratio of the input
+    int height = 0;
+    std::string crf;
+    std::string preset;
+};
+
+// Input streams besides the video that are copied into the output
+enum Passthrough {
+    PASSTHROUGH_AUDIO,
+    PASSTHROUGH_ALL,    // audio, subtitles and data
+    PASSTHROUGH_NONE
+};
+
+// What happens to a restream client whose queue is full, see Restreamer
+enum RestreamDrop {
+    RESTREAM_DROP_GOP,      // the rest of the GOP is dropped, the client goes on at the next keyframe
+    RESTREAM_DROP_CLOSE     // the client is disconnected
+};
+
+// Transcoding options, filled from the command line
+struct TranscodeOptions {
+    const char *encoder_name = "libx264";
+    const char *crf = NULL;            // rate factor of the main output, NULL keeps the codec default
+    const char *preset = NULL;
+    int width = 0;                     // of the main output, 0 keeps the input size, -1 follows the aspect ratio
+    int height = 0;
+    CopyMode copy_mode = COPY_AUTO;
+    bool stream_copy = false;          // resolved from copy_mode once the input is probed
+    int codec_threads = 0;             // decoder/encoder threads, 0 keeps the libav default
+    size_t packet_queue_depth = 256;   // demuxed packets waiting for the decoder
+    size_t frame_queue_depth = 8;      // decoded frames waiting for the encoder
+    size_t mux_queue_depth = 256;      // encoded packets waiting for the muxer
+    int stats_interval = 10;           // seconds between queue/latency reports, 0 disables
+    DropPolicy drop_policy = DROP_AUTO;
+    double max_lag = 1000;             // ms behind real time before frames are dropped
+    bool realtime = false;             // read no faster than the video timestamps, as a camera would send
+    ReconnectPolicy reconnect = RECONNECT_AUTO;
+    double reconnect_delay = 500;      // ms before the first attempt, doubled per failure
+    int reconnect_attempts = 0;        // in a row before giving up, 0 retries forever
+    double read_timeout = 10;          // s without input data before the connection counts as lost
+    const char *probe_cache = NULL;    // directory of the stream parameters per input URL, NULL disables
+    Passthrough passthrough = PASSTHROUGH_AUDIO;
+    bool fragmented = false;           // MP4/MOV as a series of keyframe aligned fragments
+    double fragment_time = 0;          // s, shortest fragment, 0 starts one on every keyframe
+    WriterSettings writer;
+    const char *shm_name = NULL;       // publish to /dev/shm/<name>_frames and _packets, NULL disables
+    bool shm_frames = true;            // decoded frames, re-encoding only
+    bool shm_packets = false;          // encoded video packets
+    int shm_slots = 8;                 // items each ring keeps for slow readers
+    const char *restream = NULL;       // [address:]port serving the output as MPEG-TS over TCP, NULL disables
+    size_t restream_queue = 128;       // packets queued per restream client
+    RestreamDrop restream_drop = RESTREAM_DROP_GOP;
+    std::vector<std::string> tee_outputs;   // "[f=<format>]<url>" written with the same packets as the output
+    bool adaptive = false;             // step preset/CRF with the measured encode time
+    const char *adaptive_slowest = "medium";   // slowest preset the controller may reach
+    int adaptive_crf_range = 8;        // CRF the controller may add to the configured one
+    double segment_time = 0;           // seconds per recorded segment, 0 disables
+    int64_t segment_size = 0;          // bytes per recorded segment, 0 disables
+    int segment_wrap = 0;              // segments kept on disk, 0 keeps all
+    bool event_mode = false;           // write only around events, see EventRecorder
+    double pre_event = 10;             // seconds kept in memory ahead of an event
+    double post_event = 30;            // seconds written after the last trigger
+    int64_t event_memory = 64000000;   // bytes the pre-event ring may hold per session
+    const char *event_trigger = NULL;  // touching this file triggers an event
+    bool motion_detect = false;        // skip encoding frames of a static scene
+    double motion_threshold = 10;      // mean luma difference of a changed 16x16 block
+    double motion_area = 0.5;          // percent of the region blocks that must change
+    double motion_hold = 2;            // seconds every frame is encoded after motion
+    double motion_idle_fps = 1;        // frames encoded per second of a static scene
+    std::vector<MotionRegion> motion_regions;   // empty watches the whole picture
+    std::vector<RenditionOptions> renditions;   // encoded from the decoded frames of the main output
+    double snapshot_interval = 0;      // seconds between keyframe snapshots, 0 disables
+    const char *snapshot_format = "jpeg";   // jpeg or png
+    const char *snapshot_filename = NULL;   // NULL: <output>_snapshot.<ext>, a %d numbers them
+    int snapshot_width = 0;            // 0 keeps the input size, -1 follows the aspect ratio
+    int snapshot_height = 0;
+};
+
+struct Pipeline;
+struct LatencySnapshot;
+
+bool input_stopped(const InputUtils *in_state);
+void input_arm_timeout(InputUtils *in_state);
+int open_input_stream(InputUtils *in_state, const char *input_filename, const struct ProbeInfo *hint);
+int find_video_stream(InputUtils *in_state);
+int setup_decoder(InputUtils *in_state, int threads, enum AVDiscard skip_frame);
+void scaled_size(int input_width, int input_height, int *width, int *height);
 int setup_output_stream(OutputUtils *out_state, const char *output_filename);
-int setup_encoder(InputUtils *in_state, OutputUtils *out_state);
+bool use_stream_copy(InputUtils *in_state, const TranscodeOptions *opts);
+int setup_stream_copy(InputUtils *in_state, OutputUtils *out_state);
+EncoderSettings main_encoder_settings(const TranscodeOptions *opts);
+int open_encoder(InputUtils *in_state, OutputUtils *out_state, const EncoderSettings *settings);
+int setup_encoder(InputUtils *in_state, OutputUtils *out_state, const EncoderSettings *settings);
+void setup_muxer_options(OutputUtils *out_state, const TranscodeOptions *opts);
 int open_output_stream(OutputUtils *out_state, const char *output_filename);
-int encode(InputUtils *in_state, OutputUtils *out_state);
-int transcode(InputUtils *in_state, OutputUtils *out_state);
+int decode(InputUtils *in_state, AVPacket *packet, Pipeline *pipeline);
+int encode(InputUtils *in_state, OutputUtils *out_state, AVFrame *frame, Pipeline *pipeline);
+int rebase_packet(InputUtils *in_state, OutputUtils *out_state, AVPacket *packet);
+int write_packet(OutputUtils *out_state, AVPacket *packet);
+int transcode(InputUtils *in_state, OutputUtils *out_state, const TranscodeOptions *opts,
+		LatencySnapshot latency[] = NULL);
+int setup_streams(InputUtils *in_state, OutputUtils *out_state, TranscodeOptions *opts,
+		const char *input_filename, const char *output_filename);
+void print_output_size(const char *output_filename);
+void close_output_file(OutputUtils *out_state);
+void close_output_stream(OutputUtils *out_state);
 void close_streams(InputUtils *in_state, OutputUtils *out_state);
+void free_streams(InputUtils *in_state, OutputUtils *out_state);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,55 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Fixed size pool of worker threads shared by all camera sessions
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#ifndef worker_pool_hpp
+#define worker_pool_hpp
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Runs submitted tasks on a bounded number of threads, first in first out.
+// A task that has more work left re-submits itself, which puts it behind
+// every other session and keeps the scheduling fair.
+class WorkerPool {
+public:
+	// 0 threads means one per online core
+	explicit WorkerPool(unsigned threads);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool &) = delete;
+	WorkerPool &operator=(const WorkerPool &) = delete;
+
+	void submit(std::function<void()> task);
+
+	// Blocks until the queue is empty and no task is running
+	void wait_idle();
+
+	unsigned size() const { return workers.size(); }
+
+private:
+	void worker_loop();
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex lock;
+	std::condition_variable task_ready;
+	std::condition_variable idle;
+	unsigned active;
+	bool shutdown;
+};
+
+#endif
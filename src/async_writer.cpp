@@ -0,0 +1,352 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Output files written by a dedicated thread through a custom AVIOContext
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#include "../include/async_writer.hpp"
+#include "../include/latency.hpp"
+#include "../include/logger.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+// The AVIO write callback lost its non-const buffer in libavformat 61
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+typedef const uint8_t avio_write_buffer;
+#else
+typedef uint8_t avio_write_buffer;
+#endif
+
+static const size_t buffer_alignment = 4096;   // page aligned buffers for the kernel, freed with free()
+static const unsigned max_batch = 64;   // writes submitted to io_uring at once
+
+static size_t buffer_count(const WriterSettings *settings)
+{
+	return std::max<size_t>(2, settings->max_buffered / settings->buffer_size);
+}
+
+AsyncWriter::AsyncWriter(const WriterSettings *writer_settings, int file, const char *name)
+	: settings(writer_settings), fd(file), filename(name),
+	  requests(buffer_count(writer_settings)), allocated(0),
+	  pending(buffer_count(writer_settings)), done(buffer_count(writer_settings)),
+	  failed(false), error(0),
+	  position(0), size(0), waits(0), wait_time(0),
+	  reserved(0), last_sync(latency_now()), bytes(0), writes(0), max_write_time(0), syncs(0)
+{
+}
+
+AsyncWriter::~AsyncWriter()
+{
+	for (size_t i = 0; i < allocated; i++)
+		free(requests[i].data);
+	if (fd >= 0)
+		close(fd);
+}
+
+bool async_writer_usable(const char *filename)
+{
+	if (!strncmp(filename, "file:", 5))
+		return true;
+	return !strstr(filename, "://") && strncmp(filename, "pipe:", 5) != 0 && strcmp(filename, "-") != 0;
+}
+
+static void writer_fail(AsyncWriter *writer, int error)
+{
+	int expected = 0;
+	if (writer->error.compare_exchange_strong(expected, error)) {
+		char errorBuff[80];
+		log_message(LOG_LEVEL_ERROR, "Writing %s failed: %s\n", writer->filename.c_str(), av_make_error_string(errorBuff, 80, error));
+	}
+	writer->failed = true;
+}
+
+// Reserving the space in large steps keeps the file contiguous on disk and
+// the block allocation out of the individual writes
+static void writer_reserve(AsyncWriter *writer, int64_t end)
+{
+	int64_t step = writer->settings->preallocate;
+	if (step <= 0 || end <= writer->reserved)
+		return;
+	int64_t length = std::max(step, end - writer->reserved);
+	if (fallocate(writer->fd, FALLOC_FL_KEEP_SIZE, writer->reserved, length) != 0) {
+		// Not every file system has it, the writes work all the same
+		log_message(LOG_LEVEL_DEBUG, "fallocate on %s: %s\n", writer->filename.c_str(), strerror(errno));
+		writer->reserved = INT64_MAX;
+		return;
+	}
+	writer->reserved += length;
+}
+
+static void writer_sync(AsyncWriter *writer)
+{
+	double interval = writer->settings->fsync_interval;
+	uint64_t now = latency_now();
+	if (interval <= 0 || now - writer->last_sync < (uint64_t)(interval * 1e9))
+		return;
+	if (fdatasync(writer->fd) != 0)
+		writer_fail(writer, AVERROR(errno));
+	writer->last_sync = now;
+	writer->syncs++;
+}
+
+// Whatever a short write or an interrupted call left over
+static void write_rest(AsyncWriter *writer, const WriteRequest *request, size_t written)
+{
+	while (written < request->size) {
+		ssize_t ret = pwrite(writer->fd, request->data + written, request->size - written, request->offset + written);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0) {
+			writer_fail(writer, ret < 0 ? AVERROR(errno) : AVERROR(EIO));
+			return;
+		}
+		written += ret;
+	}
+}
+
+static void write_done(AsyncWriter *writer, WriteRequest *request, uint64_t start)
+{
+	uint64_t elapsed = latency_now() - start;
+	if (elapsed > writer->max_write_time)
+		writer->max_write_time = elapsed;
+	writer->bytes += request->size;
+	writer->writes++;
+
+	std::atomic<bool> never(false);
+	writer->done.push(request, never);
+}
+
+static void writer_loop(AsyncWriter *writer)
+{
+	std::atomic<bool> never(false);
+	WriteRequest *request;
+
+	while (writer->pending.pop(request, never)) {
+		writer_reserve(writer, request->offset + request->size);
+		uint64_t start = latency_now();
+		if (!writer->failed)
+			write_rest(writer, request, 0);
+		write_done(writer, request, start);
+		writer_sync(writer);
+	}
+}
+
+#ifdef HAVE_LIBURING
+// Everything queued goes to the kernel in one submission. A write that lands
+// below the end of the ones before it (the muxer patching a header) drains
+// the ring first, so it cannot be overtaken by older data.
+static bool writer_loop_uring(AsyncWriter *writer)
+{
+	struct io_uring ring;
+	if (io_uring_queue_init(max_batch, &ring, 0) < 0)
+		return false;
+
+	std::atomic<bool> never(false);
+	WriteRequest *batch[max_batch];
+
+	while (writer->pending.pop(batch[0], never)) {
+		unsigned count = 1;
+		while (count < max_batch && writer->pending.try_pop(batch[count]))
+			count++;
+		uint64_t start = latency_now();
+		// After an error the buffers only go back to the muxer
+		if (writer->failed) {
+			for (unsigned i = 0; i < count; i++)
+				write_done(writer, batch[i], start);
+			continue;
+		}
+
+		int64_t end = 0;
+		for (unsigned i = 0; i < count; i++) {
+			WriteRequest *request = batch[i];
+			writer_reserve(writer, request->offset + request->size);
+			struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+			io_uring_prep_write(sqe, writer->fd, request->data, request->size, request->offset);
+			if (i > 0 && request->offset < end)
+				sqe->flags |= IOSQE_IO_DRAIN;
+			io_uring_sqe_set_data(sqe, request);
+			end = std::max<int64_t>(end, request->offset + request->size);
+		}
+
+		int ret = io_uring_submit(&ring);
+		if (ret < 0)
+			writer_fail(writer, ret);
+		unsigned submitted = ret > 0 ? ret : 0;
+		for (unsigned i = 0; i < submitted; i++) {
+			struct io_uring_cqe *cqe;
+			if (io_uring_wait_cqe(&ring, &cqe) < 0)
+				break;
+			WriteRequest *request = (WriteRequest *)io_uring_cqe_get_data(cqe);
+			if (cqe->res < 0)
+				writer_fail(writer, cqe->res);
+			else if (!writer->failed)
+				write_rest(writer, request, cqe->res);
+			io_uring_cqe_seen(&ring, cqe);
+			write_done(writer, request, start);
+		}
+		// Requests the kernel never took are returned unwritten
+		if (submitted < count) {
+			writer_fail(writer, AVERROR(EIO));
+			for (unsigned i = submitted; i < count; i++)
+				write_done(writer, batch[i], start);
+		}
+		writer_sync(writer);
+	}
+	io_uring_queue_exit(&ring);
+	return true;
+}
+#endif
+
+static void writer_thread(AsyncWriter *writer)
+{
+#ifdef HAVE_LIBURING
+	if (writer_loop_uring(writer))
+		return;
+#endif
+	writer_loop(writer);
+}
+
+// Muxer side: a free buffer, waiting only when all of them are queued
+static WriteRequest *writer_buffer(AsyncWriter *writer)
+{
+	WriteRequest *request;
+	if (writer->done.try_pop(request))
+		return request;
+	if (writer->allocated < writer->requests.size()) {
+		request = &writer->requests[writer->allocated];
+		void *data;
+		if (posix_memalign(&data, buffer_alignment, writer->settings->buffer_size) != 0)
+			return NULL;
+		request->data = (uint8_t *)data;
+		writer->allocated++;
+		return request;
+	}
+
+	uint64_t start = latency_now();
+	writer->waits++;
+	if (writer->waits == 1)
+		log_message(LOG_LEVEL_WARNING, "Disk is %zu MB behind on %s, the muxer waits for it\n",
+			writer->settings->max_buffered >> 20, writer->filename.c_str());
+	bool ok = writer->done.pop(request, writer->failed);
+	writer->wait_time += latency_now() - start;
+	return ok ? request : NULL;
+}
+
+static int writer_write(void *opaque, avio_write_buffer *buffer, int buffer_size)
+{
+	AsyncWriter *writer = (AsyncWriter *)opaque;
+	int written = 0;
+
+	while (written < buffer_size) {
+		if (writer->error)
+			return writer->error;
+		WriteRequest *request = writer_buffer(writer);
+		if (!request)
+			return writer->error ? writer->error.load() : AVERROR(ENOMEM);
+
+		request->size = std::min<size_t>(buffer_size - written, writer->settings->buffer_size);
+		request->offset = writer->position;
+		memcpy(request->data, buffer + written, request->size);
+		writer->pending.push(request, writer->failed);
+
+		writer->position += request->size;
+		writer->size = std::max(writer->size, writer->position);
+		written += request->size;
+	}
+	return written;
+}
+
+// Only moves the position, the writes carry their offsets
+static int64_t writer_seek(void *opaque, int64_t offset, int whence)
+{
+	AsyncWriter *writer = (AsyncWriter *)opaque;
+
+	if (whence & AVSEEK_SIZE)
+		return writer->size;
+	switch (whence & ~AVSEEK_FORCE) {
+	case SEEK_SET:
+		writer->position = offset;
+		break;
+	case SEEK_CUR:
+		writer->position += offset;
+		break;
+	case SEEK_END:
+		writer->position = writer->size + offset;
+		break;
+	default:
+		return AVERROR(EINVAL);
+	}
+	return writer->position;
+}
+
+int async_writer_open(OutputUtils *out_state, const char *filename)
+{
+	const WriterSettings *settings = out_state->writer;
+	const char *path = strncmp(filename, "file:", 5) ? filename : filename + 5;
+
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		log_message(LOG_LEVEL_ERROR, "Could not open outputfile %s: %s\n", path, strerror(errno));
+		return 1;
+	}
+	AsyncWriter *writer = new AsyncWriter(settings, fd, path);
+
+	// The AVIOContext owns its buffer and may free it, only the write buffers are page aligned
+	uint8_t *buffer = (uint8_t *)av_malloc(settings->buffer_size);
+	AVIOContext *pb = buffer ? avio_alloc_context(buffer, (int)settings->buffer_size, 1, writer, NULL, writer_write, writer_seek) : NULL;
+	if (!pb) {
+		av_free(buffer);
+		delete writer;
+		return 1;
+	}
+	writer->thread = std::thread(writer_thread, writer);
+	out_state->output_fmt_ctx->pb = pb;
+	out_state->async_writer = writer;
+	return 0;
+}
+
+int async_writer_close(OutputUtils *out_state)
+{
+	AsyncWriter *writer = out_state->async_writer;
+	AVIOContext *&pb = out_state->output_fmt_ctx->pb;
+
+	avio_flush(pb);
+	writer->pending.close();
+	writer->thread.join();
+
+	int ret = writer->error;
+	// Hand back the reserved space past the end of the file
+	if (writer->settings->preallocate > 0 && ftruncate(writer->fd, writer->size) != 0 && !ret)
+		ret = AVERROR(errno);
+	if (writer->settings->fsync_interval >= 0 && fdatasync(writer->fd) != 0 && !ret)
+		ret = AVERROR(errno);
+	if (ret < 0 && !writer->error) {
+		char errorBuff[80];
+		log_message(LOG_LEVEL_ERROR, "Closing %s failed: %s\n", writer->filename.c_str(), av_make_error_string(errorBuff, 80, ret));
+	}
+
+	log_message(LOG_LEVEL_DEBUG, "Wrote %s: %.2f MB in %llu writes, slowest %.1f ms, %llu syncs, muxer waited %llu times for %.1f ms\n",
+		writer->filename.c_str(), writer->bytes / 1e6, (unsigned long long)writer->writes, writer->max_write_time / 1e6,
+		(unsigned long long)writer->syncs, (unsigned long long)writer->waits, writer->wait_time / 1e6);
+	if (writer->waits > 0)
+		log_message(LOG_LEVEL_WARNING, "The muxer waited %.1f ms in total for the disk writing %s\n", writer->wait_time / 1e6, writer->filename.c_str());
+
+	av_freep(&pb->buffer);
+	avio_context_free(&pb);
+	delete writer;
+	out_state->async_writer = NULL;
+	return ret;
+}
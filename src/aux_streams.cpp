@@ -0,0 +1,137 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Audio and other streams copied into the output next to the video
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#include "../include/aux_streams.hpp"
+#include "../include/event_recorder.hpp"
+#include "../include/tee_output.hpp"
+#include "../include/logger.hpp"
+
+static bool passthrough_type(enum AVMediaType type, enum Passthrough passthrough)
+{
+	if (passthrough == PASSTHROUGH_ALL)
+		return type == AVMEDIA_TYPE_AUDIO || type == AVMEDIA_TYPE_SUBTITLE || type == AVMEDIA_TYPE_DATA;
+	return passthrough == PASSTHROUGH_AUDIO && type == AVMEDIA_TYPE_AUDIO;
+}
+
+int aux_streams_setup(InputUtils *in_state, OutputUtils *out_state, const TranscodeOptions *opts)
+{
+	// Linking variables
+	auto &input_fmt_ctx = in_state->input_fmt_ctx;
+	auto &output_fmt_ctx = out_state->output_fmt_ctx;
+	char errorBuff[80];
+
+	if (opts->passthrough == PASSTHROUGH_NONE)
+		return 0;
+	// The event ring is cut on video keyframes and holds video packets only
+	if (event_recording_enabled(opts)) {
+		log_message(LOG_LEVEL_INFO, "Event recording writes the video stream only\n");
+		return 0;
+	}
+
+	AuxStreams *aux = new AuxStreams();
+	aux->by_input.assign(input_fmt_ctx->nb_streams, -1);
+	aux->packets = 0;
+	aux->bytes = 0;
+	aux->dropped = 0;
+	out_state->aux_streams = aux;
+
+	for (unsigned i = 0; i < input_fmt_ctx->nb_streams; ++i) {
+		AVStream *input_stream = input_fmt_ctx->streams[i];
+		AVCodecParameters *params = input_stream->codecpar;
+		if ((int)i == in_state->video_stream_idx)
+			continue;
+		if (!passthrough_type(params->codec_type, opts->passthrough)) {
+			input_stream->discard = AVDISCARD_ALL;
+			continue;
+		}
+		// G.711 from a camera does not fit in MP4 for instance, .mkv or .mov take it
+		if (avformat_query_codec(output_fmt_ctx->oformat, params->codec_id, FF_COMPLIANCE_NORMAL) == 0) {
+			log_message(LOG_LEVEL_WARNING, "%s cannot hold the %s stream #%u, leaving it out\n",
+				output_fmt_ctx->oformat->name, avcodec_get_name(params->codec_id), i);
+			input_stream->discard = AVDISCARD_ALL;
+			continue;
+		}
+
+		AVStream *output_stream = avformat_new_stream(output_fmt_ctx, NULL);
+		if (!output_stream)
+			return 1;
+		int ret = avcodec_parameters_copy(output_stream->codecpar, params);
+		if (ret < 0) {
+			log_message(LOG_LEVEL_ERROR, "Could not copy codec parameters.\n%s\n", av_make_error_string(errorBuff, 80, ret));
+			return 1;
+		}
+		output_stream->codecpar->codec_tag = 0;
+		output_stream->time_base = input_stream->time_base;
+
+		aux->by_input[i] = (int)aux->streams.size();
+		aux->streams.push_back({(int)i, output_stream->index, input_stream->time_base, AV_NOPTS_VALUE});
+		log_message(LOG_LEVEL_INFO, "Passing %s stream #%u through without decoding\n", avcodec_get_name(params->codec_id), i);
+	}
+
+	if (aux->streams.empty())
+		aux_streams_free(out_state);
+	return 0;
+}
+
+const AuxStream *aux_stream_of(const OutputUtils *out_state, const AVPacket *packet)
+{
+	const AuxStreams *aux = out_state->aux_streams;
+	if (!aux || packet->stream_index < 0 || packet->stream_index >= (int)aux->by_input.size())
+		return NULL;
+	int slot = aux->by_input[packet->stream_index];
+	return slot < 0 ? NULL : &aux->streams[slot];
+}
+
+int write_aux_packet(OutputUtils *out_state, AVPacket *packet)
+{
+	AuxStreams *aux = out_state->aux_streams;
+	AuxStream &stream = aux->streams[aux->by_input[packet->stream_index]];
+	char errorBuff[80];
+
+	if (out_state->trailer_written)
+		return AVERROR(EIO);
+	// Looked up here: a segment cut replaces the output streams
+	AVStream *output_stream = out_state->output_fmt_ctx->streams[stream.output_index];
+	packet->stream_index = stream.output_index;
+	av_packet_rescale_ts(packet, stream.time_base, output_stream->time_base);
+	packet->pos = -1;
+
+	if (packet->dts != AV_NOPTS_VALUE && stream.last_dts != AV_NOPTS_VALUE && packet->dts <= stream.last_dts) {
+		packet->dts = stream.last_dts + 1;
+		if (packet->pts != AV_NOPTS_VALUE && packet->pts < packet->dts)
+			packet->pts = packet->dts;
+	}
+	if (packet->dts != AV_NOPTS_VALUE)
+		stream.last_dts = packet->dts;
+
+	aux->packets++;
+	aux->bytes += packet->size;
+	if (out_state->tee)
+		tee_write(out_state->tee, packet);
+	int ret = av_interleaved_write_frame(out_state->output_fmt_ctx, packet);
+	if (ret < 0)
+		log_message(LOG_LEVEL_ERROR, "Error muxing packet: %s\n", av_make_error_string(errorBuff, 80, ret));
+	return ret;
+}
+
+void aux_streams_free(OutputUtils *out_state)
+{
+	delete out_state->aux_streams;
+	out_state->aux_streams = NULL;
+}
+
+void aux_streams_report(const AuxStreams *aux)
+{
+	log_message(LOG_LEVEL_INFO, "Passthrough: %zu streams, %llu packets, %.2f MB, %llu dropped\n",
+		aux->streams.size(), (unsigned long long)aux->packets.load(), aux->bytes.load() / 1e6,
+		(unsigned long long)aux->dropped.load());
+}
@@ -0,0 +1,177 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Frame dropping policy for live inputs the encoder cannot keep up with
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#include "../include/backpressure.hpp"
+#include "../include/latency.hpp"
+#include "../include/logger.hpp"
+#include <cstring>
+
+Backpressure::Backpressure(const TranscodeOptions *opts, AVRational tb)
+	: time_base(tb), max_lag((int64_t)(opts->max_lag * 1000000)),
+	  base_wall(0), base_pts(AV_NOPTS_VALUE), lag(0), peak_lag(0), level(BACKPRESSURE_NONE),
+	  decimate(0), skip_to_keyframe(false),
+	  nonref_skipped(0), frames_decimated(0), frames_queue_full(0), packets_dropped(0)
+{
+}
+
+// Network protocols deliver at the camera's pace, files can be read at any speed
+bool is_live_input(const InputUtils *in_state)
+{
+	const AVFormatContext *input_fmt_ctx = in_state->input_fmt_ctx;
+	const char *name = input_fmt_ctx->iformat->name;
+	if (!strcmp(name, "rtsp") || !strcmp(name, "rtp") || !strcmp(name, "sdp"))
+		return true;
+
+	const char *url = input_fmt_ctx->url;
+	return url && strstr(url, "://") && strncmp(url, "file:", 5) != 0;
+}
+
+bool backpressure_enabled(const InputUtils *in_state, const TranscodeOptions *opts)
+{
+	// A file paced to real time stands in for a camera
+	if (opts->drop_policy == DROP_AUTO)
+		return is_live_input(in_state) || opts->realtime;
+	return opts->drop_policy == DROP_FRAMES;
+}
+
+void backpressure_update(Backpressure *backpressure, const AVFrame *frame)
+{
+	int64_t pts = frame->best_effort_timestamp != AV_NOPTS_VALUE ? frame->best_effort_timestamp : frame->pts;
+	if (pts == AV_NOPTS_VALUE)
+		return;
+
+	// Lag of this frame behind the wall clock, the frame that came earliest
+	// relative to its timestamp counts as on time. A camera clock jumping
+	// back just moves the base.
+	int64_t now = latency_now();
+	int64_t lag = 0;
+	if (backpressure->base_pts != AV_NOPTS_VALUE) {
+		int64_t media = av_rescale_q(pts - backpressure->base_pts, backpressure->time_base, AVRational{1, 1000000000});
+		lag = now - backpressure->base_wall - media;
+	}
+	if (backpressure->base_pts == AV_NOPTS_VALUE || lag < 0) {
+		backpressure->base_wall = now;
+		backpressure->base_pts = pts;
+		lag = 0;
+	}
+	backpressure->lag = lag;
+	if (lag > backpressure->peak_lag)
+		backpressure->peak_lag = lag;
+
+	// Step up as soon as the lag passes a level, step down once it fell to half of it
+	int level = backpressure->level;
+	int64_t threshold = backpressure->max_lag << (level > 0 ? level - 1 : 0);
+	if (level < BACKPRESSURE_DECIMATE && lag > (backpressure->max_lag << level)) {
+		backpressure->level = level + 1;
+		log_message(LOG_LEVEL_WARNING, "Encoder is %lld ms behind real time, dropping frames\n", (long long)(lag / 1000000));
+	}
+	else if (level > BACKPRESSURE_NONE && lag < threshold / 2) {
+		backpressure->level = level - 1;
+		if (level == BACKPRESSURE_SKIP_NONREF)
+			log_message(LOG_LEVEL_INFO, "Encoder caught up with real time\n");
+	}
+}
+
+enum AVDiscard backpressure_skip_frame(const Backpressure *backpressure)
+{
+	return backpressure->level >= BACKPRESSURE_SKIP_NONREF ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+}
+
+bool backpressure_keep_frame(Backpressure *backpressure)
+{
+	if (backpressure->level < BACKPRESSURE_DECIMATE)
+		return true;
+	if (backpressure->decimate++ % 2 == 0)
+		return true;
+	backpressure->frames_decimated++;
+	return false;
+}
+
+// The first slice of the packet tells: the H.264 decoder drops slices with a
+// nal_ref_idc of 0, the HEVC one the sub-layer non-reference types. Other
+// decoders skip nothing at that level.
+bool backpressure_nonref_packet(const AVCodecContext *codec_ctx, const AVPacket *packet)
+{
+	enum AVCodecID codec_id = codec_ctx->codec_id;
+	if (codec_id != AV_CODEC_ID_H264 && codec_id != AV_CODEC_ID_HEVC)
+		return false;
+
+	// MP4 and Matroska inputs carry length prefixed NAL units (avcC/hvcC extradata), RTSP start codes
+	const uint8_t *extradata = codec_ctx->extradata;
+	int length_size = 0;
+	if (extradata && codec_ctx->extradata_size > 0 && extradata[0] == 1) {
+		int at = codec_id == AV_CODEC_ID_H264 ? 4 : 21;
+		if (codec_ctx->extradata_size <= at)
+			return false;
+		length_size = (extradata[at] & 3) + 1;
+	}
+
+	const uint8_t *data = packet->data;
+	const uint8_t *end = packet->data + packet->size;
+	while (data < end) {
+		const uint8_t *nal;
+		if (length_size) {
+			if (end - data < length_size)
+				return false;
+			uint32_t size = 0;
+			for (int i = 0; i < length_size; ++i)
+				size = size << 8 | data[i];
+			nal = data + length_size;
+			if ((int64_t)size > end - nal)
+				return false;
+			data = nal + size;
+			if (size == 0)
+				continue;
+		}
+		else {
+			while (end - data >= 3 && !(data[0] == 0 && data[1] == 0 && data[2] == 1))
+				data++;
+			if (end - data <= 3)
+				return false;
+			nal = data = data + 3;
+		}
+
+		if (codec_id == AV_CODEC_ID_H264) {
+			int type = nal[0] & 0x1f;
+			if (type == 1 || type == 5)
+				return (nal[0] & 0x60) == 0;
+		}
+		else {
+			int type = (nal[0] >> 1) & 0x3f;
+			if (type < 32)
+				return type <= 14 && type % 2 == 0;
+		}
+	}
+	return false;
+}
+
+bool backpressure_drop_packet(Backpressure *backpressure, const AVPacket *packet, bool queue_full)
+{
+	// Nothing after a lost packet decodes cleanly before the next keyframe
+	if (queue_full)
+		backpressure->skip_to_keyframe = true;
+	else if (backpressure->skip_to_keyframe && (packet->flags & AV_PKT_FLAG_KEY))
+		backpressure->skip_to_keyframe = false;
+
+	if (!backpressure->skip_to_keyframe)
+		return false;
+	backpressure->packets_dropped++;
+	return true;
+}
+
+void backpressure_report(const Backpressure *backpressure)
+{
+	log_message(LOG_LEVEL_INFO, "Backpressure: lag %lld ms (peak %lld ms), level %d, dropped %llu non-reference, %llu decimated, %llu at a full frame queue, %llu input packets\n",
+		(long long)(backpressure->lag / 1000000), (long long)(backpressure->peak_lag / 1000000), backpressure->level.load(),
+		(unsigned long long)backpressure->nonref_skipped.load(), (unsigned long long)backpressure->frames_decimated.load(),
+		(unsigned long long)backpressure->frames_queue_full.load(), (unsigned long long)backpressure->packets_dropped.load());
+}
@@ -0,0 +1,177 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Closed-loop preset/CRF control of the output encoder
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#include "../include/encoder_control.hpp"
+#include "../include/pipeline.hpp"
+#include "../include/logger.hpp"
+#include <algorithm>
+#include <cstring>
+
+// x264 and x265 share the preset names, fastest first
+static const char *const presets[] = {
+	"ultrafast", "superfast", "veryfast", "faster", "fast", "medium", "slow", "slower", "veryslow",
+};
+static const int preset_count = sizeof(presets) / sizeof(presets[0]);
+
+static const double load_high = 0.85;   // of the frame interval, step faster above
+static const double load_low = 0.5;     // step better below
+static const int crf_step = 2;
+
+static int preset_index_of(const char *name)
+{
+	for (int i = 0; i < preset_count; i++) {
+		if (!strcmp(presets[i], name))
+			return i;
+	}
+	return -1;
+}
+
+bool encoder_preset_known(const char *name)
+{
+	return preset_index_of(name) >= 0;
+}
+
+EncoderController::EncoderController(const TranscodeOptions *opts, const EncoderSettings &base, AVCodecID id, AVRational frame_rate)
+	: codec_id(id), settings(base),
+	  preset(base.preset ? base.preset : "veryfast"),
+	  crf(base.crf ? base.crf : (id == AV_CODEC_ID_H265 ? "28" : "23")),
+	  crf_range(opts->adaptive_crf_range),
+	  window_count(0), window_time(0), settle(0), gop_frames(0), reopen(false),
+	  crf_offset(0), load(0), steps_faster(0), steps_better(0), reopens(0)
+{
+	if (frame_rate.num <= 0 || frame_rate.den <= 0)
+		frame_rate = AVRational{25, 1};
+	frame_interval = av_rescale(1000000000, frame_rate.den, frame_rate.num);
+	// about two seconds of frames, short enough to react before the queues fill
+	window_frames = std::max(8, (int)(2 * av_q2d(frame_rate) + 0.5));
+
+	base_crf = atoi(crf.c_str());
+	preset_index = preset_index_of(preset.c_str());
+	slowest = std::max(preset_index.load(), preset_index_of(opts->adaptive_slowest));
+
+	settings.preset = preset.c_str();
+	settings.crf = crf.c_str();
+	// A container such as MP4 keeps the stream headers of the first encoder,
+	// every encoder opened after it carries its own SPS/PPS in the keyframes
+	settings.repeat_headers = true;
+}
+
+bool encoder_control_supported(const OutputUtils *out_state, const TranscodeOptions *opts)
+{
+	if (!opts->adaptive || opts->stream_copy)
+		return false;
+	AVCodecID id = out_state->output_codec_ctx->codec_id;
+	if (id != AV_CODEC_ID_H264 && id != AV_CODEC_ID_H265) {
+		log_message(LOG_LEVEL_WARNING, "Adaptive encoding needs an x264 or x265 encoder, keeping the settings of %s\n", out_state->output_codec->name);
+		return false;
+	}
+	if (opts->preset && !encoder_preset_known(opts->preset)) {
+		log_message(LOG_LEVEL_WARNING, "Adaptive encoding does not know the preset %s, keeping it\n", opts->preset);
+		return false;
+	}
+	return true;
+}
+
+// A new rate factor reaches libx264 through its reconfigure path, other
+// encoders only read it when they are opened
+static void set_crf(EncoderController *controller, OutputUtils *out_state, int offset)
+{
+	controller->crf_offset = offset;
+	controller->crf = std::to_string(controller->base_crf + offset);
+	controller->settings.crf = controller->crf.c_str();
+	if (controller->codec_id == AV_CODEC_ID_H264 && !strcmp(out_state->output_codec->name, "libx264"))
+		av_opt_set(out_state->output_codec_ctx->priv_data, "crf", controller->settings.crf, 0);
+	else
+		controller->reopen = true;
+}
+
+static void set_preset(EncoderController *controller, int index)
+{
+	controller->preset_index = index;
+	controller->preset = presets[index];
+	controller->settings.preset = controller->preset.c_str();
+	controller->reopen = true;
+}
+
+void encoder_control_frame(EncoderController *controller, OutputUtils *out_state, uint64_t elapsed)
+{
+	controller->window_time += elapsed;
+	if (++controller->window_count < controller->window_frames)
+		return;
+
+	double load = (double)controller->window_time / controller->window_count / controller->frame_interval;
+	controller->load = (int)(load * 100);
+	controller->window_count = 0;
+	controller->window_time = 0;
+
+	// The window after a change still measures the old settings or a cold encoder
+	if (controller->reopen)
+		return;
+	if (controller->settle > 0) {
+		controller->settle--;
+		return;
+	}
+
+	int preset_index = controller->preset_index;
+	int crf_offset = controller->crf_offset;
+	if (load > load_high) {
+		if (preset_index > 0)
+			set_preset(controller, preset_index - 1);
+		else if (crf_offset < controller->crf_range)
+			set_crf(controller, out_state, std::min(crf_offset + crf_step, controller->crf_range));
+		else
+			return;
+		controller->steps_faster++;
+	}
+	else if (load < load_low) {
+		if (crf_offset > 0)
+			set_crf(controller, out_state, std::max(crf_offset - crf_step, 0));
+		else if (preset_index < controller->slowest)
+			set_preset(controller, preset_index + 1);
+		else
+			return;
+		controller->steps_better++;
+	}
+	else
+		return;
+
+	controller->settle = 1;
+	log_message(LOG_LEVEL_INFO, "Encoder at %d%% of the frame interval, switching to preset %s crf %s\n",
+		controller->load.load(), controller->settings.preset, controller->settings.crf);
+}
+
+int encoder_control_apply(EncoderController *controller, Pipeline *pipeline)
+{
+	// Every GOP starts with an IDR, a new encoder continues the stream there
+	if (controller->reopen && controller->gop_frames % encoder_gop_size == 0) {
+		OutputUtils *out_state = pipeline->out_state;
+		int ret = encode(pipeline->in_state, out_state, NULL, pipeline);
+		if (ret < 0)
+			return ret;
+		avcodec_free_context(&out_state->output_codec_ctx);
+		if (open_encoder(pipeline->in_state, out_state, &controller->settings) != 0)
+			return AVERROR(EINVAL);
+		controller->reopen = false;
+		controller->gop_frames = 0;
+		controller->reopens++;
+	}
+	controller->gop_frames++;
+	return 0;
+}
+
+void encoder_control_report(const EncoderController *controller)
+{
+	log_message(LOG_LEVEL_INFO, "Encoder control: preset %s crf %+d, load %d%% of the frame interval, %llu steps faster, %llu better, %llu reopens\n",
+		presets[controller->preset_index.load()], controller->crf_offset.load(), controller->load.load(),
+		(unsigned long long)controller->steps_faster.load(), (unsigned long long)controller->steps_better.load(),
+		(unsigned long long)controller->reopens.load());
+}
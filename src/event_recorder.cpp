@@ -0,0 +1,225 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Pre-event packet ring that is written to disk only around events
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#include "../include/event_recorder.hpp"
+#include "../include/latency.hpp"
+#include "../include/logger.hpp"
+#include <sys/stat.h>
+
+volatile sig_atomic_t event_signal;
+
+void event_hand(int) {
+	event_signal = event_signal + 1;
+}
+
+// Memory charged for a packet held in the ring
+static int64_t packet_bytes(const AVPacket *packet)
+{
+	return (packet->buf ? packet->buf->size : packet->size) + (int64_t)sizeof(AVPacket);
+}
+
+static int64_t packet_time(const AVPacket *packet)
+{
+	return packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+}
+
+// Modification time of the trigger file, 0 while it does not exist
+static int64_t file_mtime(const char *filename)
+{
+	struct stat st;
+	if (stat(filename, &st) != 0)
+		return 0;
+	return (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+bool event_recording_enabled(const TranscodeOptions *opts)
+{
+	return opts->event_mode;
+}
+
+EventRecorder::EventRecorder(OutputUtils *out, PacketPool *pool, const TranscodeOptions *opts)
+	: out_state(out), packet_pool(pool),
+	  pre_event(opts->pre_event), post_event(opts->post_event),
+	  memory_limit(opts->event_memory), trigger_file(opts->event_trigger),
+	  recording(false), keyframe_wait(false), record_until(AV_NOPTS_VALUE),
+	  seen_signal(event_signal), trigger_mtime(0), next_poll(0),
+	  ring_bytes(0), ring_packets(0), events(0), dropped_gops(0)
+{
+	// Only touches after the start count as triggers
+	if (trigger_file)
+		trigger_mtime = file_mtime(trigger_file);
+}
+
+EventRecorder::~EventRecorder()
+{
+	for (AVPacket *packet : ring)
+		packet_pool->put(packet);
+}
+
+// The file is polled a few times a second, not on every packet
+static bool event_triggered(EventRecorder *recorder)
+{
+	bool triggered = false;
+
+	sig_atomic_t signal_count = event_signal;
+	if (signal_count != recorder->seen_signal) {
+		recorder->seen_signal = signal_count;
+		triggered = true;
+	}
+
+	uint64_t now = latency_now();
+	if (recorder->trigger_file && now >= recorder->next_poll) {
+		recorder->next_poll = now + 250000000;
+		int64_t mtime = file_mtime(recorder->trigger_file);
+		if (mtime != 0 && mtime != recorder->trigger_mtime) {
+			recorder->trigger_mtime = mtime;
+			triggered = true;
+		}
+	}
+	return triggered;
+}
+
+static void drop_oldest_gop(EventRecorder *recorder)
+{
+	EventGop &gop = recorder->gops.front();
+	for (size_t i = 0; i < gop.packets; ++i) {
+		recorder->packet_pool->put(recorder->ring.front());
+		recorder->ring.pop_front();
+	}
+	recorder->ring_bytes -= gop.bytes;
+	recorder->ring_packets = recorder->ring.size();
+	recorder->gops.pop_front();
+}
+
+static void ring_push(EventRecorder *recorder, AVPacket *packet)
+{
+	bool keyframe = packet->flags & AV_PKT_FLAG_KEY;
+	int64_t pts = packet_time(packet);
+
+	// The ring always starts on a keyframe
+	if (recorder->gops.empty() && !keyframe) {
+		recorder->packet_pool->put(packet);
+		return;
+	}
+	if (keyframe)
+		recorder->gops.push_back({pts, 0, 0});
+
+	int64_t bytes = packet_bytes(packet);
+	recorder->ring.push_back(packet);
+	recorder->gops.back().packets++;
+	recorder->gops.back().bytes += bytes;
+	recorder->ring_bytes += bytes;
+	recorder->ring_packets = recorder->ring.size();
+
+	// Age: drop the oldest GOP while the ones after it still cover pre_event
+	int64_t window = av_rescale_q((int64_t)(recorder->pre_event * AV_TIME_BASE), AV_TIME_BASE_Q, recorder->out_state->packet_time_base);
+	while (recorder->gops.size() > 1 && pts != AV_NOPTS_VALUE &&
+			pts - recorder->gops[1].start_pts >= window)
+		drop_oldest_gop(recorder);
+
+	// Memory: the cap wins over the pre-event length, even if the whole ring goes
+	while (!recorder->gops.empty() && recorder->ring_bytes > recorder->memory_limit) {
+		drop_oldest_gop(recorder);
+		recorder->dropped_gops++;
+	}
+}
+
+static int write_owned(EventRecorder *recorder, AVPacket *packet)
+{
+	int ret = write_packet(recorder->out_state, packet);
+	recorder->packet_pool->put(packet);
+	return ret;
+}
+
+static int ring_flush(EventRecorder *recorder)
+{
+	int ret = 0;
+
+	while (!recorder->ring.empty()) {
+		AVPacket *packet = recorder->ring.front();
+		recorder->ring.pop_front();
+		if (ret >= 0)
+			ret = write_owned(recorder, packet);
+		else
+			recorder->packet_pool->put(packet);
+	}
+	recorder->gops.clear();
+	recorder->ring_bytes = 0;
+	recorder->ring_packets = 0;
+	return ret;
+}
+
+int event_recorder_write(EventRecorder *recorder, AVPacket *packet)
+{
+	int64_t pts = packet_time(packet);
+	int ret = 0;
+
+	if (event_triggered(recorder)) {
+		recorder->events++;
+		if (!recorder->recording) {
+			log_message(LOG_LEVEL_INFO, "Event triggered, writing %zu buffered packets\n", recorder->ring.size());
+			// Nothing buffered yet: the clip can only start on the next keyframe
+			recorder->keyframe_wait = recorder->ring.empty() && !(packet->flags & AV_PKT_FLAG_KEY);
+			ret = ring_flush(recorder);
+			recorder->recording = true;
+		}
+		else
+			log_message(LOG_LEVEL_INFO, "Event triggered, recording extended\n");
+		if (pts != AV_NOPTS_VALUE)
+			recorder->record_until = pts + av_rescale_q((int64_t)(recorder->post_event * AV_TIME_BASE), AV_TIME_BASE_Q, recorder->out_state->packet_time_base);
+	}
+
+	// Recording ends on a keyframe, which then opens the next pre-event GOP
+	if (recorder->recording && (packet->flags & AV_PKT_FLAG_KEY) &&
+			pts != AV_NOPTS_VALUE && pts >= recorder->record_until) {
+		log_message(LOG_LEVEL_INFO, "Event recording finished, buffering again\n");
+		recorder->recording = false;
+	}
+
+	if (ret < 0) {
+		recorder->packet_pool->put(packet);
+		return ret;
+	}
+	if (recorder->recording && recorder->keyframe_wait && !(packet->flags & AV_PKT_FLAG_KEY)) {
+		recorder->packet_pool->put(packet);
+		return 0;
+	}
+	if (recorder->recording) {
+		recorder->keyframe_wait = false;
+		return write_owned(recorder, packet);
+	}
+
+	ring_push(recorder, packet);
+	return 0;
+}
+
+int event_recorder_close(EventRecorder *recorder)
+{
+	// A trigger that came with Ctrl+C or the end of the input still gets its pre-event packets
+	if (event_triggered(recorder)) {
+		recorder->events++;
+		recorder->recording = true;
+	}
+	if (!recorder->recording)
+		return 0;
+	log_message(LOG_LEVEL_INFO, "Input ended during an event, writing %zu buffered packets\n", recorder->ring.size());
+	recorder->recording = false;
+	return ring_flush(recorder);
+}
+
+void event_recorder_report(const EventRecorder *recorder)
+{
+	log_message(LOG_LEVEL_INFO, "Events: %llu triggered, %s, ring %zu packets %.1f KB of %.1f KB, %llu GOPs dropped by the memory cap\n",
+		(unsigned long long)recorder->events.load(), recorder->recording ? "recording" : "buffering",
+		recorder->ring_packets.load(), recorder->ring_bytes.load() / 1000.0, recorder->memory_limit / 1000.0,
+		(unsigned long long)recorder->dropped_gops.load());
+}
@@ -0,0 +1,126 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ *
+ * @Brief   : Decoded frames converted to the size and pixel format of an encoder
+ *
+ * @Created : 17-Oct-2026
+ *
+ * @Updated : 17-Oct-2026
+ *
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#include "../include/frame_converter.hpp"
+#include "../include/latency.hpp"
+#include "../include/logger.hpp"
+extern "C" {
+	#include <libavutil/pixdesc.h>
+}
+
+FrameConverter::FrameConverter(int slice_threads)
+	: sws(NULL), threads(slice_threads), source_width(0), source_height(0), source_format(-1),
+	  buffer_pool(new FrameBufferPool()), target_width(0), target_height(0), target_format(AV_PIX_FMT_NONE),
+	  converted(0), passed(0), convert_time(0)
+{
+}
+
+FrameConverter::~FrameConverter()
+{
+	sws_freeContext(sws);
+	frame_buffer_pool_free(&buffer_pool);
+}
+
+bool frame_converter_needed(const AVFrame *frame, const AVCodecContext *codec_ctx)
+{
+	return frame->width != codec_ctx->width || frame->height != codec_ctx->height || frame->format != codec_ctx->pix_fmt;
+}
+
+static void set_target(FrameConverter *converter, const AVCodecContext *codec_ctx)
+{
+	converter->target_width = codec_ctx->width;
+	converter->target_height = codec_ctx->height;
+	converter->target_format = codec_ctx->pix_fmt;
+}
+
+void frame_converter_pass(FrameConverter *converter, const AVCodecContext *codec_ctx)
+{
+	set_target(converter, codec_ctx);
+	converter->passed++;
+}
+
+// (Re)creates the scaler for the size and format the decoder delivers
+static int converter_setup(FrameConverter *converter, const AVCodecContext *codec_ctx, const AVFrame *frame)
+{
+	if (converter->sws && converter->source_width == frame->width &&
+			converter->source_height == frame->height && converter->source_format == frame->format)
+		return 0;
+
+	sws_freeContext(converter->sws);
+	converter->sws = sws_alloc_context();
+	if (!converter->sws)
+		return AVERROR(ENOMEM);
+
+	av_opt_set_int(converter->sws, "srcw", frame->width, 0);
+	av_opt_set_int(converter->sws, "srch", frame->height, 0);
+	av_opt_set_int(converter->sws, "src_format", frame->format, 0);
+	av_opt_set_int(converter->sws, "dstw", codec_ctx->width, 0);
+	av_opt_set_int(converter->sws, "dsth", codec_ctx->height, 0);
+	av_opt_set_int(converter->sws, "dst_format", codec_ctx->pix_fmt, 0);
+	av_opt_set_int(converter->sws, "sws_flags", SWS_BILINEAR, 0);
+#if LIBSWSCALE_VERSION_MAJOR >= 6
+	// Slice threads, 0 lets libswscale use every core
+	av_opt_set_int(converter->sws, "threads", converter->threads, 0);
+#endif
+	int ret = sws_init_context(converter->sws, NULL, NULL);
+	if (ret < 0) {
+		sws_freeContext(converter->sws);
+		converter->sws = NULL;
+		return ret;
+	}
+
+	if (converter->source_format >= 0)
+		log_message(LOG_LEVEL_INFO, "Decoder changed to %dx%d %s, converting to %dx%d %s\n", frame->width, frame->height,
+			av_get_pix_fmt_name((enum AVPixelFormat)frame->format), codec_ctx->width, codec_ctx->height, av_get_pix_fmt_name(codec_ctx->pix_fmt));
+	converter->source_width = frame->width;
+	converter->source_height = frame->height;
+	converter->source_format = frame->format;
+	return 0;
+}
+
+int frame_convert(FrameConverter *converter, const AVCodecContext *codec_ctx, const AVFrame *frame, AVFrame *output)
+{
+	uint64_t start = latency_now();
+	set_target(converter, codec_ctx);
+	int ret = converter_setup(converter, codec_ctx, frame);
+	if (ret >= 0) {
+		output->width = codec_ctx->width;
+		output->height = codec_ctx->height;
+		output->format = codec_ctx->pix_fmt;
+		ret = frame_buffer_pool_get(converter->buffer_pool, output);
+	}
+	if (ret >= 0)
+		ret = av_frame_copy_props(output, frame);
+	if (ret >= 0) {
+#if LIBSWSCALE_VERSION_MAJOR >= 6
+		ret = sws_scale_frame(converter->sws, output, frame);
+#else
+		ret = sws_scale(converter->sws, frame->data, frame->linesize, 0, frame->height, output->data, output->linesize);
+#endif
+	}
+	if (ret < 0)
+		return ret;
+	converter->converted++;
+	converter->convert_time += latency_now() - start;
+	return 0;
+}
+
+void frame_converter_report(const FrameConverter *converter)
+{
+	uint64_t converted = converter->converted;
+	if (converted == 0 && converter->passed == 0)
+		return;
+	const char *format = av_get_pix_fmt_name((enum AVPixelFormat)converter->target_format.load());
+	log_message(LOG_LEVEL_INFO, "Conversion to %dx%d %s: %llu frames converted (%.2f ms each), %llu passed as they were\n",
+		converter->target_width.load(), converter->target_height.load(), format ? format : "none", (unsigned long long)converted,
+		converted ? converter->convert_time / 1e6 / converted : 0.0, (unsigned long long)converter->passed.load());
+}
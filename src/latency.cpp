@@ -0,0 +1,120 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Low overhead per-stage latency histograms
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#include "../include/latency.hpp"
+#include "../include/logger.hpp"
+#include <cmath>
+#include <cstdio>
+
+
+LatencyHistogram::LatencyHistogram()
+{
+	for (auto &count : counts)
+		count.store(0, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::snapshot(LatencySnapshot *out) const
+{
+	for (int i = 0; i < latency_buckets; ++i)
+		out->counts[i] = counts[i].load(std::memory_order_relaxed);
+}
+
+int LatencyHistogram::bucket_index(uint64_t value)
+{
+	const uint64_t sub_count = 1 << latency_sub_bits;
+	const uint64_t limit = (1ULL << latency_max_bits) - 1;
+
+	if (value > limit)
+		value = limit;
+	if (value < 2 * sub_count)
+		return value;
+
+	// Below 2*sub_count every value has its own bucket, above it each power
+	// of two is split into sub_count buckets of equal width
+	int msb = 63 - __builtin_clzll(value);
+	int shift = msb - latency_sub_bits;
+	return (shift << latency_sub_bits) + (value >> shift);
+}
+
+uint64_t LatencyHistogram::bucket_value(int index)
+{
+	const int sub_count = 1 << latency_sub_bits;
+
+	if (index < 2 * sub_count)
+		return index;
+	int shift = (index >> latency_sub_bits) - 1;
+	uint64_t mantissa = index - (shift << latency_sub_bits);
+	return ((mantissa + 1) << shift) - 1;
+}
+
+uint64_t LatencySnapshot::total() const
+{
+	uint64_t total = 0;
+	for (auto count : counts)
+		total += count;
+	return total;
+}
+
+uint64_t LatencySnapshot::percentile(double percent) const
+{
+	uint64_t total = this->total();
+	if (total == 0)
+		return 0;
+
+	// rank of the wanted sample, rounded up so p100 is the last one
+	uint64_t rank = (uint64_t)std::ceil(percent / 100.0 * total);
+	if (rank < 1)
+		rank = 1;
+
+	uint64_t seen = 0;
+	for (int i = 0; i < latency_buckets; ++i) {
+		seen += counts[i];
+		if (seen >= rank)
+			return LatencyHistogram::bucket_value(i);
+	}
+	return max();
+}
+
+uint64_t LatencySnapshot::max() const
+{
+	for (int i = latency_buckets - 1; i >= 0; --i)
+		if (counts[i])
+			return LatencyHistogram::bucket_value(i);
+	return 0;
+}
+
+void LatencySnapshot::subtract(const LatencySnapshot &earlier)
+{
+	for (int i = 0; i < latency_buckets; ++i)
+		counts[i] -= earlier.counts[i];
+}
+
+const char *latency_stage_name(int stage)
+{
+	static const char *names[STAGE_COUNT] = {"read", "decode", "encode", "mux"};
+	return names[stage];
+}
+
+void latency_report(const LatencySnapshot snapshots[STAGE_COUNT])
+{
+	log_message(LOG_LEVEL_INFO, "Stage latency (ms):      count       p50       p90       p99       max\n");
+	for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+		const LatencySnapshot &snapshot = snapshots[stage];
+		uint64_t count = snapshot.total();
+		if (count == 0)
+			continue;
+		log_message(LOG_LEVEL_INFO, "  %-8s %16llu %9.3f %9.3f %9.3f %9.3f\n", latency_stage_name(stage),
+			(unsigned long long)count,
+			snapshot.percentile(50) / 1e6, snapshot.percentile(90) / 1e6,
+			snapshot.percentile(99) / 1e6, snapshot.max() / 1e6);
+	}
+}
@@ -0,0 +1,262 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Asynchronous logger, a lock-free ring drained by a background thread
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#include "../include/logger.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+extern "C" {
+	#include <libavutil/log.h>
+}
+
+static const size_t ring_slots = 4096;          // power of two
+static const size_t message_size = 512;
+static const int rate_limit_per_second = 10;
+static const size_t rate_entries = 64;
+
+// Bounded multi-producer queue (Vyukov): a slot is free for the producer at
+// position p when its sequence equals p, readable when it equals p + 1.
+struct LogSlot {
+	std::atomic<size_t> sequence;
+	LogLevel level;
+	char text[message_size];
+};
+
+// Per format string message counter of the current second
+struct RateEntry {
+	std::atomic<const char*> key;
+	std::atomic<int64_t> second;
+	std::atomic<uint32_t> count;
+	std::atomic<uint32_t> suppressed;
+};
+
+static LogSlot slots[ring_slots];
+static RateEntry rate_table[rate_entries];
+alignas(64) static std::atomic<size_t> enqueue_pos(0);
+alignas(64) static size_t dequeue_pos = 0;     // writer thread only
+static std::atomic<uint64_t> dropped(0);
+static std::atomic<int> log_level(LOG_LEVEL_INFO);
+static std::atomic<bool> running(false);
+static std::thread writer;
+
+
+static void write_line(LogLevel level, const char *text)
+{
+	FILE *stream = level <= LOG_LEVEL_WARNING ? stderr : stdout;
+	fputs(text, stream);
+}
+
+// Claims a slot, formats into it and publishes it. Returns false when full.
+static bool ring_push(LogLevel level, const char *fmt, va_list args)
+{
+	size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+	LogSlot *slot;
+
+	while (true) {
+		slot = &slots[pos & (ring_slots - 1)];
+		size_t sequence = slot->sequence.load(std::memory_order_acquire);
+		intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+		if (diff == 0) {
+			if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0)
+			return false;
+		else
+			pos = enqueue_pos.load(std::memory_order_relaxed);
+	}
+
+	slot->level = level;
+	vsnprintf(slot->text, message_size, fmt, args);
+	slot->sequence.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+static void ring_printf(LogLevel level, const char *fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	if (!ring_push(level, fmt, args))
+		dropped++;
+	va_end(args);
+}
+
+// Writes every published message, returns how many there were
+static size_t ring_drain()
+{
+	size_t written = 0;
+
+	while (true) {
+		LogSlot *slot = &slots[dequeue_pos & (ring_slots - 1)];
+		if (slot->sequence.load(std::memory_order_acquire) != dequeue_pos + 1)
+			break;
+		write_line(slot->level, slot->text);
+		slot->sequence.store(dequeue_pos + ring_slots, std::memory_order_release);
+		dequeue_pos++;
+		written++;
+	}
+	if (written) {
+		fflush(stdout);
+		fflush(stderr);
+	}
+	return written;
+}
+
+static void writer_loop()
+{
+	while (running.load(std::memory_order_acquire)) {
+		if (ring_drain() == 0)
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+		uint64_t lost = dropped.exchange(0);
+		if (lost) {
+			fprintf(stderr, "Logger: %llu messages dropped, ring was full.\n", (unsigned long long)lost);
+			fflush(stderr);
+		}
+	}
+	ring_drain();
+}
+
+// True when the message has to be suppressed. Collisions in the small table
+// simply restart the count, the limit is a safety net and not exact.
+static bool rate_limited(LogLevel level, const char *fmt)
+{
+	if (level > LOG_LEVEL_WARNING)
+		return false;
+
+	RateEntry &entry = rate_table[((uintptr_t)fmt >> 4) % rate_entries];
+	int64_t second = std::chrono::duration_cast<std::chrono::seconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+
+	if (entry.key.load(std::memory_order_relaxed) != fmt) {
+		entry.key.store(fmt, std::memory_order_relaxed);
+		entry.second.store(second, std::memory_order_relaxed);
+		entry.count.store(0, std::memory_order_relaxed);
+		entry.suppressed.store(0, std::memory_order_relaxed);
+	}
+	else if (entry.second.exchange(second, std::memory_order_relaxed) != second) {
+		entry.count.store(0, std::memory_order_relaxed);
+		uint32_t suppressed = entry.suppressed.exchange(0, std::memory_order_relaxed);
+		if (suppressed)
+			ring_printf(level, "(%u similar messages suppressed)\n", suppressed);
+	}
+
+	if (entry.count.fetch_add(1, std::memory_order_relaxed) < rate_limit_per_second)
+		return false;
+	entry.suppressed.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+static void log_vmessage(LogLevel level, const char *key, const char *fmt, va_list args)
+{
+	if (!log_enabled(level))
+		return;
+
+	if (!running.load(std::memory_order_acquire)) {
+		vfprintf(level <= LOG_LEVEL_WARNING ? stderr : stdout, fmt, args);
+		return;
+	}
+	if (rate_limited(level, key))
+		return;
+	if (!ring_push(level, fmt, args))
+		dropped++;
+}
+
+void log_message(LogLevel level, const char *fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	log_vmessage(level, fmt, fmt, args);
+	va_end(args);
+}
+
+// Same as log_message, with the rate limit keyed on another format string
+static void log_keyed(LogLevel level, const char *key, const char *fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	log_vmessage(level, key, fmt, args);
+	va_end(args);
+}
+
+static LogLevel level_from_av(int av_level)
+{
+	if (av_level <= AV_LOG_ERROR)
+		return LOG_LEVEL_ERROR;
+	if (av_level <= AV_LOG_WARNING)
+		return LOG_LEVEL_WARNING;
+	if (av_level <= AV_LOG_INFO)
+		return LOG_LEVEL_INFO;
+	return LOG_LEVEL_DEBUG;
+}
+
+static void av_log_callback(void *avcl, int av_level, const char *fmt, va_list vl)
+{
+	// libav prints lines in pieces, the prefix state has to follow the thread
+	static thread_local int print_prefix = 1;
+	char line[message_size];
+
+	if (av_level > av_log_get_level())
+		return;
+	av_log_format_line2(avcl, av_level, fmt, vl, line, sizeof(line), &print_prefix);
+	log_keyed(level_from_av(av_level), fmt, "%s", line);
+}
+
+bool log_enabled(LogLevel level)
+{
+	return level <= log_level.load(std::memory_order_relaxed);
+}
+
+int log_level_from_name(const char *name)
+{
+	static const char *names[] = {"error", "warning", "info", "debug"};
+
+	if (strcmp(name, "quiet") == 0)
+		return LOG_LEVEL_QUIET;
+	for (int level = LOG_LEVEL_ERROR; level <= LOG_LEVEL_DEBUG; ++level)
+		if (strcmp(name, names[level]) == 0)
+			return level;
+	return -2;
+}
+
+void log_init(LogLevel level)
+{
+	static const int av_levels[] = {AV_LOG_QUIET, AV_LOG_ERROR, AV_LOG_WARNING, AV_LOG_INFO, AV_LOG_DEBUG};
+
+	if (running)
+		return;
+	for (size_t i = 0; i < ring_slots; ++i)
+		slots[i].sequence.store(i, std::memory_order_relaxed);
+	enqueue_pos = 0;
+	dequeue_pos = 0;
+
+	log_level = level;
+	av_log_set_level(av_levels[level + 1]);
+	av_log_set_callback(av_log_callback);
+
+	running = true;
+	writer = std::thread(writer_loop);
+	atexit(log_shutdown);
+}
+
+void log_shutdown()
+{
+	if (!running.exchange(false))
+		return;
+	writer.join();
+	av_log_set_callback(av_log_default_callback);
+}
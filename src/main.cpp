@@ -11,56 +11,601 @@
  */
 
 #include "../include/transcoder.hpp"
+#include "../include/session.hpp"
+#include "../include/logger.hpp"
+#include "../include/event_recorder.hpp"
+#include "../include/encoder_control.hpp"
+#include <getopt.h>
+#include <atomic>
+#include <sstream>
+#include <cstring>
 
-int main (int argc, char **argv)
+// Ctrl+C stops every input of the process, the library only sees stop_request
+static std::atomic<bool> interrupted(false);
+
+static void inthand(int)
 {
+	interrupted = true;
+}
 
-	signal(SIGINT, inthand);
+// Command line settings that are not per-transcode options
+struct MainOptions {
+	const char *session_list = NULL;
+	unsigned workers = 0;
+	LogLevel log_level = LOG_LEVEL_INFO;
+};
 
-	const char *input_filename = argv[1];
-	const char *output_filename = argv[2];
+static void print_usage()
+{
+	printf("USAGE: ./rtsp_ffmpeg [options] <input_filename> <output_filename>\n"
+	"       ./rtsp_ffmpeg [options] --sessions <list_file>\n\n"
+	"Options:\n"
+	"  --copy                write the camera packets as they are, without decoding or re-encoding\n"
+	"  --encode              always re-encode, even when the input already uses the output codec\n"
+	"  --codec <name>        encoder used when re-encoding (default libx264); stream copy is picked\n"
+	"                        automatically when the input is already in this codec\n"
+	"  --packet-queue <n>    demuxed packets buffered ahead of the decoder (default 256)\n"
+	"  --frame-queue <n>     decoded frames buffered ahead of the encoder (default 8)\n"
+	"  --mux-queue <n>       encoded packets buffered ahead of the muxer (default 256)\n"
+	"  --stats-interval <s>  seconds between queue occupancy and latency reports, 0 to disable (default 10)\n"
+	"  --sessions <file>     run every \"<input_filename> <output_filename>\" line of the file in this process\n"
+	"  --workers <n>         worker threads shared by the sessions (default one per core)\n"
+	"  --codec-threads <n>   threads of each decoder/encoder (default 1 with --sessions, libav default otherwise)\n"
+	"  --log-level <level>   quiet, error, warning, info or debug (default info), debug adds a line per frame\n"
+	"  --segment-time <s>    start a new output file on the first keyframe after this many seconds\n"
+	"  --segment-size <MB>   start a new output file on the first keyframe after this many megabytes\n"
+	"  --segment-wrap <n>    keep only the newest n segments on disk (default all)\n"
+	"                        segments are named <output>_00000.<ext>, or after a %%d in the output name,\n"
+	"                        and listed in <output>.m3u8 (MPEG-TS) or <output>.ffconcat (other containers)\n"
+	"  --pre-event <s>       only write around events: keep this many seconds in memory (default 10)\n"
+	"  --post-event <s>      seconds written after the last event trigger (default 30)\n"
+	"  --event-memory <MB>   memory cap of the pre-event buffer of each session (default 64)\n"
+	"  --event-trigger <file> touching this file triggers an event, so does SIGUSR1\n"
+	"  --motion              do not encode frames of a static scene (needs re-encoding)\n"
+	"  --motion-threshold <n> mean luma difference that marks a 16x16 block as changed (default 10)\n"
+	"  --motion-area <pct>   percent of the watched blocks that must change to count as motion (default 0.5)\n"
+	"  --motion-region <x,y,w,h> watch only this part of the picture, in fractions of its size; repeatable\n"
+	"  --motion-hold <s>     keep encoding every frame this long after the last motion (default 2)\n"
+	"  --motion-idle-fps <n> frames encoded per second while the scene is static, 0 for none (default 1)\n"
+	"  --crf <n>             rate factor of the output encoder (default 23 for H264, 28 for H265)\n"
+	"  --preset <name>       encoder preset of the output (default veryfast)\n"
+	"  --size <WxH>          scale the output, -1 for one side keeps the aspect ratio (default input size).\n"
+	"                        Frames not in the size and pixel format of the encoder are converted by\n"
+	"                        libswscale on --codec-threads slice threads\n"
+	"  --rendition <spec>    also encode the decoded frames to another file, repeatable. The spec is\n"
+	"                        <width>x<height>[,codec=<name>][,crf=<n>][,preset=<name>][,output=<file>],\n"
+	"                        -1 for one side keeps the aspect ratio, the file defaults to <output>_<height>p.<ext>\n"
+	"  --snapshot-interval <s> write a thumbnail of the first keyframe after every interval, only keyframes are decoded\n"
+	"  --snapshot-format <f> jpeg or png (default jpeg)\n"
+	"  --snapshot-file <file> thumbnail file, a %%d numbers them instead of overwriting (default <output>_snapshot.jpg)\n"
+	"  --snapshot-size <WxH> thumbnail size, -1 for one side keeps the aspect ratio (default input size)\n"
+	"  --drop-policy <p>     auto, never or drop: drop frames instead of reading slower when the encoder falls\n"
+	"                        behind real time (default auto, drop for network inputs only)\n"
+	"  --max-lag <ms>        lag behind real time before non-reference frames are skipped, twice that\n"
+	"                        drops every second frame (default 1000)\n"
+	"  --realtime            read the input no faster than its timestamps, a file then stands in for a camera\n"
+	"  --adaptive            follow the encode time with the output preset and CRF: faster presets and a higher\n"
+	"                        CRF when the encoder falls behind, back when it has headroom (x264/x265 only)\n"
+	"  --adaptive-slowest <name> slowest preset adaptive encoding goes to (default medium)\n"
+	"  --adaptive-crf-range <n> CRF adaptive encoding may add to --crf (default 8)\n"
+	"  --reconnect <p>       auto, never or always: open the input again when it is lost or ends, the recording\n"
+	"                        continues in the same output (default auto, network inputs only; always loops files)\n"
+	"  --reconnect-delay <ms> wait before the first attempt, doubled per failed attempt up to 30 s (default 500)\n"
+	"  --reconnect-attempts <n> failed attempts in a row before giving up, 0 retries forever (default 0)\n"
+	"  --read-timeout <s>    seconds without input data before the input counts as lost (default 10)\n"
+	"  --probe-cache <dir>   remember the stream parameters of every input here, later starts probe only briefly\n"
+	"  --passthrough <p>     audio, all or none: input streams besides the video copied into the output\n"
+	"                        without decoding, all adds subtitles and data (default audio)\n"
+	"  --fmp4                write MP4/MOV as keyframe aligned fragments: flat memory, a cheap close and a file\n"
+	"                        that plays up to the last fragment even after a crash\n"
+	"  --fragment-time <s>   shortest fragment with --fmp4, 0 starts one on every keyframe (default 0)\n"
+	"  --sync-write          write output files from the muxer thread instead of a writer thread of their own\n"
+	"  --write-buffer <MiB>  output data queued for the writer thread before the muxer waits (default 64)\n"
+	"  --preallocate <MiB>   disk space reserved ahead of the written data, 0 to disable (default 64)\n"
+	"  --fsync <p>           never, close, or seconds between fdatasync calls on the output (default never)\n"
+	"  --shm <name>          publish to shared memory rings /dev/shm/<name>_frames and <name>_packets that any\n"
+	"                        number of local processes can map read-only, see include/shm_ring.hpp\n"
+	"  --shm-data <d>        frames, packets or both: decoded frames and/or encoded video packets (default frames)\n"
+	"  --shm-slots <n>       items kept in each ring, a reader further behind skips ahead (default 8)\n"
+	"  --restream <addr>     [address:]port serving the output video as MPEG-TS over TCP to any number of\n"
+	"                        clients, which join at the next keyframe (address default 127.0.0.1)\n"
+	"  --restream-queue <n>  packets queued per restream client (default 128)\n"
+	"  --restream-drop <p>   gop or close: a client with a full queue skips to the next keyframe or is\n"
+	"                        disconnected (default gop)\n"
+	"  --tee <[f=fmt]url>    also write the encoded packets to another file, pipe or URL, repeatable, e.g.\n"
+	"                        \"[f=mpegts]pipe:1\". A sink that fails or falls behind leaves the output alone\n\n");
+}
 
-	if (argc < 3 || argc > 3) {
-		printf("\nERROR: Provide input_filename and output_filename as arguments.\n"
-		"USAGE: ./rtsp_ffmpeg <input_filename> <output_filename>\n\n");
-		exit(1);
+// "640x360,crf=28,preset=veryfast,codec=libx264,output=preview.mp4", only the size is required
+static bool parse_rendition(const char *spec, RenditionOptions *rendition)
+{
+	std::stringstream stream(spec);
+	std::string item;
+
+	if (!std::getline(stream, item, ',') || sscanf(item.c_str(), "%dx%d", &rendition->width, &rendition->height) != 2 ||
+			rendition->width == 0 || rendition->height == 0 || (rendition->width < 0 && rendition->height < 0))
+		return false;
+	while (std::getline(stream, item, ',')) {
+		size_t equals = item.find('=');
+		if (equals == std::string::npos)
+			return false;
+		std::string key = item.substr(0, equals);
+		std::string value = item.substr(equals + 1);
+		if (key == "codec")
+			rendition->encoder_name = value;
+		else if (key == "crf")
+			rendition->crf = value;
+		else if (key == "preset")
+			rendition->preset = value;
+		else if (key == "output")
+			rendition->output_filename = value;
+		else
+			return false;
 	}
+	return true;
+}
 
-	InputUtils in_state;
-	OutputUtils out_state;
+// "[address:]port", the address itself is resolved when the socket is bound
+static bool valid_restream_address(const char *address)
+{
+	const char *colon = strrchr(address, ':');
+	int port = atoi(colon ? colon + 1 : address);
+	return port > 0 && port <= 65535;
+}
 
-	if (open_input_stream(&in_state, input_filename) != 0){
-		return EXIT_FAILURE;
+// Parses the options in front of the file names, returns the index of the first file name
+static int parse_options(int argc, char **argv, TranscodeOptions *opts, MainOptions *main_opts)
+{
+	// Long only options, the letters are used up
+	enum {
+		OPT_SHM = 256,
+		OPT_SHM_DATA,
+		OPT_SHM_SLOTS,
+		OPT_RESTREAM,
+		OPT_RESTREAM_QUEUE,
+		OPT_RESTREAM_DROP,
+		OPT_TEE,
+		OPT_SIZE
+	};
+	static const struct option long_options[] = {
+		{"copy",           no_argument,       NULL, 'C'},
+		{"encode",         no_argument,       NULL, 'E'},
+		{"codec",          required_argument, NULL, 'c'},
+		{"packet-queue",   required_argument, NULL, 'p'},
+		{"frame-queue",    required_argument, NULL, 'f'},
+		{"mux-queue",      required_argument, NULL, 'm'},
+		{"stats-interval", required_argument, NULL, 's'},
+		{"sessions",       required_argument, NULL, 'S'},
+		{"workers",        required_argument, NULL, 'w'},
+		{"codec-threads",  required_argument, NULL, 't'},
+		{"log-level",      required_argument, NULL, 'l'},
+		{"segment-time",   required_argument, NULL, 'T'},
+		{"segment-size",   required_argument, NULL, 'B'},
+		{"segment-wrap",   required_argument, NULL, 'W'},
+		{"pre-event",      required_argument, NULL, 'P'},
+		{"post-event",     required_argument, NULL, 'A'},
+		{"event-memory",   required_argument, NULL, 'M'},
+		{"event-trigger",  required_argument, NULL, 'e'},
+		{"motion",         no_argument,       NULL, 'D'},
+		{"motion-threshold", required_argument, NULL, 'x'},
+		{"motion-area",    required_argument, NULL, 'a'},
+		{"motion-region",  required_argument, NULL, 'r'},
+		{"motion-hold",    required_argument, NULL, 'H'},
+		{"motion-idle-fps", required_argument, NULL, 'i'},
+		{"crf",            required_argument, NULL, 'q'},
+		{"preset",         required_argument, NULL, 'R'},
+		{"rendition",      required_argument, NULL, 'L'},
+		{"snapshot-interval", required_argument, NULL, 'I'},
+		{"snapshot-format", required_argument, NULL, 'F'},
+		{"snapshot-file",  required_argument, NULL, 'o'},
+		{"snapshot-size",  required_argument, NULL, 'z'},
+		{"drop-policy",    required_argument, NULL, 'd'},
+		{"max-lag",        required_argument, NULL, 'g'},
+		{"adaptive",       no_argument,       NULL, 'j'},
+		{"adaptive-slowest", required_argument, NULL, 'k'},
+		{"adaptive-crf-range", required_argument, NULL, 'n'},
+		{"reconnect",      required_argument, NULL, 'u'},
+		{"reconnect-delay", required_argument, NULL, 'y'},
+		{"reconnect-attempts", required_argument, NULL, 'Y'},
+		{"read-timeout",   required_argument, NULL, 'O'},
+		{"probe-cache",    required_argument, NULL, 'b'},
+		{"passthrough",    required_argument, NULL, 'v'},
+		{"fmp4",           no_argument,       NULL, 'G'},
+		{"fragment-time",  required_argument, NULL, 'J'},
+		{"sync-write",     no_argument,       NULL, 'U'},
+		{"realtime",       no_argument,       NULL, 'X'},
+		{"write-buffer",   required_argument, NULL, 'K'},
+		{"preallocate",    required_argument, NULL, 'N'},
+		{"fsync",          required_argument, NULL, 'Q'},
+		{"shm",            required_argument, NULL, OPT_SHM},
+		{"shm-data",       required_argument, NULL, OPT_SHM_DATA},
+		{"shm-slots",      required_argument, NULL, OPT_SHM_SLOTS},
+		{"restream",       required_argument, NULL, OPT_RESTREAM},
+		{"restream-queue", required_argument, NULL, OPT_RESTREAM_QUEUE},
+		{"restream-drop",  required_argument, NULL, OPT_RESTREAM_DROP},
+		{"tee",            required_argument, NULL, OPT_TEE},
+		{"size",           required_argument, NULL, OPT_SIZE},
+		{"help",           no_argument,       NULL, 'h'},
+		{NULL, 0, NULL, 0}
+	};
+	bool codec_threads_set = false;
+	int level;
+	MotionRegion region;
+	RenditionOptions rendition;
+
+	int opt;
+	while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+		switch (opt) {
+		case 'C':
+			opts->copy_mode = COPY_ALWAYS;
+			break;
+		case 'E':
+			opts->copy_mode = COPY_NEVER;
+			break;
+		case 'c':
+			opts->encoder_name = optarg;
+			break;
+		case 'p':
+			opts->packet_queue_depth = strtoul(optarg, NULL, 10);
+			break;
+		case 'f':
+			opts->frame_queue_depth = strtoul(optarg, NULL, 10);
+			break;
+		case 'm':
+			opts->mux_queue_depth = strtoul(optarg, NULL, 10);
+			break;
+		case 's':
+			opts->stats_interval = atoi(optarg);
+			break;
+		case 'S':
+			main_opts->session_list = optarg;
+			break;
+		case 'w':
+			main_opts->workers = strtoul(optarg, NULL, 10);
+			break;
+		case 't':
+			opts->codec_threads = atoi(optarg);
+			codec_threads_set = true;
+			break;
+		case 'l':
+			level = log_level_from_name(optarg);
+			if (level < LOG_LEVEL_QUIET) {
+				printf("\nERROR: Unknown log level %s.\n", optarg);
+				return -1;
+			}
+			main_opts->log_level = (LogLevel)level;
+			break;
+		case 'T':
+			opts->segment_time = atof(optarg);
+			break;
+		case 'B':
+			opts->segment_size = (int64_t)(atof(optarg) * 1000000);
+			break;
+		case 'W':
+			opts->segment_wrap = atoi(optarg);
+			break;
+		case 'P':
+			opts->pre_event = atof(optarg);
+			opts->event_mode = true;
+			break;
+		case 'A':
+			opts->post_event = atof(optarg);
+			opts->event_mode = true;
+			break;
+		case 'M':
+			opts->event_memory = (int64_t)(atof(optarg) * 1000000);
+			opts->event_mode = true;
+			break;
+		case 'e':
+			opts->event_trigger = optarg;
+			opts->event_mode = true;
+			break;
+		case 'D':
+			opts->motion_detect = true;
+			break;
+		case 'x':
+			opts->motion_threshold = atof(optarg);
+			break;
+		case 'a':
+			opts->motion_area = atof(optarg);
+			break;
+		case 'r':
+			if (sscanf(optarg, "%lf,%lf,%lf,%lf", &region.x, &region.y, &region.w, &region.h) != 4 ||
+					region.w <= 0 || region.h <= 0) {
+				printf("\nERROR: Motion region must be x,y,w,h in fractions of the picture, got %s.\n", optarg);
+				return -1;
+			}
+			opts->motion_regions.push_back(region);
+			break;
+		case 'H':
+			opts->motion_hold = atof(optarg);
+			break;
+		case 'i':
+			opts->motion_idle_fps = atof(optarg);
+			break;
+		case 'q':
+			opts->crf = optarg;
+			break;
+		case 'R':
+			opts->preset = optarg;
+			break;
+		case 'L':
+			if (!parse_rendition(optarg, &rendition)) {
+				printf("\nERROR: Rendition must be <width>x<height>[,codec=..][,crf=..][,preset=..][,output=..], got %s.\n", optarg);
+				return -1;
+			}
+			opts->renditions.push_back(rendition);
+			rendition = RenditionOptions();
+			break;
+		case 'I':
+			opts->snapshot_interval = atof(optarg);
+			break;
+		case 'F':
+			if (strcmp(optarg, "jpeg") != 0 && strcmp(optarg, "png") != 0) {
+				printf("\nERROR: Snapshot format must be jpeg or png, got %s.\n", optarg);
+				return -1;
+			}
+			opts->snapshot_format = optarg;
+			break;
+		case 'o':
+			opts->snapshot_filename = optarg;
+			break;
+		case 'd':
+			if (!strcmp(optarg, "auto"))
+				opts->drop_policy = DROP_AUTO;
+			else if (!strcmp(optarg, "never"))
+				opts->drop_policy = DROP_NEVER;
+			else if (!strcmp(optarg, "drop"))
+				opts->drop_policy = DROP_FRAMES;
+			else {
+				printf("\nERROR: Drop policy must be auto, never or drop, got %s.\n", optarg);
+				return -1;
+			}
+			break;
+		case 'g':
+			opts->max_lag = atof(optarg);
+			break;
+		case 'j':
+			opts->adaptive = true;
+			break;
+		case 'k':
+			if (!encoder_preset_known(optarg)) {
+				printf("\nERROR: Adaptive encoding does not know the preset %s.\n", optarg);
+				return -1;
+			}
+			opts->adaptive_slowest = optarg;
+			break;
+		case 'n':
+			opts->adaptive_crf_range = atoi(optarg);
+			if (opts->adaptive_crf_range < 0) {
+				printf("\nERROR: Adaptive CRF range must not be negative.\n");
+				return -1;
+			}
+			break;
+		case 'u':
+			if (!strcmp(optarg, "auto"))
+				opts->reconnect = RECONNECT_AUTO;
+			else if (!strcmp(optarg, "never"))
+				opts->reconnect = RECONNECT_NEVER;
+			else if (!strcmp(optarg, "always"))
+				opts->reconnect = RECONNECT_ALWAYS;
+			else {
+				printf("\nERROR: Reconnect policy must be auto, never or always, got %s.\n", optarg);
+				return -1;
+			}
+			break;
+		case 'y':
+			opts->reconnect_delay = atof(optarg);
+			break;
+		case 'Y':
+			opts->reconnect_attempts = atoi(optarg);
+			break;
+		case 'O':
+			opts->read_timeout = atof(optarg);
+			break;
+		case 'b':
+			opts->probe_cache = optarg;
+			break;
+		case 'v':
+			if (!strcmp(optarg, "audio"))
+				opts->passthrough = PASSTHROUGH_AUDIO;
+			else if (!strcmp(optarg, "all"))
+				opts->passthrough = PASSTHROUGH_ALL;
+			else if (!strcmp(optarg, "none"))
+				opts->passthrough = PASSTHROUGH_NONE;
+			else {
+				printf("\nERROR: Passthrough must be audio, all or none, got %s.\n", optarg);
+				return -1;
+			}
+			break;
+		case 'G':
+			opts->fragmented = true;
+			break;
+		case 'J':
+			opts->fragment_time = atof(optarg);
+			break;
+		case 'U':
+			opts->writer.async = false;
+			break;
+		case 'X':
+			opts->realtime = true;
+			break;
+		case 'K':
+			opts->writer.max_buffered = (size_t)(atof(optarg) * (1 << 20));
+			if (opts->writer.max_buffered < 2 * opts->writer.buffer_size) {
+				printf("\nERROR: Write buffer must be at least 2 MiB.\n");
+				return -1;
+			}
+			break;
+		case 'N':
+			opts->writer.preallocate = (int64_t)(atof(optarg) * (1 << 20));
+			break;
+		case 'Q':
+			if (!strcmp(optarg, "never"))
+				opts->writer.fsync_interval = -1;
+			else if (!strcmp(optarg, "close"))
+				opts->writer.fsync_interval = 0;
+			else if (atof(optarg) > 0)
+				opts->writer.fsync_interval = atof(optarg);
+			else {
+				printf("\nERROR: Fsync policy must be never, close or a number of seconds, got %s.\n", optarg);
+				return -1;
+			}
+			break;
+		case OPT_SHM:
+			if (!*optarg || strchr(optarg, '/')) {
+				printf("\nERROR: Shared memory name must be non-empty and without '/', got %s.\n", optarg);
+				return -1;
+			}
+			opts->shm_name = optarg;
+			break;
+		case OPT_SHM_DATA:
+			opts->shm_frames = !strcmp(optarg, "frames") || !strcmp(optarg, "both");
+			opts->shm_packets = !strcmp(optarg, "packets") || !strcmp(optarg, "both");
+			if (!opts->shm_frames && !opts->shm_packets) {
+				printf("\nERROR: Shared memory data must be frames, packets or both, got %s.\n", optarg);
+				return -1;
+			}
+			break;
+		case OPT_SHM_SLOTS:
+			opts->shm_slots = atoi(optarg);
+			if (opts->shm_slots < 2) {
+				printf("\nERROR: Shared memory rings need at least 2 slots.\n");
+				return -1;
+			}
+			break;
+		case OPT_RESTREAM:
+			if (!valid_restream_address(optarg)) {
+				printf("\nERROR: Restream address must be [address:]port, got %s.\n", optarg);
+				return -1;
+			}
+			opts->restream = optarg;
+			break;
+		case OPT_RESTREAM_QUEUE:
+			if (atoi(optarg) < 1) {
+				printf("\nERROR: Restream queue must hold at least 1 packet.\n");
+				return -1;
+			}
+			opts->restream_queue = atoi(optarg);
+			break;
+		case OPT_RESTREAM_DROP:
+			if (!strcmp(optarg, "gop"))
+				opts->restream_drop = RESTREAM_DROP_GOP;
+			else if (!strcmp(optarg, "close"))
+				opts->restream_drop = RESTREAM_DROP_CLOSE;
+			else {
+				printf("\nERROR: Restream drop policy must be gop or close, got %s.\n", optarg);
+				return -1;
+			}
+			break;
+		case OPT_TEE:
+			opts->tee_outputs.push_back(optarg);
+			break;
+		case OPT_SIZE:
+			if (sscanf(optarg, "%dx%d", &opts->width, &opts->height) != 2 || opts->width == 0 || opts->height == 0 ||
+					(opts->width < 0 && opts->height < 0)) {
+				printf("\nERROR: Output size must be <width>x<height>, one side may be -1, got %s.\n", optarg);
+				return -1;
+			}
+			break;
+		case 'z':
+			if (sscanf(optarg, "%dx%d", &opts->snapshot_width, &opts->snapshot_height) != 2) {
+				printf("\nERROR: Snapshot size must be <width>x<height>, got %s.\n", optarg);
+				return -1;
+			}
+			break;
+		default:
+			return -1;
+		}
 	}
-	if (setup_decoder(&in_state) != 0) {
-		return EXIT_FAILURE;
+	if (opts->packet_queue_depth == 0 || opts->frame_queue_depth == 0 || opts->mux_queue_depth == 0) {
+		printf("\nERROR: Queue depths must be at least 1.\n");
+		return -1;
 	}
-	if (setup_output_stream(&out_state, output_filename) != 0) {
-		return EXIT_FAILURE;
+	if (opts->copy_mode == COPY_ALWAYS && (opts->width != 0 || opts->height != 0)) {
+		printf("\nERROR: Scaling needs decoded frames, --size cannot be used with --copy.\n");
+		return -1;
 	}
-	if (setup_encoder(&in_state, &out_state) != 0) {
-		return EXIT_FAILURE;
+	if (opts->copy_mode == COPY_ALWAYS && !opts->renditions.empty()) {
+		printf("\nERROR: Renditions are encoded from decoded frames, they cannot be used with --copy.\n");
+		return -1;
+	}
+	if (main_opts->session_list && opts->shm_name) {
+		printf("\nERROR: Every session needs its own shared memory name, leave out --shm with --sessions.\n");
+		return -1;
+	}
+	if (main_opts->session_list && opts->restream) {
+		printf("\nERROR: Every session needs its own restream port, leave out --restream with --sessions.\n");
+		return -1;
+	}
+	if (main_opts->session_list && !opts->tee_outputs.empty()) {
+		printf("\nERROR: Every session needs its own tee outputs, leave out --tee with --sessions.\n");
+		return -1;
 	}
-	if (open_output_stream(&out_state, output_filename) != 0){
+	if (main_opts->session_list && opts->snapshot_filename) {
+		printf("\nERROR: Every session needs its own snapshot file, leave out --snapshot-file with --sessions.\n");
+		return -1;
+	}
+	for (auto &extra : opts->renditions) {
+		if (main_opts->session_list && !extra.output_filename.empty()) {
+			printf("\nERROR: Every session needs its own rendition file, leave out output= with --sessions.\n");
+			return -1;
+		}
+	}
+	// Sessions share the worker pool, extra libav threads per codec would oversubscribe the cores
+	if (main_opts->session_list && !codec_threads_set)
+		opts->codec_threads = 1;
+	return optind;
+}
+
+int main (int argc, char **argv)
+{
+
+	signal(SIGINT, inthand);
+	signal(SIGUSR1, event_hand);
+	// A pipe output whose reader went away fails on its own instead of ending the process
+	signal(SIGPIPE, SIG_IGN);
+
+	TranscodeOptions opts;
+	MainOptions main_opts;
+	int first_arg = parse_options(argc, argv, &opts, &main_opts);
+
+	// Nothing below writes to the terminal directly, a background thread does
+	log_init(main_opts.log_level);
+
+	if (first_arg >= 0 && main_opts.session_list && argc == first_arg) {
+		std::vector<std::unique_ptr<Session>> sessions;
+		if (load_sessions(main_opts.session_list, &opts, sessions) != 0) {
+			return EXIT_FAILURE;
+		}
+		for (auto &session : sessions)
+			session->in_state.stop_request = &interrupted;
+		return run_sessions(sessions, main_opts.workers);
+	}
+
+	if (first_arg < 0 || main_opts.session_list || argc - first_arg != 2) {
+		printf("\nERROR: Provide input_filename and output_filename as arguments.\n");
+		print_usage();
+		exit(1);
+	}
+
+	const char *input_filename = argv[first_arg];
+	const char *output_filename = argv[first_arg + 1];
+
+	InputUtils in_state = {};
+	OutputUtils out_state = {};
+	in_state.stop_request = &interrupted;
+
+	if (setup_streams(&in_state, &out_state, &opts, input_filename, output_filename) != 0) {
 		return EXIT_FAILURE;
 	}
-	if (transcode(&in_state, &out_state) != 0){
+	if (transcode(&in_state, &out_state, &opts) != 0){
 		return EXIT_FAILURE;
 	}
 
 	close_streams(&in_state, &out_state);
-	
-	// Calculating output video file size
-	std::uintmax_t size = std::experimental::filesystem::file_size(output_filename);
-	float new_size = size;
-	if (new_size/1000000 < 1) {
-		printf("\nOutput Video File size: %.2f KB\n", new_size/1000);
-		std::cout << std::endl;
-	}
-	else {
-		printf("\nOutput Video File size: %.2f MB\n", new_size/1000000);
-		std::cout << std::endl;
-	}
+	print_output_size(output_filename);
+
 	return 0;
 }
 
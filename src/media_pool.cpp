@@ -0,0 +1,225 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Recycled AVPacket/AVFrame shells and pooled decoder frame buffers
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#include "../include/media_pool.hpp"
+extern "C" {
+	#include <libavutil/imgutils.h>
+}
+
+// av_buffer_pool_init2() takes int sizes before libavutil 57 (FFmpeg 5.0)
+#if LIBAVUTIL_VERSION_MAJOR < 57
+typedef int buffer_size_t;
+#else
+typedef size_t buffer_size_t;
+#endif
+
+// Extra room the decoders may read or write past the last line
+static const int frame_padding = 16 + 64 - 1;
+
+
+PacketPool::PacketPool(size_t max_free)
+	: counters(), max_free(max_free)
+{
+	free_list.reserve(max_free);
+}
+
+PacketPool::~PacketPool()
+{
+	for (AVPacket *packet : free_list)
+		av_packet_free(&packet);
+}
+
+AVPacket *PacketPool::get()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if (!free_list.empty()) {
+			AVPacket *packet = free_list.back();
+			free_list.pop_back();
+			counters.reused++;
+			return packet;
+		}
+	}
+	counters.allocated++;
+	return av_packet_alloc();
+}
+
+void PacketPool::put(AVPacket *packet)
+{
+	if (!packet)
+		return;
+	av_packet_unref(packet);
+
+	std::lock_guard<std::mutex> guard(lock);
+	if (free_list.size() < max_free)
+		free_list.push_back(packet);
+	else
+		av_packet_free(&packet);
+}
+
+FramePool::FramePool(size_t max_free)
+	: counters(), max_free(max_free)
+{
+	free_list.reserve(max_free);
+}
+
+FramePool::~FramePool()
+{
+	for (AVFrame *frame : free_list)
+		av_frame_free(&frame);
+}
+
+AVFrame *FramePool::get()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if (!free_list.empty()) {
+			AVFrame *frame = free_list.back();
+			free_list.pop_back();
+			counters.reused++;
+			return frame;
+		}
+	}
+	counters.allocated++;
+	return av_frame_alloc();
+}
+
+void FramePool::put(AVFrame *frame)
+{
+	if (!frame)
+		return;
+	av_frame_unref(frame);
+
+	std::lock_guard<std::mutex> guard(lock);
+	if (free_list.size() < max_free)
+		free_list.push_back(frame);
+	else
+		av_frame_free(&frame);
+}
+
+static AVBufferRef *frame_buffer_alloc(void *opaque, buffer_size_t size)
+{
+	auto buffer_pool = static_cast<FrameBufferPool*>(opaque);
+	buffer_pool->allocated++;
+	return av_buffer_alloc(size);
+}
+
+// Works out the aligned plane layout for the frame size, width and height
+// already padded as the consumer wants them, and (re)creates the pool.
+// Called with buffer_pool->lock held.
+static int frame_buffer_pool_update(FrameBufferPool *buffer_pool, const AVFrame *frame,
+		int width, int height, const int linesize_align[AV_NUM_DATA_POINTERS])
+{
+	int linesize[4];
+	uint8_t *data[4];
+	int unaligned;
+
+	// widen until every plane's stride meets the decoder's alignment
+	do {
+		int ret = av_image_fill_linesizes(linesize, (AVPixelFormat)frame->format, width);
+		if (ret < 0)
+			return ret;
+		width += width & ~(width - 1);
+
+		unaligned = 0;
+		for (int i = 0; i < 4; i++)
+			unaligned |= linesize[i] % linesize_align[i];
+	} while (unaligned);
+
+	int size = av_image_fill_pointers(data, (AVPixelFormat)frame->format, height, NULL, linesize);
+	if (size < 0)
+		return size;
+
+	// buffers still referenced by frames keep the old pool alive until returned
+	av_buffer_pool_uninit(&buffer_pool->pool);
+	buffer_pool->pool = av_buffer_pool_init2(size + frame_padding, buffer_pool, frame_buffer_alloc, NULL);
+	if (!buffer_pool->pool)
+		return AVERROR(ENOMEM);
+
+	buffer_pool->width = frame->width;
+	buffer_pool->height = frame->height;
+	buffer_pool->format = frame->format;
+	buffer_pool->aligned_height = height;
+	buffer_pool->size = size;
+	for (int i = 0; i < 4; i++)
+		buffer_pool->linesize[i] = linesize[i];
+	return 0;
+}
+
+// Points the frame planes into a buffer of the pool. Called with buffer_pool->lock held.
+static int frame_buffer_fill(FrameBufferPool *buffer_pool, AVFrame *frame)
+{
+	frame->buf[0] = av_buffer_pool_get(buffer_pool->pool);
+	if (!frame->buf[0])
+		return AVERROR(ENOMEM);
+	av_image_fill_pointers(frame->data, (AVPixelFormat)frame->format, buffer_pool->aligned_height,
+		frame->buf[0]->data, buffer_pool->linesize);
+	for (int i = 0; i < 4; i++)
+		frame->linesize[i] = buffer_pool->linesize[i];
+	frame->extended_data = frame->data;
+	return 0;
+}
+
+static int frame_get_buffer(AVCodecContext *codec_ctx, AVFrame *frame, int flags)
+{
+	auto buffer_pool = static_cast<FrameBufferPool*>(codec_ctx->opaque);
+
+	// only plain software video frames come from the pool
+	if (codec_ctx->codec_type != AVMEDIA_TYPE_VIDEO || !(codec_ctx->codec->capabilities & AV_CODEC_CAP_DR1))
+		return avcodec_default_get_buffer2(codec_ctx, frame, flags);
+
+	std::lock_guard<std::mutex> guard(buffer_pool->lock);
+	if (!buffer_pool->pool || buffer_pool->width != frame->width ||
+			buffer_pool->height != frame->height || buffer_pool->format != frame->format) {
+		int linesize_align[AV_NUM_DATA_POINTERS];
+		int width = frame->width;
+		int height = frame->height;
+		avcodec_align_dimensions2(codec_ctx, &width, &height, linesize_align);
+
+		int ret = frame_buffer_pool_update(buffer_pool, frame, width, height, linesize_align);
+		if (ret < 0)
+			return ret;
+	}
+	return frame_buffer_fill(buffer_pool, frame);
+}
+
+int frame_buffer_pool_get(FrameBufferPool *buffer_pool, AVFrame *frame)
+{
+	std::lock_guard<std::mutex> guard(buffer_pool->lock);
+	if (!buffer_pool->pool || buffer_pool->width != frame->width ||
+			buffer_pool->height != frame->height || buffer_pool->format != frame->format) {
+		// SIMD friendly strides, no extra rows
+		int linesize_align[AV_NUM_DATA_POINTERS];
+		for (int i = 0; i < AV_NUM_DATA_POINTERS; i++)
+			linesize_align[i] = 64;
+
+		int ret = frame_buffer_pool_update(buffer_pool, frame, frame->width, frame->height, linesize_align);
+		if (ret < 0)
+			return ret;
+	}
+	return frame_buffer_fill(buffer_pool, frame);
+}
+
+void frame_buffer_pool_attach(AVCodecContext *codec_ctx, FrameBufferPool *buffer_pool)
+{
+	codec_ctx->opaque = buffer_pool;
+	codec_ctx->get_buffer2 = frame_get_buffer;
+}
+
+void frame_buffer_pool_free(FrameBufferPool **buffer_pool)
+{
+	if (!*buffer_pool)
+		return;
+	av_buffer_pool_uninit(&(*buffer_pool)->pool);
+	delete *buffer_pool;
+	*buffer_pool = NULL;
+}
@@ -0,0 +1,217 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Luma SAD motion detection used to skip encoding static scenes
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#include "../include/motion.hpp"
+#include "../include/logger.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+extern "C" {
+	#include <libavutil/pixdesc.h>
+}
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+void motion_sad_scalar(const uint8_t *a, const uint8_t *b, int blocks, uint32_t *block_sad)
+{
+	for (int block = 0; block < blocks; ++block) {
+		uint32_t sum = 0;
+		for (int i = 0; i < MOTION_BLOCK_WIDTH; ++i)
+			sum += abs(a[i] - b[i]);
+		block_sad[block] += sum;
+		a += MOTION_BLOCK_WIDTH;
+		b += MOTION_BLOCK_WIDTH;
+	}
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// psadbw gives the SAD of each 8 byte half, one block is one instruction
+__attribute__((target("sse2")))
+void motion_sad_sse2(const uint8_t *a, const uint8_t *b, int blocks, uint32_t *block_sad)
+{
+	for (int block = 0; block < blocks; ++block) {
+		__m128i va = _mm_loadu_si128((const __m128i *)a);
+		__m128i vb = _mm_loadu_si128((const __m128i *)b);
+		__m128i sad = _mm_sad_epu8(va, vb);
+		block_sad[block] += _mm_cvtsi128_si32(sad) + _mm_extract_epi16(sad, 4);
+		a += MOTION_BLOCK_WIDTH;
+		b += MOTION_BLOCK_WIDTH;
+	}
+}
+
+// Two blocks per instruction, the odd block at the end of the row goes through SSE2
+__attribute__((target("avx2")))
+void motion_sad_avx2(const uint8_t *a, const uint8_t *b, int blocks, uint32_t *block_sad)
+{
+	int block = 0;
+	for (; block + 2 <= blocks; block += 2) {
+		__m256i va = _mm256_loadu_si256((const __m256i *)a);
+		__m256i vb = _mm256_loadu_si256((const __m256i *)b);
+		__m256i sad = _mm256_sad_epu8(va, vb);
+		// 64 bit lanes 0,1 belong to the first block, 2,3 to the second
+		__m128i low = _mm256_castsi256_si128(sad);
+		__m128i high = _mm256_extracti128_si256(sad, 1);
+		block_sad[block] += _mm_cvtsi128_si32(low) + _mm_extract_epi16(low, 4);
+		block_sad[block + 1] += _mm_cvtsi128_si32(high) + _mm_extract_epi16(high, 4);
+		a += 2 * MOTION_BLOCK_WIDTH;
+		b += 2 * MOTION_BLOCK_WIDTH;
+	}
+	if (block < blocks)
+		motion_sad_sse2(a, b, blocks - block, block_sad + block);
+}
+
+#endif
+
+MotionSadFunc motion_sad_best(const char **name)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		*name = "avx2";
+		return motion_sad_avx2;
+	}
+	if (__builtin_cpu_supports("sse2")) {
+		*name = "sse2";
+		return motion_sad_sse2;
+	}
+#endif
+	*name = "scalar";
+	return motion_sad_scalar;
+}
+
+MotionDetector::MotionDetector(const TranscodeOptions *opts, AVRational tb)
+	: time_base(tb),
+	  threshold(opts->motion_threshold), area(opts->motion_area / 100),
+	  regions(opts->motion_regions),
+	  width(0), height(0), block_cols(0), block_rows(0), region_blocks(0),
+	  last_motion(AV_NOPTS_VALUE), last_pass(AV_NOPTS_VALUE),
+	  frames(0), motion_frames(0), dropped(0)
+{
+	sad = motion_sad_best(&kernel);
+	hold = av_rescale_q((int64_t)(opts->motion_hold * AV_TIME_BASE), AV_TIME_BASE_Q, tb);
+	idle_interval = opts->motion_idle_fps > 0 ?
+		av_rescale_q((int64_t)(AV_TIME_BASE / opts->motion_idle_fps), AV_TIME_BASE_Q, tb) : 0;
+	if (regions.empty())
+		regions.push_back({0, 0, 1, 1});
+}
+
+// data[0] holds plain luma rows for planar and semi-planar YUV and gray only
+static bool luma_plane(const AVFrame *frame)
+{
+	const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((AVPixelFormat)frame->format);
+	if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL)))
+		return false;
+	if (desc->comp[0].depth != 8 || desc->comp[0].step != 1)
+		return false;
+	return (desc->flags & AV_PIX_FMT_FLAG_PLANAR) || desc->nb_components == 1;
+}
+
+// Sizes the block grid for the frame and marks the blocks the regions cover
+static void motion_resize(MotionDetector *detector, int width, int height)
+{
+	detector->width = width;
+	detector->height = height;
+	detector->block_cols = width / MOTION_BLOCK_WIDTH;
+	detector->block_rows = height / MOTION_BLOCK_HEIGHT;
+
+	int blocks = detector->block_cols * detector->block_rows;
+	int rows = detector->block_rows * MOTION_BLOCK_HEIGHT / MOTION_ROW_STEP;
+	detector->reference.assign((size_t)rows * detector->block_cols * MOTION_BLOCK_WIDTH, 0);
+	detector->block_sad.assign(blocks, 0);
+	detector->block_mask.assign(blocks, 0);
+
+	for (auto &region : detector->regions) {
+		int x0 = std::max(0, (int)std::floor(region.x * detector->block_cols));
+		int y0 = std::max(0, (int)std::floor(region.y * detector->block_rows));
+		int x1 = std::min(detector->block_cols, (int)std::ceil((region.x + region.w) * detector->block_cols));
+		int y1 = std::min(detector->block_rows, (int)std::ceil((region.y + region.h) * detector->block_rows));
+		for (int y = y0; y < y1; ++y)
+			for (int x = x0; x < x1; ++x)
+				detector->block_mask[y * detector->block_cols + x] = 1;
+	}
+	detector->region_blocks = std::count(detector->block_mask.begin(), detector->block_mask.end(), 1);
+	detector->last_motion = AV_NOPTS_VALUE;
+}
+
+// Compares the frame against the previous one and keeps it as the next reference.
+// Returns false when there is nothing to compare against yet.
+static bool motion_compare(MotionDetector *detector, const AVFrame *frame, bool *motion)
+{
+	bool first = detector->width != frame->width || detector->height != frame->height;
+	if (first)
+		motion_resize(detector, frame->width, frame->height);
+
+	size_t row_bytes = (size_t)detector->block_cols * MOTION_BLOCK_WIDTH;
+	uint8_t *reference = detector->reference.data();
+	std::fill(detector->block_sad.begin(), detector->block_sad.end(), 0);
+
+	for (int block_row = 0; block_row < detector->block_rows; ++block_row) {
+		uint32_t *block_sad = &detector->block_sad[block_row * detector->block_cols];
+		for (int y = 0; y < MOTION_BLOCK_HEIGHT; y += MOTION_ROW_STEP) {
+			const uint8_t *row = frame->data[0] + (ptrdiff_t)(block_row * MOTION_BLOCK_HEIGHT + y) * frame->linesize[0];
+			if (!first)
+				detector->sad(row, reference, detector->block_cols, block_sad);
+			memcpy(reference, row, row_bytes);
+			reference += row_bytes;
+		}
+	}
+	if (first)
+		return false;
+
+	const uint32_t limit = (uint32_t)(detector->threshold * MOTION_BLOCK_WIDTH * MOTION_BLOCK_HEIGHT / MOTION_ROW_STEP);
+	int changed = 0;
+	for (size_t i = 0; i < detector->block_sad.size(); ++i)
+		changed += detector->block_mask[i] && detector->block_sad[i] > limit;
+
+	*motion = changed > 0 && changed >= detector->area * detector->region_blocks;
+	return true;
+}
+
+bool motion_detector_accept(MotionDetector *detector, const AVFrame *frame)
+{
+	detector->frames++;
+	if (!luma_plane(frame) || frame->width < MOTION_BLOCK_WIDTH || frame->height < MOTION_BLOCK_HEIGHT)
+		return true;
+
+	int64_t pts = frame->best_effort_timestamp != AV_NOPTS_VALUE ? frame->best_effort_timestamp : frame->pts;
+	bool motion = true;
+	if (!motion_compare(detector, frame, &motion) || pts == AV_NOPTS_VALUE)
+		motion = true;
+
+	if (motion) {
+		detector->motion_frames++;
+		detector->last_motion = pts;
+	}
+
+	bool pass = motion ||
+		(detector->last_motion != AV_NOPTS_VALUE && pts - detector->last_motion < detector->hold) ||
+		(detector->idle_interval > 0 && (detector->last_pass == AV_NOPTS_VALUE || pts - detector->last_pass >= detector->idle_interval));
+	if (!pass) {
+		detector->dropped++;
+		return false;
+	}
+	detector->last_pass = pts;
+	return true;
+}
+
+void motion_detector_report(const MotionDetector *detector)
+{
+	uint64_t frames = detector->frames;
+	uint64_t dropped = detector->dropped;
+
+	log_message(LOG_LEVEL_INFO, "Motion (%s): %llu frames, %llu with motion, %llu not encoded (%.1f%%)\n",
+		detector->kernel, (unsigned long long)frames, (unsigned long long)detector->motion_frames.load(),
+		(unsigned long long)dropped, frames ? 100.0 * dropped / frames : 0.0);
+}
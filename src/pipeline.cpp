@@ -0,0 +1,721 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Demux, decode, encode and mux stages running on their own threads
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#include "../include/pipeline.hpp"
+#include "../include/logger.hpp"
+#include "../include/rendition.hpp"
+#include "../include/aux_streams.hpp"
+#include "../include/tee_output.hpp"
+#include <thread>
+#include <chrono>
+#include <memory>
+
+Pipeline::Pipeline(InputUtils *in, OutputUtils *out, const TranscodeOptions *options)
+	: in_state(in), out_state(out), opts(options),
+	  packet_queue(options->packet_queue_depth),
+	  frame_queue(options->frame_queue_depth),
+	  mux_queue(options->mux_queue_depth),
+	  aux_queue(options->packet_queue_depth),
+	  packet_stats{"packets", 0, 0},
+	  frame_stats{"frames", 0, 0},
+	  mux_stats{"mux", 0, 0},
+	  aux_stats{"passthrough", 0, 0},
+	  last_latency(),
+	  packet_pool(options->packet_queue_depth + options->mux_queue_depth + 16),
+	  frame_pool(options->frame_queue_depth + 8),
+	  abort(false), result(0), running(0),
+	  inline_stages(false)
+{
+}
+
+// Renditions flush and close their outputs when they go
+Pipeline::~Pipeline()
+{
+}
+
+int pipeline_setup(Pipeline *pipeline)
+{
+	const TranscodeOptions *opts = pipeline->opts;
+
+	if (event_recording_enabled(opts))
+		pipeline->events.reset(new EventRecorder(pipeline->out_state, &pipeline->packet_pool, opts));
+	if (opts->motion_detect && !opts->stream_copy)
+		pipeline->motion.reset(new MotionDetector(opts, pipeline->in_state->input_stream->time_base));
+
+	if (!opts->stream_copy)
+		pipeline->converter.reset(new FrameConverter(opts->codec_threads));
+	if (backpressure_enabled(pipeline->in_state, opts))
+		pipeline->backpressure.reset(new Backpressure(opts, pipeline->in_state->input_stream->time_base));
+	if (reconnect_enabled(pipeline->in_state, opts))
+		pipeline->reconnect.reset(new Reconnector(pipeline->in_state, opts));
+	if (encoder_control_supported(pipeline->out_state, opts))
+		pipeline->encoder_control.reset(new EncoderController(opts, main_encoder_settings(opts),
+			pipeline->out_state->output_codec_ctx->codec_id, pipeline->in_state->input_framerate));
+	if (opts->shm_name) {
+		if (opts->stream_copy && opts->shm_frames && !opts->shm_packets)
+			log_message(LOG_LEVEL_WARNING, "Nothing is decoded in stream copy mode, no frames go to shared memory (use --encode or --shm-data packets).\n");
+		pipeline->shm.reset(new ShmPublisher(pipeline->in_state, opts));
+		if (shm_publisher_open(pipeline->shm.get(), pipeline->out_state) != 0) {
+			log_message(LOG_LEVEL_ERROR, "Could not set up shared memory publishing\n");
+			return 1;
+		}
+	}
+	if (opts->restream) {
+		pipeline->restream.reset(new Restreamer(opts));
+		if (restream_open(pipeline->restream.get(), pipeline->out_state) != 0) {
+			log_message(LOG_LEVEL_ERROR, "Could not set up restreaming\n");
+			return 1;
+		}
+	}
+	if (opts->snapshot_interval > 0) {
+		pipeline->snapshots.reset(new Snapshotter(pipeline->in_state, opts));
+		if (snapshot_open(pipeline->snapshots.get(), pipeline->out_state->output_fmt_ctx->url) != 0) {
+			log_message(LOG_LEVEL_ERROR, "Could not set up snapshots\n");
+			return 1;
+		}
+	}
+	for (auto &options : opts->renditions) {
+		std::unique_ptr<Rendition> rendition(new Rendition(options));
+		if (rendition_open(rendition.get(), pipeline->in_state, pipeline->out_state->output_fmt_ctx->url, opts) != 0) {
+			log_message(LOG_LEVEL_ERROR, "Could not set up rendition %s\n", rendition->output_filename.c_str());
+			return 1;
+		}
+		pipeline->renditions.push_back(std::move(rendition));
+	}
+	return 0;
+}
+
+// Remember the first error and wake every stage blocked on a queue
+static void pipeline_fail(Pipeline *pipeline, int error)
+{
+	int expected = 0;
+	pipeline->result.compare_exchange_strong(expected, error);
+	pipeline->abort = true;
+}
+
+// Once the last packet went through the muxer, Ctrl+C included
+static void finish_events(Pipeline *pipeline)
+{
+	if (!pipeline->events || pipeline->abort)
+		return;
+	int ret = event_recorder_close(pipeline->events.get());
+	if (ret < 0)
+		pipeline_fail(pipeline, ret);
+}
+
+// Frames the encoder cannot take as they are get a converted copy, the others go on untouched
+static int convert_frame(Pipeline *pipeline, AVFrame **frame)
+{
+	FrameConverter *converter = pipeline->converter.get();
+	const AVCodecContext *codec_ctx = pipeline->out_state->output_codec_ctx;
+	if (!frame_converter_needed(*frame, codec_ctx)) {
+		frame_converter_pass(converter, codec_ctx);
+		return 0;
+	}
+
+	AVFrame *output = pipeline->frame_pool.get();
+	int ret = frame_convert(converter, codec_ctx, *frame, output);
+	if (ret < 0) {
+		char errorBuff[80];
+		log_message(LOG_LEVEL_ERROR, "Could not convert frame for the encoder: %s\n", av_make_error_string(errorBuff, 80, ret));
+		pipeline->frame_pool.put(output);
+		return ret;
+	}
+	pipeline->frame_pool.put(*frame);
+	*frame = output;
+	return 0;
+}
+
+static int encode_frame(Pipeline *pipeline, AVFrame *frame)
+{
+	if (pipeline->converter) {
+		int ret = convert_frame(pipeline, &frame);
+		if (ret < 0) {
+			pipeline->frame_pool.put(frame);
+			return ret;
+		}
+	}
+	if (pipeline->backpressure)
+		backpressure_update(pipeline->backpressure.get(), frame);
+	frame->pict_type = AV_PICTURE_TYPE_NONE;   // let encoder set the picture type by its own.
+	int ret = pipeline->encoder_control ? encoder_control_apply(pipeline->encoder_control.get(), pipeline) : 0;
+	if (ret >= 0)
+		ret = encode(pipeline->in_state, pipeline->out_state, frame, pipeline);
+	pipeline->frame_pool.put(frame);
+	return ret;
+}
+
+static int mux_packet(Pipeline *pipeline, AVPacket *packet)
+{
+	int ret = 0;
+	if (pipeline->opts->stream_copy)
+		ret = rebase_packet(pipeline->in_state, pipeline->out_state, packet);
+	if (ret == 0 && pipeline->packet_sink)
+		pipeline->packet_sink(packet, pipeline->out_state->packet_time_base);
+	if (ret == 0 && pipeline->shm)
+		shm_publish_packet(pipeline->shm.get(), packet);
+	if (ret == 0 && pipeline->restream)
+		restream_packet(pipeline->restream.get(), packet);
+	if (ret == 0 && pipeline->events) {
+		// The recorder keeps the packet or writes it, either way it returns it to the pool
+		uint64_t start = latency_now();
+		ret = event_recorder_write(pipeline->events.get(), packet);
+		pipeline->latency[STAGE_MUX].record_since(start);
+		return ret;
+	}
+	if (ret == 0) {
+		uint64_t start = latency_now();
+		ret = write_packet(pipeline->out_state, packet);
+		pipeline->latency[STAGE_MUX].record_since(start);
+	}
+	pipeline->packet_pool.put(packet);
+	return ret == AVERROR(EAGAIN) ? 0 : ret;
+}
+
+static int mux_aux_packet(Pipeline *pipeline, AVPacket *packet)
+{
+	OutputUtils *out_state = pipeline->out_state;
+	const AuxStream *aux = aux_stream_of(out_state, packet);
+	int ret = 0;
+
+	// Stream copy starts the video at zero on its first keyframe, the other streams follow it
+	if (pipeline->opts->stream_copy) {
+		if (out_state->copy_ts_offset == AV_NOPTS_VALUE) {
+			out_state->aux_streams->dropped++;
+			pipeline->packet_pool.put(packet);
+			return 0;
+		}
+		int64_t offset = av_rescale_q(out_state->copy_ts_offset, out_state->packet_time_base, aux->time_base);
+		if (packet->pts != AV_NOPTS_VALUE)
+			packet->pts -= offset;
+		if (packet->dts != AV_NOPTS_VALUE)
+			packet->dts -= offset;
+	}
+	ret = write_aux_packet(out_state, packet);
+	pipeline->packet_pool.put(packet);
+	return ret;
+}
+
+// Demuxed packets, video or passthrough
+static int mux_input_packet(Pipeline *pipeline, AVPacket *packet)
+{
+	if (aux_stream_of(pipeline->out_state, packet))
+		return mux_aux_packet(pipeline, packet);
+	return mux_packet(pipeline, packet);
+}
+
+// Passthrough packets skip the decoder and the encoder
+static void push_aux_packet(Pipeline *pipeline, AVPacket *input_packet)
+{
+	auto &queue = pipeline->inline_stages || pipeline->opts->stream_copy ? pipeline->packet_queue : pipeline->aux_queue;
+	AVPacket *packet = pipeline->packet_pool.get();
+	av_packet_move_ref(packet, input_packet);
+
+	bool pushed = pipeline->backpressure ? queue.try_push(packet) : queue.push(packet, pipeline->abort);
+	if (!pushed) {
+		pipeline->out_state->aux_streams->dropped++;
+		pipeline->packet_pool.put(packet);
+		return;
+	}
+	if (pipeline->on_packet)
+		pipeline->on_packet();
+}
+
+static void rendition_failed(Rendition *rendition, int error)
+{
+	char errorBuff[80];
+	log_message(LOG_LEVEL_ERROR, "Rendition %s stopped: %s\n", rendition->output_filename.c_str(), av_make_error_string(errorBuff, 80, error));
+	pipeline_fail(rendition->pipeline.get(), error);
+}
+
+// Every rendition gets a reference of the decoded frame, not a copy.
+// A failed rendition is skipped, the main output and the others go on.
+static void push_renditions(Pipeline *pipeline, AVFrame *frame)
+{
+	for (auto &rendition : pipeline->renditions) {
+		Pipeline *target = rendition->pipeline.get();
+		if (target->abort)
+			continue;
+
+		if (pipeline->inline_stages) {
+			AVFrame *scaled;
+			int ret = rendition_scale(rendition.get(), frame, &scaled);
+			if (ret >= 0)
+				ret = encode_frame(target, scaled);
+			if (ret < 0)
+				rendition_failed(rendition.get(), ret);
+			continue;
+		}
+
+		// With backpressure a rendition that falls behind loses frames, it never stalls the decoder
+		AVFrame *reference = target->frame_pool.get();
+		bool queued = av_frame_ref(reference, frame) >= 0 &&
+			(pipeline->backpressure ? target->frame_queue.try_push(reference) : target->frame_queue.push(reference, target->abort));
+		if (!queued) {
+			if (pipeline->backpressure)
+				pipeline->backpressure->frames_queue_full++;
+			target->frame_pool.put(reference);
+		}
+	}
+}
+
+int pipeline_push_frame(Pipeline *pipeline, AVFrame *frame)
+{
+	// Static frames are dropped here, before they cost a queue slot or an encode
+	if (pipeline->motion && !motion_detector_accept(pipeline->motion.get(), frame)) {
+		pipeline->frame_pool.put(frame);
+		return 0;
+	}
+	if (pipeline->backpressure && !backpressure_keep_frame(pipeline->backpressure.get())) {
+		pipeline->frame_pool.put(frame);
+		return 0;
+	}
+	if (!pipeline->renditions.empty())
+		push_renditions(pipeline, frame);
+	if (pipeline->inline_stages)
+		return encode_frame(pipeline, frame);
+
+	// The decoder is never held up by a slow encoder, the frame is dropped instead
+	if (pipeline->backpressure) {
+		if (!pipeline->frame_queue.try_push(frame)) {
+			pipeline->backpressure->frames_queue_full++;
+			pipeline->frame_pool.put(frame);
+		}
+		return 0;
+	}
+	if (!pipeline->frame_queue.push(frame, pipeline->abort)) {
+		pipeline->frame_pool.put(frame);
+		return AVERROR_EXIT;
+	}
+	return 0;
+}
+
+int pipeline_push_packet(Pipeline *pipeline, AVPacket *packet)
+{
+	if (pipeline->inline_stages)
+		return mux_packet(pipeline, packet);
+
+	if (!pipeline->mux_queue.push(packet, pipeline->abort)) {
+		pipeline->packet_pool.put(packet);
+		return AVERROR_EXIT;
+	}
+	return 0;
+}
+
+// Holds a video packet back until as much wall clock time passed since the
+// first one as its DTS says, a file is then read at the pace of a camera
+static void pace_packet(const AVPacket *packet, AVRational time_base, int64_t *first_dts, uint64_t *start)
+{
+	int64_t dts = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+	if (dts == AV_NOPTS_VALUE)
+		return;
+	if (*first_dts == AV_NOPTS_VALUE) {
+		*first_dts = dts;
+		*start = latency_now();
+		return;
+	}
+	uint64_t due = *start + av_rescale_q(dts - *first_dts, time_base, AVRational{1, 1000000000});
+	uint64_t now = latency_now();
+	if (due > now)
+		std::this_thread::sleep_for(std::chrono::nanoseconds(due - now));
+}
+
+void pipeline_demux(Pipeline *pipeline)
+{
+	// Linking Variables
+	auto &input_fmt_ctx = pipeline->in_state->input_fmt_ctx;
+	auto &input_packet = pipeline->in_state->input_packet;
+	int video_stream_idx = pipeline->in_state->video_stream_idx;
+	Reconnector *reconnector = pipeline->reconnect.get();
+	int64_t pace_first_dts = AV_NOPTS_VALUE;
+	uint64_t pace_start = 0;
+	char errorBuff[80];
+
+	while (!input_stopped(pipeline->in_state) && !pipeline->abort) {
+		uint64_t start = latency_now();
+		input_arm_timeout(pipeline->in_state);
+		int ret = av_read_frame(input_fmt_ctx, input_packet);
+		pipeline->in_state->io_deadline = 0;
+		pipeline->latency[STAGE_READ].record_since(start);
+		if (ret < 0 && input_stopped(pipeline->in_state))
+			break;
+		if (ret < 0) {
+			if (ret != AVERROR_EOF)
+				log_message(LOG_LEVEL_ERROR, "Error reading input: %s\n", av_make_error_string(errorBuff, 80, ret));
+			// input_fmt_ctx refers to the new connection afterwards
+			if (reconnector) {
+				log_message(LOG_LEVEL_WARNING, "Lost the input, reconnecting\n");
+				if (input_reconnect(reconnector, pipeline->in_state, pipeline->abort) == 0) {
+					video_stream_idx = pipeline->in_state->video_stream_idx;
+					continue;
+				}
+			}
+			break;
+		}
+		if (input_packet->stream_index != video_stream_idx) {
+			const AuxStream *aux = aux_stream_of(pipeline->out_state, input_packet);
+			if (aux && (!reconnector || reconnect_aux_packet(reconnector, input_packet, aux->time_base)))
+				push_aux_packet(pipeline, input_packet);
+			else
+				av_packet_unref(input_packet);
+			continue;
+		}
+		if (reconnector && !reconnect_packet(reconnector, input_packet)) {
+			av_packet_unref(input_packet);
+			continue;
+		}
+		if (pipeline->opts->realtime)
+			pace_packet(input_packet, pipeline->in_state->input_time_base, &pace_first_dts, &pace_start);
+
+		if (pipeline->snapshots)
+			snapshot_packet(pipeline->snapshots.get(), input_packet);
+
+		// With backpressure reading never waits: a full queue drops packets up to the next keyframe
+		Backpressure *backpressure = pipeline->backpressure.get();
+		if (backpressure && backpressure_drop_packet(backpressure, input_packet, false)) {
+			av_packet_unref(input_packet);
+			continue;
+		}
+
+		// hand the reference over to the decoder thread, input_packet is reused
+		AVPacket *packet = pipeline->packet_pool.get();
+		av_packet_move_ref(packet, input_packet);
+		if (backpressure) {
+			if (!pipeline->packet_queue.try_push(packet)) {
+				backpressure_drop_packet(backpressure, packet, true);
+				pipeline->packet_pool.put(packet);
+				continue;
+			}
+		}
+		else if (!pipeline->packet_queue.push(packet, pipeline->abort)) {
+			pipeline->packet_pool.put(packet);
+			break;
+		}
+		if (pipeline->on_packet)
+			pipeline->on_packet();
+	}
+	pipeline->packet_queue.close();
+	pipeline->aux_queue.close();
+	if (pipeline->on_packet)
+		pipeline->on_packet();
+}
+
+static void demux_stage(Pipeline *pipeline)
+{
+	pipeline_demux(pipeline);
+	pipeline->running--;
+}
+
+static void decode_stage(Pipeline *pipeline)
+{
+	AVPacket *packet;
+	int ret = 0;
+
+	while (pipeline->packet_queue.pop(packet, pipeline->abort)) {
+		ret = decode(pipeline->in_state, packet, pipeline);
+		pipeline->packet_pool.put(packet);
+		if (ret < 0)
+			break;
+	}
+	// Drain the frames still buffered inside the decoder
+	if (ret >= 0 && !pipeline->abort)
+		ret = decode(pipeline->in_state, NULL, pipeline);
+	if (ret < 0)
+		pipeline_fail(pipeline, ret);
+
+	pipeline->frame_queue.close();
+	for (auto &rendition : pipeline->renditions)
+		rendition->pipeline->frame_queue.close();
+	pipeline->running--;
+}
+
+static void encode_stage(Pipeline *pipeline)
+{
+	AVFrame *frame;
+	int ret = 0;
+
+	while (pipeline->frame_queue.pop(frame, pipeline->abort)) {
+		ret = encode_frame(pipeline, frame);
+		if (ret < 0)
+			break;
+	}
+	// Flush encoder by giving NULL frame to signal the end of stream
+	if (ret >= 0 && !pipeline->abort)
+		ret = encode(pipeline->in_state, pipeline->out_state, NULL, pipeline);
+	if (ret < 0)
+		pipeline_fail(pipeline, ret);
+
+	pipeline->mux_queue.close();
+	pipeline->running--;
+}
+
+// Scales, encodes and muxes one rendition, fed by the decode stage
+static void rendition_stage(Rendition *rendition)
+{
+	Pipeline *pipeline = rendition->pipeline.get();
+	AVFrame *frame, *scaled;
+	int ret = 0;
+
+	while (pipeline->frame_queue.pop(frame, pipeline->abort)) {
+		ret = rendition_scale(rendition, frame, &scaled);
+		pipeline->frame_pool.put(frame);
+		if (ret >= 0)
+			ret = encode_frame(pipeline, scaled);
+		if (ret < 0)
+			break;
+	}
+	if (ret >= 0 && !pipeline->abort)
+		ret = encode(pipeline->in_state, pipeline->out_state, NULL, pipeline);
+	if (ret < 0)
+		rendition_failed(rendition, ret);
+}
+
+static void mux_stage(Pipeline *pipeline)
+{
+	// In stream copy mode the muxer takes the demuxed packets directly,
+	// passthrough packets included. Otherwise they come on their own queue.
+	bool stream_copy = pipeline->opts->stream_copy;
+	auto &queue = stream_copy ? pipeline->packet_queue : pipeline->mux_queue;
+	auto &aux_queue = pipeline->aux_queue;
+	AVPacket *packet;
+	unsigned spins = 0;
+
+	for (;;) {
+		int ret = 0;
+		bool idle = true;
+		if (queue.try_pop(packet)) {
+			ret = stream_copy ? mux_input_packet(pipeline, packet) : mux_packet(pipeline, packet);
+			idle = false;
+		}
+		if (ret >= 0 && !stream_copy && aux_queue.try_pop(packet)) {
+			ret = mux_aux_packet(pipeline, packet);
+			idle = false;
+		}
+		if (ret < 0) {
+			pipeline_fail(pipeline, ret);
+			break;
+		}
+		if (!idle) {
+			spins = 0;
+			continue;
+		}
+		// Closed before the emptiness check, nothing can be pushed in between
+		if (queue.closed() && queue.size() == 0 && (stream_copy || (aux_queue.closed() && aux_queue.size() == 0)))
+			break;
+		if (pipeline->abort)
+			break;
+		SpscQueue<AVPacket*>::backoff(spins);
+	}
+	finish_events(pipeline);
+	pipeline->running--;
+}
+
+bool pipeline_process(Pipeline *pipeline, int budget)
+{
+	AVPacket *packet;
+	int ret = 0;
+
+	while (budget-- > 0 && !pipeline->abort && pipeline->packet_queue.try_pop(packet)) {
+		if (pipeline->opts->stream_copy || aux_stream_of(pipeline->out_state, packet))
+			ret = mux_input_packet(pipeline, packet);
+		else {
+			ret = decode(pipeline->in_state, packet, pipeline);
+			pipeline->packet_pool.put(packet);
+		}
+		if (ret < 0) {
+			pipeline_fail(pipeline, ret);
+			return true;
+		}
+	}
+	if (pipeline->abort)
+		return true;
+	if (!pipeline->packet_queue.closed() || pipeline->packet_queue.size() > 0)
+		return false;
+
+	// Input is exhausted, drain the decoder and then the encoders
+	if (!pipeline->opts->stream_copy) {
+		ret = decode(pipeline->in_state, NULL, pipeline);
+		if (ret >= 0)
+			ret = encode(pipeline->in_state, pipeline->out_state, NULL, pipeline);
+		if (ret < 0)
+			pipeline_fail(pipeline, ret);
+
+		for (auto &rendition : pipeline->renditions) {
+			Pipeline *target = rendition->pipeline.get();
+			if (target->abort)
+				continue;
+			ret = encode(target->in_state, target->out_state, NULL, target);
+			if (ret < 0)
+				rendition_failed(rendition.get(), ret);
+		}
+	}
+	finish_events(pipeline);
+	return true;
+}
+
+// Frees whatever is left in the queues after an aborted run
+static void pipeline_drain(Pipeline *pipeline)
+{
+	AVPacket *packet;
+	AVFrame *frame;
+
+	while (pipeline->packet_queue.try_pop(packet))
+		pipeline->packet_pool.put(packet);
+	while (pipeline->frame_queue.try_pop(frame))
+		pipeline->frame_pool.put(frame);
+	while (pipeline->mux_queue.try_pop(packet))
+		pipeline->packet_pool.put(packet);
+	while (pipeline->aux_queue.try_pop(packet))
+		pipeline->packet_pool.put(packet);
+}
+
+static void sample_queue(QueueStats *stats, size_t size)
+{
+	stats->samples++;
+	stats->total += size;
+}
+
+void pipeline_sample(Pipeline *pipeline)
+{
+	sample_queue(&pipeline->packet_stats, pipeline->packet_queue.size());
+	sample_queue(&pipeline->frame_stats, pipeline->frame_queue.size());
+	sample_queue(&pipeline->mux_stats, pipeline->mux_queue.size());
+	sample_queue(&pipeline->aux_stats, pipeline->aux_queue.size());
+	for (auto &rendition : pipeline->renditions)
+		sample_queue(&rendition->pipeline->frame_stats, rendition->pipeline->frame_queue.size());
+}
+
+int pipeline_run(Pipeline *pipeline)
+{
+	const auto sample_period = std::chrono::milliseconds(100);
+	auto last_report = std::chrono::steady_clock::now();
+
+	// Stream copy needs neither the decoder nor the encoder thread
+	bool stream_copy = pipeline->opts->stream_copy;
+	std::thread decode_thread, encode_thread;
+
+	pipeline->running = stream_copy ? 2 : 4;
+	std::thread demux_thread(demux_stage, pipeline);
+	if (!stream_copy) {
+		decode_thread = std::thread(decode_stage, pipeline);
+		encode_thread = std::thread(encode_stage, pipeline);
+	}
+	std::thread mux_thread(mux_stage, pipeline);
+	std::vector<std::thread> rendition_threads;
+	for (auto &rendition : pipeline->renditions)
+		rendition_threads.emplace_back(rendition_stage, rendition.get());
+
+	// The calling thread samples queue occupancy until every stage is done
+	while (pipeline->running > 0) {
+		std::this_thread::sleep_for(sample_period);
+		pipeline_sample(pipeline);
+
+		auto now = std::chrono::steady_clock::now();
+		if (pipeline->opts->stats_interval > 0 &&
+				now - last_report >= std::chrono::seconds(pipeline->opts->stats_interval)) {
+			pipeline_report(pipeline, true);
+			last_report = now;
+		}
+	}
+
+	demux_thread.join();
+	if (!stream_copy) {
+		decode_thread.join();
+		encode_thread.join();
+	}
+	mux_thread.join();
+	for (size_t i = 0; i < rendition_threads.size(); ++i) {
+		rendition_threads[i].join();
+		pipeline_drain(pipeline->renditions[i]->pipeline.get());
+	}
+	pipeline_drain(pipeline);
+
+	return pipeline->result;
+}
+
+template <typename T>
+static void report_queue(const QueueStats &stats, const SpscQueue<T> &queue)
+{
+	double average = stats.samples ? (double)stats.total / stats.samples : 0;
+
+	log_message(LOG_LEVEL_INFO, "  %-8s %4zu/%-4zu avg %6.1f  peak %4zu\n",
+		stats.name, queue.size(), queue.capacity(), average, queue.peak());
+}
+
+// Interval reports show the latency since the previous interval report,
+// the final one everything since the start
+static void report_latency(Pipeline *pipeline, bool interval)
+{
+	std::unique_ptr<LatencySnapshot[]> snapshots(new LatencySnapshot[STAGE_COUNT]);
+
+	for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+		pipeline->latency[stage].snapshot(&snapshots[stage]);
+		if (interval) {
+			LatencySnapshot current = snapshots[stage];
+			snapshots[stage].subtract(pipeline->last_latency[stage]);
+			pipeline->last_latency[stage] = current;
+		}
+	}
+	latency_report(snapshots.get());
+}
+
+void pipeline_report(Pipeline *pipeline, bool interval)
+{
+	log_message(LOG_LEVEL_INFO, "\nQueue occupancy (now/depth):\n");
+	report_queue(pipeline->packet_stats, pipeline->packet_queue);
+	if (!pipeline->opts->stream_copy && !pipeline->inline_stages) {
+		report_queue(pipeline->frame_stats, pipeline->frame_queue);
+		report_queue(pipeline->mux_stats, pipeline->mux_queue);
+		if (pipeline->out_state->aux_streams)
+			report_queue(pipeline->aux_stats, pipeline->aux_queue);
+	}
+
+	report_latency(pipeline, interval);
+	if (pipeline->converter)
+		frame_converter_report(pipeline->converter.get());
+	if (pipeline->motion)
+		motion_detector_report(pipeline->motion.get());
+	if (pipeline->events)
+		event_recorder_report(pipeline->events.get());
+	if (pipeline->snapshots)
+		snapshot_report(pipeline->snapshots.get());
+	if (pipeline->backpressure)
+		backpressure_report(pipeline->backpressure.get());
+	if (pipeline->encoder_control)
+		encoder_control_report(pipeline->encoder_control.get());
+	if (pipeline->reconnect)
+		reconnect_report(pipeline->reconnect.get());
+	if (pipeline->shm)
+		shm_publisher_report(pipeline->shm.get());
+	if (pipeline->restream)
+		restream_report(pipeline->restream.get());
+	if (pipeline->out_state->aux_streams)
+		aux_streams_report(pipeline->out_state->aux_streams);
+	if (pipeline->out_state->tee)
+		tee_report(pipeline->out_state->tee);
+
+	// Allocation counters, "new" stays flat once the session is warmed up
+	FrameBufferPool *buffer_pool = pipeline->in_state->frame_buffer_pool;
+	log_message(LOG_LEVEL_INFO, "Allocations: packets %llu new/%llu reused, frames %llu new/%llu reused, frame buffers %llu\n",
+		(unsigned long long)pipeline->packet_pool.counters.allocated, (unsigned long long)pipeline->packet_pool.counters.reused,
+		(unsigned long long)pipeline->frame_pool.counters.allocated, (unsigned long long)pipeline->frame_pool.counters.reused,
+		(unsigned long long)(buffer_pool ? buffer_pool->allocated.load() : 0));
+
+	for (auto &rendition : pipeline->renditions) {
+		Pipeline *target = rendition->pipeline.get();
+		log_message(LOG_LEVEL_INFO, "\nRendition %dx%d (%s)%s:\n", rendition->settings.width, rendition->settings.height,
+			rendition->output_filename.c_str(), target->abort ? " stopped" : "");
+		if (!pipeline->inline_stages)
+			report_queue(target->frame_stats, target->frame_queue);
+		report_latency(target, interval);
+	}
+}
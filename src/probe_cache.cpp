@@ -0,0 +1,180 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Stream parameters remembered per input URL for a short probe
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#include "../include/probe_cache.hpp"
+#include "../include/logger.hpp"
+#include <cinttypes>
+#include <cstring>
+#include <fstream>
+
+// Enough for a couple of frames of a camera stream once the parameters are known
+static const int64_t short_analyze_duration = AV_TIME_BASE / 5;
+static const int64_t short_probesize = 512 * 1024;
+
+ProbeInfo::ProbeInfo()
+	: params(avcodec_parameters_alloc()), time_base{0, 1}, frame_rate{0, 1}
+{
+}
+
+ProbeInfo::~ProbeInfo()
+{
+	avcodec_parameters_free(&params);
+}
+
+void probe_info_from_input(ProbeInfo *info, const InputUtils *in_state)
+{
+	avcodec_parameters_copy(info->params, in_state->input_codec_params);
+	info->time_base = in_state->input_time_base;
+	info->frame_rate = in_state->input_framerate;
+}
+
+static AVStream *video_stream_of(const AVFormatContext *input_fmt_ctx)
+{
+	for (unsigned i = 0; i < input_fmt_ctx->nb_streams; i++) {
+		if (input_fmt_ctx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+			return input_fmt_ctx->streams[i];
+	}
+	return NULL;
+}
+
+void probe_info_apply(const ProbeInfo *info, AVFormatContext *input_fmt_ctx)
+{
+	AVStream *stream = video_stream_of(input_fmt_ctx);
+	if (!stream || stream->codecpar->codec_id != info->params->codec_id)
+		return;
+
+	// Only what the demuxer did not find in the header itself
+	AVCodecParameters *params = stream->codecpar;
+	if (params->width == 0 || params->height == 0) {
+		params->width = info->params->width;
+		params->height = info->params->height;
+	}
+	if (params->format < 0)
+		params->format = info->params->format;
+	if (params->extradata_size == 0 && info->params->extradata_size > 0) {
+		params->extradata = (uint8_t *)av_mallocz(info->params->extradata_size + AV_INPUT_BUFFER_PADDING_SIZE);
+		if (params->extradata) {
+			memcpy(params->extradata, info->params->extradata, info->params->extradata_size);
+			params->extradata_size = info->params->extradata_size;
+		}
+	}
+	if (stream->avg_frame_rate.num == 0)
+		stream->avg_frame_rate = info->frame_rate;
+	if (stream->r_frame_rate.num == 0)
+		stream->r_frame_rate = info->frame_rate;
+
+	input_fmt_ctx->max_analyze_duration = short_analyze_duration;
+	input_fmt_ctx->probesize = short_probesize;
+}
+
+bool probe_info_matches(const ProbeInfo *info, const AVFormatContext *input_fmt_ctx)
+{
+	const AVStream *stream = video_stream_of(input_fmt_ctx);
+	if (!stream)
+		return false;
+	const AVCodecParameters *params = stream->codecpar;
+	return params->codec_id == info->params->codec_id &&
+		params->width == info->params->width && params->height == info->params->height &&
+		av_cmp_q(stream->time_base, info->time_base) == 0;
+}
+
+// Named after a hash of the URL, so camera credentials do not end up on disk
+static std::string cache_filename(const char *directory, const char *url)
+{
+	uint64_t hash = 14695981039346656037ULL;   // FNV-1a
+	for (const char *c = url; *c; c++) {
+		hash ^= (unsigned char)*c;
+		hash *= 1099511628211ULL;
+	}
+	char name[32];
+	snprintf(name, sizeof(name), "%016" PRIx64 ".probe", hash);
+	return std::string(directory) + "/" + name;
+}
+
+bool probe_cache_load(const char *directory, const char *url, ProbeInfo *info)
+{
+	std::ifstream file(cache_filename(directory, url));
+	if (!file)
+		return false;
+
+	AVCodecParameters *params = info->params;
+	params->codec_type = AVMEDIA_TYPE_VIDEO;
+	std::string line;
+	while (std::getline(file, line)) {
+		size_t equals = line.find('=');
+		if (equals == std::string::npos)
+			continue;
+		std::string key = line.substr(0, equals);
+		std::string value = line.substr(equals + 1);
+		if (key == "codec") {
+			const AVCodecDescriptor *descriptor = avcodec_descriptor_get_by_name(value.c_str());
+			params->codec_id = descriptor ? descriptor->id : AV_CODEC_ID_NONE;
+		}
+		else if (key == "width")
+			params->width = atoi(value.c_str());
+		else if (key == "height")
+			params->height = atoi(value.c_str());
+		else if (key == "format")
+			params->format = av_get_pix_fmt(value.c_str());
+		else if (key == "time_base")
+			sscanf(value.c_str(), "%d/%d", &info->time_base.num, &info->time_base.den);
+		else if (key == "frame_rate")
+			sscanf(value.c_str(), "%d/%d", &info->frame_rate.num, &info->frame_rate.den);
+		else if (key == "extradata" && value.size() % 2 == 0 && !value.empty()) {
+			av_freep(&params->extradata);
+			params->extradata = (uint8_t *)av_mallocz(value.size() / 2 + AV_INPUT_BUFFER_PADDING_SIZE);
+			if (!params->extradata)
+				return false;
+			for (size_t i = 0; i < value.size() / 2; i++)
+				params->extradata[i] = (uint8_t)strtoul(value.substr(2 * i, 2).c_str(), NULL, 16);
+			params->extradata_size = (int)(value.size() / 2);
+		}
+	}
+	return params->codec_id != AV_CODEC_ID_NONE && params->width > 0 && params->height > 0 &&
+		info->time_base.num > 0 && info->time_base.den > 0;
+}
+
+// The rename keeps a second process from reading half a file
+int probe_cache_store(const char *directory, const char *url, const InputUtils *in_state)
+{
+	std::error_code error;
+	std::experimental::filesystem::create_directories(directory, error);
+
+	std::string filename = cache_filename(directory, url);
+	std::string temp_filename = filename + ".tmp";
+	FILE *file = fopen(temp_filename.c_str(), "w");
+	if (!file) {
+		log_message(LOG_LEVEL_WARNING, "Could not write probe cache %s\n", filename.c_str());
+		return 1;
+	}
+
+	const AVCodecParameters *params = in_state->input_codec_params;
+	const char *format = av_get_pix_fmt_name((enum AVPixelFormat)params->format);
+	fprintf(file, "codec=%s\nwidth=%d\nheight=%d\n", avcodec_get_name(params->codec_id), params->width, params->height);
+	if (format)
+		fprintf(file, "format=%s\n", format);
+	fprintf(file, "time_base=%d/%d\nframe_rate=%d/%d\n", in_state->input_time_base.num, in_state->input_time_base.den,
+		in_state->input_framerate.num, in_state->input_framerate.den);
+	if (params->extradata_size > 0) {
+		fprintf(file, "extradata=");
+		for (int i = 0; i < params->extradata_size; i++)
+			fprintf(file, "%02x", params->extradata[i]);
+		fprintf(file, "\n");
+	}
+	fclose(file);
+
+	if (rename(temp_filename.c_str(), filename.c_str()) != 0) {
+		remove(temp_filename.c_str());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,174 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Reconnecting a lost input without breaking the recording
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#include "../include/reconnect.hpp"
+#include "../include/backpressure.hpp"
+#include "../include/latency.hpp"
+#include "../include/logger.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <thread>
+
+static const int64_t max_delay = 30000000000LL;   // ns, cap of the backoff
+
+Reconnector::Reconnector(const InputUtils *in_state, const TranscodeOptions *opts)
+	: url(in_state->input_fmt_ctx->url), stream_copy(opts->stream_copy),
+	  time_base(in_state->input_time_base), stream_time_base(in_state->input_time_base),
+	  base_delay((int64_t)(opts->reconnect_delay * 1000000)), max_attempts(opts->reconnect_attempts),
+	  ts_offset(0), next_dts(AV_NOPTS_VALUE), last_packet(latency_now()), rebase(false),
+	  reconnects(0), failed_attempts(0), packets_dropped(0), last_outage(0), max_outage(0), total_outage(0)
+{
+	probe_info_from_input(&probe, in_state);
+	frame_duration = std::max<int64_t>(1, av_rescale_q(1, av_inv_q(in_state->input_framerate), time_base));
+}
+
+bool reconnect_enabled(const InputUtils *in_state, const TranscodeOptions *opts)
+{
+	if (opts->reconnect == RECONNECT_AUTO)
+		return is_live_input(in_state);
+	return opts->reconnect == RECONNECT_ALWAYS;
+}
+
+// The decoder and the output were set up for the first connection
+static bool same_stream(const Reconnector *reconnector, const AVCodecParameters *params)
+{
+	const AVCodecParameters *first = reconnector->probe.params;
+	if (params->codec_id != first->codec_id || params->width != first->width ||
+			params->height != first->height || params->format != first->format)
+		return false;
+	if (!reconnector->stream_copy)
+		return true;
+	return params->extradata_size == first->extradata_size &&
+		(!params->extradata_size || !memcmp(params->extradata, first->extradata, params->extradata_size));
+}
+
+// Sleeps in small steps, returns false when the pipeline is stopped meanwhile
+static bool backoff_sleep(int64_t delay, const InputUtils *in_state, const std::atomic<bool> &abort)
+{
+	uint64_t until = latency_now() + delay;
+	while (latency_now() < until) {
+		if (input_stopped(in_state) || abort)
+			return false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	}
+	return true;
+}
+
+int input_reconnect(Reconnector *reconnector, InputUtils *in_state, const std::atomic<bool> &abort)
+{
+	// Cameras that went down together should not all come knocking at the same instant
+	static thread_local std::minstd_rand random(std::random_device{}());
+	uint64_t lost = latency_now();
+
+	for (int attempt = 0; reconnector->max_attempts == 0 || attempt < reconnector->max_attempts; attempt++) {
+		// Exponential backoff, picked at random from its upper half
+		int64_t delay = std::min(max_delay, reconnector->base_delay << std::min(attempt, 16));
+		delay = delay / 2 + (int64_t)(random() % (uint64_t)(delay / 2 + 1));
+		if (!backoff_sleep(delay, in_state, abort))
+			return AVERROR_EXIT;
+
+		InputUtils fresh = {};
+		fresh.io_timeout = in_state->io_timeout;
+		// RtspSession::stop() interrupts a connection attempt as well
+		fresh.stop_request = in_state->stop_request;
+		if (open_input_stream(&fresh, reconnector->url.c_str(), &reconnector->probe) != 0 || find_video_stream(&fresh) != 0) {
+			avformat_close_input(&fresh.input_fmt_ctx);
+			reconnector->failed_attempts++;
+			log_message(LOG_LEVEL_WARNING, "Reconnect attempt %d to %s failed\n", attempt + 1, reconnector->url.c_str());
+			continue;
+		}
+		if (!same_stream(reconnector, fresh.input_codec_params)) {
+			log_message(LOG_LEVEL_ERROR, "%s came back with different stream parameters, ending the recording\n", reconnector->url.c_str());
+			avformat_close_input(&fresh.input_fmt_ctx);
+			return AVERROR_INVALIDDATA;
+		}
+
+		// The old connection is likely dead, do not let its teardown hang
+		input_arm_timeout(in_state);
+		avformat_close_input(&in_state->input_fmt_ctx);
+		in_state->io_deadline = 0;
+
+		in_state->input_fmt_ctx = fresh.input_fmt_ctx;
+		in_state->input_fmt_ctx->interrupt_callback.opaque = in_state;
+		in_state->input_stream = fresh.input_stream;
+		in_state->input_codec_params = fresh.input_codec_params;
+		in_state->video_stream_idx = fresh.video_stream_idx;
+
+		reconnector->stream_time_base = fresh.input_time_base;
+		reconnector->rebase = true;
+		reconnector->reconnects++;
+		log_message(LOG_LEVEL_INFO, "Reconnected to %s after %d attempt(s), %.1f s\n",
+			reconnector->url.c_str(), attempt + 1, (latency_now() - lost) / 1e9);
+		return 0;
+	}
+	log_message(LOG_LEVEL_ERROR, "Giving up on %s after %d reconnect attempts\n", reconnector->url.c_str(), reconnector->max_attempts);
+	return AVERROR(EIO);
+}
+
+bool reconnect_packet(Reconnector *reconnector, AVPacket *packet)
+{
+	if (av_cmp_q(reconnector->stream_time_base, reconnector->time_base) != 0)
+		av_packet_rescale_ts(packet, reconnector->stream_time_base, reconnector->time_base);
+
+	uint64_t now = latency_now();
+	if (reconnector->rebase) {
+		// Nothing decodes before a keyframe of the new connection
+		int64_t first = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+		if (!(packet->flags & AV_PKT_FLAG_KEY) || first == AV_NOPTS_VALUE) {
+			reconnector->packets_dropped++;
+			return false;
+		}
+		uint64_t outage = now - reconnector->last_packet;
+		int64_t gap = av_rescale_q(outage, AVRational{1, 1000000000}, reconnector->time_base);
+		reconnector->ts_offset = reconnector->next_dts != AV_NOPTS_VALUE ?
+			reconnector->next_dts + gap - first : 0;
+		reconnector->rebase = false;
+
+		reconnector->last_outage = outage;
+		reconnector->total_outage += outage;
+		if (outage > reconnector->max_outage)
+			reconnector->max_outage = outage;
+	}
+
+	if (packet->pts != AV_NOPTS_VALUE)
+		packet->pts += reconnector->ts_offset;
+	if (packet->dts != AV_NOPTS_VALUE) {
+		packet->dts += reconnector->ts_offset;
+		reconnector->next_dts = packet->dts + (packet->duration > 0 ? packet->duration : reconnector->frame_duration);
+	}
+	reconnector->last_packet = now;
+	return true;
+}
+
+bool reconnect_aux_packet(const Reconnector *reconnector, AVPacket *packet, AVRational time_base)
+{
+	if (reconnector->rebase)
+		return false;
+	if (reconnector->ts_offset == 0)
+		return true;
+	int64_t offset = av_rescale_q(reconnector->ts_offset, reconnector->time_base, time_base);
+	if (packet->pts != AV_NOPTS_VALUE)
+		packet->pts += offset;
+	if (packet->dts != AV_NOPTS_VALUE)
+		packet->dts += offset;
+	return true;
+}
+
+void reconnect_report(const Reconnector *reconnector)
+{
+	log_message(LOG_LEVEL_INFO, "Reconnect: %llu reconnects, %llu failed attempts, outage last %.1f s, max %.1f s, total %.1f s, %llu packets dropped before a keyframe\n",
+		(unsigned long long)reconnector->reconnects.load(), (unsigned long long)reconnector->failed_attempts.load(),
+		reconnector->last_outage / 1e9, reconnector->max_outage / 1e9, reconnector->total_outage / 1e9,
+		(unsigned long long)reconnector->packets_dropped.load());
+}
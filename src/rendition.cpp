@@ -0,0 +1,126 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Extra outputs scaled and encoded from the decoded frames of a session
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#include "../include/rendition.hpp"
+#include "../include/pipeline.hpp"
+#include "../include/segmenter.hpp"
+#include "../include/logger.hpp"
+
+Rendition::Rendition(const RenditionOptions &rendition_options)
+	: options(rendition_options), settings(), out_state(), converter(0)
+{
+}
+
+Rendition::~Rendition()
+{
+	// The pipeline only exists once the output was opened
+	if (pipeline) {
+		close_output_stream(&out_state);
+		print_output_size(output_filename.c_str());
+	}
+	else {
+		// rendition_open() failed part way, nothing was written
+		if (out_state.output_fmt_ctx)
+			close_output_file(&out_state);
+		delete out_state.segmenter;
+		avcodec_free_context(&out_state.output_codec_ctx);
+		avformat_free_context(out_state.output_fmt_ctx);
+		av_dict_free(&out_state.muxer_options);
+	}
+	pipeline.reset();
+}
+
+// "cam.mp4" -> "cam_360p.mp4"
+static std::string rendition_filename(const char *main_filename, int height)
+{
+	std::string filename = main_filename;
+	std::string suffix = "_" + std::to_string(height) + "p";
+	size_t dot = filename.rfind('.');
+	size_t slash = filename.rfind('/');
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		return filename + suffix;
+	return filename.substr(0, dot) + suffix + filename.substr(dot);
+}
+
+int rendition_open(Rendition *rendition, InputUtils *in_state, const char *main_filename, const TranscodeOptions *opts)
+{
+	auto &options = rendition->options;
+	int input_width = in_state->input_codec_ctx->width;
+	int input_height = in_state->input_codec_ctx->height;
+
+	int width = options.width;
+	int height = options.height;
+	scaled_size(input_width, input_height, &width, &height);
+
+	rendition->output_filename = options.output_filename.empty() ?
+		rendition_filename(main_filename, height) : options.output_filename;
+	rendition->settings = {
+		options.encoder_name.empty() ? opts->encoder_name : options.encoder_name.c_str(),
+		width, height,
+		options.crf.empty() ? NULL : options.crf.c_str(),
+		options.preset.empty() ? NULL : options.preset.c_str(),
+		opts->codec_threads
+	};
+	rendition->converter.threads = opts->codec_threads;
+
+	OutputUtils *out_state = &rendition->out_state;
+	const char *filename = rendition->output_filename.c_str();
+	if (setup_output_stream(out_state, filename) != 0)
+		return 1;
+	setup_muxer_options(out_state, opts);
+	if (setup_encoder(in_state, out_state, &rendition->settings) != 0)
+		return 1;
+	if (segmenter_enabled(opts)) {
+		if (segmenter_init(out_state, filename, opts) != 0)
+			return 1;
+		filename = out_state->segmenter->filename.c_str();
+	}
+	if (open_output_stream(out_state, filename) != 0)
+		return 1;
+
+	rendition->pipeline.reset(new Pipeline(in_state, out_state, opts));
+	rendition->pipeline->inline_stages = true;
+
+	log_message(LOG_LEVEL_INFO, "Rendition %dx%d %s to %s\n", width, height,
+		rendition->settings.encoder_name, rendition->output_filename.c_str());
+	return 0;
+}
+
+int rendition_scale(Rendition *rendition, const AVFrame *frame, AVFrame **scaled)
+{
+	AVCodecContext *codec_ctx = rendition->out_state.output_codec_ctx;
+	FramePool &frame_pool = rendition->pipeline->frame_pool;
+	AVFrame *output = frame_pool.get();
+	char errorBuff[80];
+	int ret;
+
+	// Same picture as the encoder wants, another reference is enough
+	if (!frame_converter_needed(frame, codec_ctx)) {
+		ret = av_frame_ref(output, frame);
+		if (ret < 0) {
+			frame_pool.put(output);
+			return ret;
+		}
+		frame_converter_pass(&rendition->converter, codec_ctx);
+		*scaled = output;
+		return 0;
+	}
+
+	ret = frame_convert(&rendition->converter, codec_ctx, frame, output);
+	if (ret < 0) {
+		log_message(LOG_LEVEL_ERROR, "Could not scale frame for %s: %s\n", rendition->output_filename.c_str(), av_make_error_string(errorBuff, 80, ret));
+		frame_pool.put(output);
+		return ret;
+	}
+	*scaled = output;
+	return 0;
+}
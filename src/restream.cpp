@@ -0,0 +1,325 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ *
+ * @Brief   : Output stream served again as MPEG-TS over TCP to any number of local clients
+ *
+ * @Created : 17-Oct-2026
+ *
+ * @Updated : 17-Oct-2026
+ *
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#include "../include/restream.hpp"
+#include "../include/logger.hpp"
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// The AVIO write callback lost its non-const buffer in libavformat 61
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+typedef const uint8_t avio_write_buffer;
+#else
+typedef uint8_t avio_write_buffer;
+#endif
+
+static const int accept_poll_ms = 200;          // how soon the acceptor notices the end
+static const int avio_buffer_size = 32 * 1024;
+static const auto linger_time = std::chrono::seconds(1);   // to write the queued packets at the end
+
+RestreamClient::RestreamClient(int file, const std::string &address, size_t queue_depth)
+	: fd(file), peer(address), queue(queue_depth), keyframe_wait(true),
+	  closing(false), finished(false), sent(0), dropped(0)
+{
+}
+
+RestreamClient::~RestreamClient()
+{
+	AVPacket *packet;
+	while (queue.try_pop(packet))
+		av_packet_free(&packet);
+	close(fd);
+}
+
+Restreamer::Restreamer(const TranscodeOptions *opts)
+	: address("127.0.0.1"), port(opts->restream), queue_depth(opts->restream_queue), drop(opts->restream_drop),
+	  params(NULL), time_base({0, 1}), listen_fd(-1), stopping(false),
+	  joined(0), left_sent(0), left_dropped(0), too_slow(0), packets(0)
+{
+	size_t colon = port.rfind(':');
+	if (colon != std::string::npos) {
+		address = port.substr(0, colon);
+		port = port.substr(colon + 1);
+	}
+}
+
+// Blocking sends, a client that stops reading only holds up its own thread
+static int client_write(void *opaque, avio_write_buffer *buffer, int buffer_size)
+{
+	RestreamClient *client = (RestreamClient *)opaque;
+	int written = 0;
+
+	while (written < buffer_size) {
+		ssize_t ret = send(client->fd, buffer + written, buffer_size - written, MSG_NOSIGNAL);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return ret < 0 ? AVERROR(errno) : AVERROR(EPIPE);
+		written += ret;
+	}
+	return written;
+}
+
+static int client_open(const Restreamer *restreamer, RestreamClient *client, AVFormatContext **fmt_ctx)
+{
+	AVFormatContext *ctx = NULL;
+	int ret = avformat_alloc_output_context2(&ctx, NULL, "mpegts", NULL);
+	if (ret < 0)
+		return ret;
+	*fmt_ctx = ctx;
+
+	AVStream *stream = avformat_new_stream(ctx, NULL);
+	if (!stream)
+		return AVERROR(ENOMEM);
+	ret = avcodec_parameters_copy(stream->codecpar, restreamer->params);
+	if (ret < 0)
+		return ret;
+	stream->codecpar->codec_tag = 0;   // the tag of the file container means nothing to MPEG-TS
+	stream->time_base = restreamer->time_base;
+
+	uint8_t *buffer = (uint8_t *)av_malloc(avio_buffer_size);
+	ctx->pb = buffer ? avio_alloc_context(buffer, avio_buffer_size, 1, client, NULL, client_write, NULL) : NULL;
+	if (!ctx->pb) {
+		av_free(buffer);
+		return AVERROR(ENOMEM);
+	}
+	// Every packet goes out right away instead of once 32 KB are buffered
+	ctx->flags |= AVFMT_FLAG_FLUSH_PACKETS;
+	return avformat_write_header(ctx, NULL);
+}
+
+static void client_close(AVFormatContext *ctx)
+{
+	if (!ctx)
+		return;
+	if (ctx->pb) {
+		av_freep(&ctx->pb->buffer);
+		avio_context_free(&ctx->pb);
+	}
+	avformat_free_context(ctx);
+}
+
+static void client_thread(const Restreamer *restreamer, RestreamClient *client)
+{
+	AVFormatContext *ctx = NULL;
+	AVPacket *packet;
+	char errorBuff[80];
+
+	int ret = client_open(restreamer, client, &ctx);
+	if (ret < 0)
+		log_message(LOG_LEVEL_ERROR, "Could not start restreaming to %s: %s\n", client->peer.c_str(), av_make_error_string(errorBuff, 80, ret));
+
+	// The queue starts at a keyframe, so the client can decode from the first packet on
+	while (ret >= 0 && client->queue.pop(packet, client->closing)) {
+		packet->stream_index = 0;
+		av_packet_rescale_ts(packet, restreamer->time_base, ctx->streams[0]->time_base);
+		ret = av_write_frame(ctx, packet);
+		av_packet_free(&packet);
+		if (ret >= 0)
+			client->sent++;
+	}
+	if (ret >= 0 && !client->closing)
+		av_write_trailer(ctx);
+	client_close(ctx);
+
+	if (ret < 0 && ret != AVERROR(EPIPE) && ret != AVERROR(ECONNRESET) && !client->closing)
+		log_message(LOG_LEVEL_WARNING, "Restreaming to %s failed: %s\n", client->peer.c_str(), av_make_error_string(errorBuff, 80, ret));
+	log_message(LOG_LEVEL_INFO, "Restream client %s left after %llu packets\n", client->peer.c_str(), (unsigned long long)client->sent.load());
+	client->finished = true;
+}
+
+// Joins the threads of the clients that left, under the lock
+static void reap_clients(Restreamer *restreamer)
+{
+	auto &clients = restreamer->clients;
+	for (auto it = clients.begin(); it != clients.end();) {
+		RestreamClient *client = it->get();
+		if (!client->finished) {
+			++it;
+			continue;
+		}
+		client->thread.join();
+		restreamer->left_sent += client->sent;
+		restreamer->left_dropped += client->dropped;
+		it = clients.erase(it);
+	}
+}
+
+static void accept_client(Restreamer *restreamer)
+{
+	struct sockaddr_storage addr;
+	socklen_t addr_len = sizeof(addr);
+	int fd = accept4(restreamer->listen_fd, (struct sockaddr *)&addr, &addr_len, SOCK_CLOEXEC);
+	if (fd < 0)
+		return;
+
+	// Small video packets should not wait for more data to fill a segment
+	int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	char host[NI_MAXHOST] = "?", service[NI_MAXSERV] = "?";
+	getnameinfo((struct sockaddr *)&addr, addr_len, host, sizeof(host), service, sizeof(service), NI_NUMERICHOST | NI_NUMERICSERV);
+
+	RestreamClient *client = new RestreamClient(fd, std::string(host) + ":" + service, restreamer->queue_depth);
+	client->thread = std::thread(client_thread, restreamer, client);
+	std::lock_guard<std::mutex> guard(restreamer->lock);
+	restreamer->clients.emplace_back(client);
+	restreamer->joined++;
+	log_message(LOG_LEVEL_INFO, "Restream client %s joined, it starts at the next keyframe\n", client->peer.c_str());
+}
+
+static void accept_loop(Restreamer *restreamer)
+{
+	while (!restreamer->stopping) {
+		struct pollfd listener = {restreamer->listen_fd, POLLIN, 0};
+		int ready = poll(&listener, 1, accept_poll_ms);
+		{
+			std::lock_guard<std::mutex> guard(restreamer->lock);
+			reap_clients(restreamer);
+		}
+		if (ready > 0)
+			accept_client(restreamer);
+	}
+}
+
+static int listen_socket(const Restreamer *restreamer)
+{
+	struct addrinfo hints = {}, *addresses = NULL;
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	int ret = getaddrinfo(restreamer->address.c_str(), restreamer->port.c_str(), &hints, &addresses);
+	if (ret != 0) {
+		log_message(LOG_LEVEL_ERROR, "Restream address %s: %s\n", restreamer->address.c_str(), gai_strerror(ret));
+		return -1;
+	}
+
+	int fd = -1;
+	for (struct addrinfo *address = addresses; address && fd < 0; address = address->ai_next) {
+		fd = socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+		if (fd < 0)
+			continue;
+		// A restart must not wait for the connections of the last run to time out
+		int one = 1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if (bind(fd, address->ai_addr, address->ai_addrlen) != 0 || listen(fd, SOMAXCONN) != 0) {
+			log_message(LOG_LEVEL_ERROR, "Could not listen on %s:%s: %s\n", restreamer->address.c_str(), restreamer->port.c_str(), strerror(errno));
+			close(fd);
+			fd = -1;
+		}
+	}
+	freeaddrinfo(addresses);
+	return fd;
+}
+
+int restream_open(Restreamer *restreamer, const OutputUtils *out_state)
+{
+	restreamer->params = avcodec_parameters_alloc();
+	if (!restreamer->params || avcodec_parameters_copy(restreamer->params, out_state->output_stream->codecpar) < 0)
+		return 1;
+	restreamer->time_base = out_state->packet_time_base;
+
+	restreamer->listen_fd = listen_socket(restreamer);
+	if (restreamer->listen_fd < 0)
+		return 1;
+	restreamer->acceptor = std::thread(accept_loop, restreamer);
+	log_message(LOG_LEVEL_INFO, "Restreaming on tcp://%s:%s\n", restreamer->address.c_str(), restreamer->port.c_str());
+	return 0;
+}
+
+// Wakes a client thread blocked in send() and ends it
+static void disconnect(RestreamClient *client)
+{
+	client->closing = true;
+	shutdown(client->fd, SHUT_RDWR);
+}
+
+void restream_packet(Restreamer *restreamer, const AVPacket *packet)
+{
+	bool keyframe = packet->flags & AV_PKT_FLAG_KEY;
+	restreamer->packets++;
+
+	std::lock_guard<std::mutex> guard(restreamer->lock);
+	for (auto &entry : restreamer->clients) {
+		RestreamClient *client = entry.get();
+		if (client->closing || client->finished)
+			continue;
+		if (client->keyframe_wait && !keyframe)
+			continue;
+
+		// A reference, the data itself is shared with the output and every other client
+		AVPacket *reference = av_packet_clone(packet);
+		if (reference && client->queue.try_push(reference)) {
+			client->keyframe_wait = false;
+			continue;
+		}
+		av_packet_free(&reference);
+
+		client->dropped++;
+		if (restreamer->drop == RESTREAM_DROP_CLOSE) {
+			log_message(LOG_LEVEL_WARNING, "Restream client %s is %zu packets behind, disconnected\n", client->peer.c_str(), client->queue.capacity());
+			restreamer->too_slow++;
+			disconnect(client);
+		}
+		else {
+			// The packets up to the next keyframe are of no use without this one
+			if (!client->keyframe_wait)
+				log_message(LOG_LEVEL_DEBUG, "Restream client %s is behind, skipping to the next keyframe\n", client->peer.c_str());
+			client->keyframe_wait = true;
+		}
+	}
+}
+
+void restream_report(Restreamer *restreamer)
+{
+	std::lock_guard<std::mutex> guard(restreamer->lock);
+	uint64_t sent = restreamer->left_sent, dropped = restreamer->left_dropped;
+	for (auto &client : restreamer->clients) {
+		sent += client->sent;
+		dropped += client->dropped;
+	}
+	log_message(LOG_LEVEL_INFO, "Restream %s:%s: %zu clients, %llu joined, %llu packets, %llu sent, %llu dropped, %llu disconnected as too slow\n",
+		restreamer->address.c_str(), restreamer->port.c_str(), restreamer->clients.size(),
+		(unsigned long long)restreamer->joined, (unsigned long long)restreamer->packets.load(),
+		(unsigned long long)sent, (unsigned long long)dropped, (unsigned long long)restreamer->too_slow);
+}
+
+Restreamer::~Restreamer()
+{
+	stopping = true;
+	if (acceptor.joinable())
+		acceptor.join();
+	if (listen_fd >= 0)
+		close(listen_fd);
+
+	// No more packets come, the clients write what they have and the trailer.
+	// Whoever is still busy after the linger time is disconnected.
+	for (auto &client : clients)
+		client->queue.close();
+	auto deadline = std::chrono::steady_clock::now() + linger_time;
+	for (auto &client : clients) {
+		while (!client->finished && std::chrono::steady_clock::now() < deadline)
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		if (!client->finished)
+			disconnect(client.get());
+	}
+	for (auto &client : clients)
+		client->thread.join();
+	clients.clear();
+	avcodec_parameters_free(&params);
+}
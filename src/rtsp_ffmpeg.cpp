@@ -0,0 +1,98 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ *
+ * @Brief   : Library interface, one camera transcoded inside another application
+ *
+ * @Created : 17-Oct-2026
+ *
+ * @Updated : 17-Oct-2026
+ *
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#include "../include/rtsp_ffmpeg.hpp"
+#include "../include/pipeline.hpp"
+#include "../include/logger.hpp"
+#include "../include/rendition.hpp"
+
+
+RtspSession::RtspSession(const std::string &input, const std::string &output, const TranscodeOptions &options)
+	: input_filename(input), output_filename(output), opts(options),
+	  in_state(), out_state(), params(NULL),
+	  stop_request(false), active(false), started(false), closed(false), result(0)
+{
+	in_state.stop_request = &stop_request;
+}
+
+RtspSession::~RtspSession()
+{
+	stop();
+	wait();
+	avcodec_parameters_free(&params);
+}
+
+void RtspSession::set_packet_callback(PacketCallback callback)
+{
+	packet_callback = std::move(callback);
+}
+
+void RtspSession::set_frame_callback(FrameCallback callback)
+{
+	frame_callback = std::move(callback);
+}
+
+int RtspSession::start()
+{
+	if (started)
+		return AVERROR(EINVAL);
+	started = true;
+
+	if (setup_streams(&in_state, &out_state, &opts, input_filename.c_str(), output_filename.c_str()) != 0) {
+		free_streams(&in_state, &out_state);
+		closed = true;
+		return result = EXIT_FAILURE;
+	}
+	in_state.input_frame = av_frame_alloc();
+	in_state.input_packet = av_packet_alloc();
+	params = avcodec_parameters_alloc();
+	avcodec_parameters_copy(params, out_state.output_stream->codecpar);
+
+	pipeline.reset(new Pipeline(&in_state, &out_state, &opts));
+	pipeline->packet_sink = packet_callback;
+	pipeline->frame_sink = frame_callback;
+	if (frame_callback && opts.stream_copy)
+		log_message(LOG_LEVEL_WARNING, "%s is stream copied, the frame callback is never called (use COPY_NEVER)\n", input_filename.c_str());
+	if (pipeline_setup(pipeline.get()) != 0) {
+		pipeline->renditions.clear();
+		close_streams(&in_state, &out_state);
+		pipeline.reset();
+		closed = true;
+		return result = EXIT_FAILURE;
+	}
+
+	active = true;
+	runner = std::thread([this] {
+		result = pipeline_run(pipeline.get());
+		active = false;
+	});
+	return 0;
+}
+
+void RtspSession::stop()
+{
+	stop_request = true;
+}
+
+int RtspSession::wait()
+{
+	if (runner.joinable())
+		runner.join();
+	if (!closed && pipeline) {
+		if (opts.stats_interval > 0)
+			pipeline_report(pipeline.get(), false);
+		pipeline.reset();
+		close_streams(&in_state, &out_state);
+		closed = true;
+	}
+	return result;
+}
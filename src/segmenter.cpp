@@ -0,0 +1,234 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : GOP aligned segmented recording with rolling files and a manifest
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#include "../include/segmenter.hpp"
+#include "../include/logger.hpp"
+#include <cmath>
+#include <cstdio>
+#include <unistd.h>
+
+
+bool segmenter_enabled(const TranscodeOptions *opts)
+{
+	return opts->segment_time > 0 || opts->segment_size > 0;
+}
+
+// "cam.mp4" becomes "cam_%05d.mp4", a name that already has a %d is kept.
+// Returns an empty string for patterns that are not a single %d conversion.
+static std::string segment_pattern(const std::string &filename)
+{
+	size_t percent = filename.find('%');
+	if (percent == std::string::npos) {
+		size_t dot = filename.rfind('.');
+		size_t slash = filename.rfind('/');
+		if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+			return filename + "_%05d";
+		return filename.substr(0, dot) + "_%05d" + filename.substr(dot);
+	}
+
+	size_t conversion = filename.find_first_not_of("0123456789", percent + 1);
+	if (conversion == std::string::npos || filename[conversion] != 'd' ||
+			filename.find('%', conversion) != std::string::npos)
+		return "";
+	return filename;
+}
+
+// "cam_%05d.ts" -> "cam.m3u8", "cam_%05d.mp4" -> "cam.ffconcat"
+static std::string manifest_name(const std::string &pattern, bool hls)
+{
+	std::string name = pattern;
+	size_t dot = name.rfind('.');
+	size_t slash = name.rfind('/');
+	if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+		name.erase(dot);
+
+	size_t percent = name.find('%');
+	name.erase(percent, name.find('d', percent) - percent + 1);
+	while (!name.empty() && (name.back() == '_' || name.back() == '-'))
+		name.pop_back();
+	return name + (hls ? ".m3u8" : ".ffconcat");
+}
+
+static std::string segment_filename(const Segmenter *segmenter, int index)
+{
+	char filename[1024];
+	snprintf(filename, sizeof(filename), segmenter->pattern.c_str(), index);
+	return filename;
+}
+
+static std::string base_name(const std::string &path)
+{
+	size_t slash = path.rfind('/');
+	return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+// Rewritten after every segment, the rename keeps readers from seeing half a file
+static void write_manifest(const Segmenter *segmenter, bool finished)
+{
+	std::string temp_filename = segmenter->manifest_filename + ".tmp";
+	FILE *manifest = fopen(temp_filename.c_str(), "w");
+	if (!manifest) {
+		log_message(LOG_LEVEL_WARNING, "Could not write segment manifest %s\n", segmenter->manifest_filename.c_str());
+		return;
+	}
+
+	if (segmenter->hls) {
+		double target = segmenter->segment_time;
+		for (auto &segment : segmenter->segments)
+			target = std::max(target, segment.duration);
+
+		fprintf(manifest, "#EXTM3U\n#EXT-X-VERSION:3\n#EXT-X-TARGETDURATION:%d\n", (int)std::ceil(target));
+		fprintf(manifest, "#EXT-X-MEDIA-SEQUENCE:%d\n", segmenter->segments.empty() ? 0 : segmenter->segments.front().index);
+		for (auto &segment : segmenter->segments)
+			fprintf(manifest, "#EXTINF:%.3f,\n%s\n", segment.duration, base_name(segment.filename).c_str());
+		if (finished)
+			fprintf(manifest, "#EXT-X-ENDLIST\n");
+	}
+	else {
+		// HLS takes MPEG-TS or fragmented MP4 with an init segment, other
+		// containers get a list the concat demuxer plays back in one go
+		fprintf(manifest, "ffconcat version 1.0\n");
+		for (auto &segment : segmenter->segments)
+			fprintf(manifest, "file '%s'\nduration %.3f\n", base_name(segment.filename).c_str(), segment.duration);
+	}
+	fclose(manifest);
+
+	rename(temp_filename.c_str(), segmenter->manifest_filename.c_str());
+}
+
+// Books the segment that was just closed and expires the oldest one
+static void segment_done(Segmenter *segmenter, int64_t end_pts, AVRational time_base, bool finished)
+{
+	double duration = 0;
+	if (segmenter->start_pts != AV_NOPTS_VALUE && end_pts != AV_NOPTS_VALUE)
+		duration = (end_pts - segmenter->start_pts) * av_q2d(time_base);
+
+	segmenter->segments.push_back({segmenter->index, segmenter->filename, duration});
+	while (segmenter->wrap > 0 && (int)segmenter->segments.size() > segmenter->wrap) {
+		unlink(segmenter->segments.front().filename.c_str());
+		segmenter->segments.pop_front();
+	}
+	write_manifest(segmenter, finished);
+}
+
+int segmenter_init(OutputUtils *out_state, const char *output_filename, const TranscodeOptions *opts)
+{
+	// Linking variables
+	auto &output_fmt_ctx = out_state->output_fmt_ctx;
+
+	std::string pattern = segment_pattern(output_filename);
+	if (pattern.empty()) {
+		log_message(LOG_LEVEL_ERROR, "Segment file name %s may only contain a single %%d.\n", output_filename);
+		return 1;
+	}
+
+	Segmenter *segmenter = new Segmenter();
+	segmenter->pattern = pattern;
+	segmenter->format_name = output_fmt_ctx->oformat->name;
+	segmenter->hls = segmenter->format_name == "mpegts";
+	segmenter->manifest_filename = manifest_name(pattern, segmenter->hls);
+	segmenter->segment_time = opts->segment_time;
+	segmenter->segment_size = opts->segment_size;
+	segmenter->wrap = opts->segment_wrap;
+	segmenter->index = 0;
+	segmenter->filename = segment_filename(segmenter, 0);
+	segmenter->start_pts = AV_NOPTS_VALUE;
+	segmenter->end_pts = AV_NOPTS_VALUE;
+	for (unsigned i = 0; i < output_fmt_ctx->nb_streams; ++i)
+		segmenter->time_bases.push_back(output_fmt_ctx->streams[i]->time_base);
+
+	out_state->segmenter = segmenter;
+	return 0;
+}
+
+// Closes the current file and opens the next one with the same streams
+static int segmenter_rotate(OutputUtils *out_state, int64_t pts)
+{
+	// Linking variables
+	auto &output_fmt_ctx = out_state->output_fmt_ctx;
+	auto &output_stream = out_state->output_stream;
+	Segmenter *segmenter = out_state->segmenter;
+	AVFormatContext *next_fmt_ctx = NULL;
+	char errorBuff[80];
+
+	int ret = av_write_trailer(output_fmt_ctx);
+	if (ret < 0)
+		log_message(LOG_LEVEL_ERROR, "Error writing trailer of %s: %s\n", segmenter->filename.c_str(), av_make_error_string(errorBuff, 80, ret));
+	close_output_file(out_state);
+	// Until the next file has its header, close_output_stream() has nothing left to finish
+	out_state->trailer_written = true;
+	segment_done(segmenter, pts, out_state->packet_time_base, false);
+
+	segmenter->index++;
+	segmenter->start_pts = pts;
+	segmenter->filename = segment_filename(segmenter, segmenter->index);
+
+	avformat_alloc_output_context2(&next_fmt_ctx, NULL, segmenter->format_name.c_str(), segmenter->filename.c_str());
+	if (!next_fmt_ctx)
+		return AVERROR(ENOMEM);
+	for (unsigned i = 0; i < output_fmt_ctx->nb_streams; ++i) {
+		AVStream *stream = avformat_new_stream(next_fmt_ctx, NULL);
+		ret = stream ? avcodec_parameters_copy(stream->codecpar, output_fmt_ctx->streams[i]->codecpar) : AVERROR(ENOMEM);
+		if (ret < 0) {
+			avformat_free_context(next_fmt_ctx);
+			return ret;
+		}
+		stream->codecpar->codec_tag = 0;
+		stream->time_base = segmenter->time_bases[i];
+	}
+	avformat_free_context(output_fmt_ctx);
+	output_fmt_ctx = next_fmt_ctx;
+	output_stream = next_fmt_ctx->streams[0];
+
+	if (open_output_stream(out_state, segmenter->filename.c_str()) != 0)
+		return AVERROR(EIO);
+	out_state->trailer_written = false;
+	log_message(LOG_LEVEL_INFO, "Started segment %s\n", segmenter->filename.c_str());
+	return 0;
+}
+
+int segmenter_check(OutputUtils *out_state, AVPacket *packet)
+{
+	Segmenter *segmenter = out_state->segmenter;
+
+	if (packet->pts == AV_NOPTS_VALUE)
+		return 0;
+	if (segmenter->end_pts == AV_NOPTS_VALUE || packet->pts + packet->duration > segmenter->end_pts)
+		segmenter->end_pts = packet->pts + packet->duration;
+
+	if (!(packet->flags & AV_PKT_FLAG_KEY))
+		return 0;
+	if (segmenter->start_pts == AV_NOPTS_VALUE) {
+		segmenter->start_pts = packet->pts;
+		return 0;
+	}
+
+	double elapsed = (packet->pts - segmenter->start_pts) * av_q2d(out_state->packet_time_base);
+	int64_t size = out_state->output_fmt_ctx->pb ? avio_tell(out_state->output_fmt_ctx->pb) : 0;
+	if ((segmenter->segment_time > 0 && elapsed >= segmenter->segment_time) ||
+			(segmenter->segment_size > 0 && size >= segmenter->segment_size))
+		return segmenter_rotate(out_state, packet->pts);
+	return 0;
+}
+
+// Called once the last segment was closed
+void segmenter_finish(OutputUtils *out_state)
+{
+	Segmenter *segmenter = out_state->segmenter;
+	if (!segmenter)
+		return;
+
+	segment_done(segmenter, segmenter->end_pts, out_state->packet_time_base, true);
+	log_message(LOG_LEVEL_INFO, "\nWrote %d segments, manifest %s\n", segmenter->index + 1, segmenter->manifest_filename.c_str());
+	delete segmenter;
+	out_state->segmenter = NULL;
+}
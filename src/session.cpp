@@ -0,0 +1,191 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Several camera sessions in one process on a shared worker pool
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#include "../include/session.hpp"
+#include "../include/worker_pool.hpp"
+#include "../include/logger.hpp"
+#include "../include/rendition.hpp"
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+// Packets a task handles before giving the worker to the next session
+static const int process_budget = 32;
+
+
+int load_sessions(const char *list_filename, const TranscodeOptions *opts,
+		std::vector<std::unique_ptr<Session>> &sessions)
+{
+	std::ifstream list(list_filename);
+	if (!list) {
+		log_message(LOG_LEVEL_ERROR, "Couldn't open the session list %s\n", list_filename);
+		return 1;
+	}
+
+	// One "<input_filename> <output_filename>" pair per line, # starts a comment
+	std::string line;
+	int line_number = 0;
+	while (std::getline(list, line)) {
+		line_number++;
+		line = line.substr(0, line.find('#'));
+
+		std::istringstream fields(line);
+		std::string input_filename, output_filename, extra;
+		if (!(fields >> input_filename))
+			continue;
+		if (!(fields >> output_filename) || (fields >> extra)) {
+			log_message(LOG_LEVEL_ERROR, "%s:%d: expected <input_filename> <output_filename>\n", list_filename, line_number);
+			return 1;
+		}
+
+		std::unique_ptr<Session> session(new Session());
+		session->id = sessions.size();
+		session->input_filename = input_filename;
+		session->output_filename = output_filename;
+		session->in_state = {};
+		session->out_state = {};
+		session->opts = *opts;
+		session->scheduled = false;
+		session->pending = 2;
+		session->started = false;
+		session->finished = false;
+		session->closing = false;
+		session->result = 0;
+		sessions.push_back(std::move(session));
+	}
+	if (sessions.empty()) {
+		log_message(LOG_LEVEL_ERROR, "No sessions found in %s\n", list_filename);
+		return 1;
+	}
+	return 0;
+}
+
+static void finish_session(Session *session)
+{
+	Pipeline *pipeline = session->pipeline.get();
+	// The monitor thread reports no more once it sees closing
+	std::lock_guard<std::mutex> guard(session->report_lock);
+	session->closing = true;
+
+	session->result = pipeline->result;
+	log_message(LOG_LEVEL_INFO, "\nSession %d (%s) finished.\n", session->id, session->input_filename.c_str());
+	pipeline_report(pipeline, false);
+	close_streams(&session->in_state, &session->out_state);
+	print_output_size(session->output_filename.c_str());
+	session->finished = true;
+}
+
+static void schedule_session(WorkerPool *pool, Session *session);
+
+static void process_session(WorkerPool *pool, Session *session)
+{
+	if (pipeline_process(session->pipeline.get(), process_budget)) {
+		// scheduled stays set, nothing may run this session again
+		if (--session->pending == 0)
+			finish_session(session);
+		return;
+	}
+
+	// Go to the back of the queue if input is still waiting
+	session->scheduled = false;
+	auto &queue = session->pipeline->packet_queue;
+	if (queue.size() > 0 || queue.closed())
+		schedule_session(pool, session);
+}
+
+static void schedule_session(WorkerPool *pool, Session *session)
+{
+	if (session->scheduled.exchange(true))
+		return;
+	pool->submit([pool, session] { process_session(pool, session); });
+}
+
+static void session_io(Session *session)
+{
+	if (setup_streams(&session->in_state, &session->out_state, &session->opts,
+			session->input_filename.c_str(), session->output_filename.c_str()) != 0) {
+		log_message(LOG_LEVEL_ERROR, "Session %d (%s) could not be started.\n", session->id, session->input_filename.c_str());
+		free_streams(&session->in_state, &session->out_state);
+		session->result = EXIT_FAILURE;
+		session->finished = true;
+		return;
+	}
+	session->in_state.input_frame = av_frame_alloc();
+	session->in_state.input_packet = av_packet_alloc();
+	if (pipeline_setup(session->pipeline.get()) != 0) {
+		log_message(LOG_LEVEL_ERROR, "Session %d (%s) could not be started.\n", session->id, session->input_filename.c_str());
+		session->pipeline->renditions.clear();
+		close_streams(&session->in_state, &session->out_state);
+		session->result = EXIT_FAILURE;
+		session->finished = true;
+		return;
+	}
+	session->started = true;
+
+	pipeline_demux(session->pipeline.get());
+	if (--session->pending == 0)
+		finish_session(session);
+}
+
+int run_sessions(std::vector<std::unique_ptr<Session>> &sessions, unsigned workers)
+{
+	WorkerPool pool(workers);
+	log_message(LOG_LEVEL_INFO, "\nRunning %zu sessions on %u worker threads.\n", sessions.size(), pool.size());
+
+	for (auto &session : sessions) {
+		Session *s = session.get();
+		s->pipeline.reset(new Pipeline(&s->in_state, &s->out_state, &s->opts));
+		s->pipeline->inline_stages = true;
+		s->pipeline->on_packet = [&pool, s] { schedule_session(&pool, s); };
+		s->io_thread = std::thread(session_io, s);
+	}
+
+	// Sample and report the input queues until every session has finished
+	const auto sample_period = std::chrono::milliseconds(100);
+	auto last_report = std::chrono::steady_clock::now();
+	int stats_interval = sessions.front()->opts.stats_interval;
+	size_t finished = 0;
+
+	while (finished < sessions.size()) {
+		std::this_thread::sleep_for(sample_period);
+		finished = 0;
+		for (auto &session : sessions) {
+			pipeline_sample(session->pipeline.get());
+			finished += session->finished;
+		}
+
+		auto now = std::chrono::steady_clock::now();
+		if (stats_interval > 0 && now - last_report >= std::chrono::seconds(stats_interval)) {
+			for (auto &session : sessions) {
+				if (!session->started)
+					continue;
+				std::lock_guard<std::mutex> guard(session->report_lock);
+				if (session->closing)
+					continue;
+				log_message(LOG_LEVEL_INFO, "\nSession %d (%s):", session->id, session->input_filename.c_str());
+				pipeline_report(session->pipeline.get(), true);
+			}
+			last_report = now;
+		}
+	}
+
+	for (auto &session : sessions)
+		session->io_thread.join();
+	pool.wait_idle();
+
+	int failed = 0;
+	for (auto &session : sessions)
+		failed += session->result != 0;
+	if (failed)
+		log_message(LOG_LEVEL_ERROR, "\n%d of %zu sessions failed.\n", failed, sessions.size());
+	return failed ? EXIT_FAILURE : 0;
+}
@@ -0,0 +1,314 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ *
+ * @Brief   : Decoded frames and encoded packets published to local processes through shared memory
+ *
+ * @Created : 17-Oct-2026
+ *
+ * @Updated : 17-Oct-2026
+ *
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#include "../include/shm_ring.hpp"
+#include "../include/logger.hpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <new>
+extern "C" {
+	#include <libavutil/imgutils.h>
+}
+
+// Slots start on a cache line after the header
+static const size_t header_bytes = (sizeof(ShmRingHeader) + 63) & ~(size_t)63;
+
+static const char *kind_suffix(ShmRingKind kind)
+{
+	return kind == SHM_RING_FRAMES ? "_frames" : "_packets";
+}
+
+static ShmSlot *ring_slot(const uint8_t *base, const ShmRingHeader *header, uint64_t sequence)
+{
+	return (ShmSlot *)(base + header_bytes + (sequence % header->slot_count) * header->slot_size);
+}
+
+// Maps a new ring, the caller fills the fields of its kind and calls ring_ready()
+static int ring_create(ShmRing *ring, const std::string &name, ShmRingKind kind, uint32_t slot_count, size_t data_size)
+{
+	size_t slot_size = (sizeof(ShmSlot) + data_size + 63) & ~(size_t)63;
+	std::string path = "/" + name;
+	char errorBuff[80];
+
+	// A ring left behind by a crashed run is replaced, its readers keep their old mapping
+	shm_unlink(path.c_str());
+	ring->fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (ring->fd < 0) {
+		int ret = AVERROR(errno);
+		log_message(LOG_LEVEL_ERROR, "Could not create shared memory %s: %s\n", path.c_str(), av_make_error_string(errorBuff, 80, ret));
+		return ret;
+	}
+	ring->name = name;
+	ring->size = header_bytes + slot_count * slot_size;
+	ring->written = 0;
+	if (ftruncate(ring->fd, ring->size) != 0 ||
+			(ring->base = (uint8_t *)mmap(NULL, ring->size, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, 0)) == MAP_FAILED) {
+		int ret = AVERROR(errno);
+		log_message(LOG_LEVEL_ERROR, "Could not map shared memory %s: %s\n", path.c_str(), av_make_error_string(errorBuff, 80, ret));
+		ring->base = NULL;
+		close(ring->fd);
+		shm_unlink(path.c_str());
+		return ret;
+	}
+
+	// ftruncate() zeroed the memory, every slot starts at sequence 0 (empty)
+	ring->header = new (ring->base) ShmRingHeader();
+	ring->header->version = shm_ring_version;
+	ring->header->kind = kind;
+	ring->header->slot_count = slot_count;
+	ring->header->slot_size = slot_size;
+	for (uint32_t i = 0; i < slot_count; ++i)
+		new (ring_slot(ring->base, ring->header, i)) ShmSlot();
+	return 0;
+}
+
+static void ring_ready(ShmRing *ring)
+{
+	std::atomic_thread_fence(std::memory_order_release);
+	ring->header->magic = shm_ring_magic;
+	log_message(LOG_LEVEL_INFO, "Publishing to shared memory /dev/shm/%s (%u slots of %.2f MB)\n",
+		ring->name.c_str(), ring->header->slot_count, ring->header->slot_size / 1e6);
+}
+
+// Readers keep their mapping after the unlink, they see closed set
+static void ring_destroy(ShmRing *ring)
+{
+	if (!ring->base)
+		return;
+	ring->header->closed.store(1, std::memory_order_release);
+	munmap(ring->base, ring->size);
+	close(ring->fd);
+	shm_unlink(("/" + ring->name).c_str());
+	ring->base = NULL;
+}
+
+// Marks the slot of the next item as being written, readers that are on it
+// see the odd sequence afterwards and drop what they read
+static ShmSlot *ring_begin(ShmRing *ring)
+{
+	ShmSlot *slot = ring_slot(ring->base, ring->header, ring->written);
+	slot->sequence.store(2 * ring->written + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	return slot;
+}
+
+static void ring_commit(ShmRing *ring, ShmSlot *slot)
+{
+	slot->sequence.store(2 * ring->written + 2, std::memory_order_release);
+	ring->written++;
+	ring->header->written.store(ring->written, std::memory_order_release);
+}
+
+ShmPublisher::ShmPublisher(const InputUtils *in, const TranscodeOptions *opts)
+	: name(opts->shm_name), slot_count(opts->shm_slots),
+	  publish_frames(opts->shm_frames && !opts->stream_copy), publish_packets(opts->shm_packets),
+	  frame_time_base(in->input_time_base), frame_ring_failed(false),
+	  frames(), packets(),
+	  frames_published(0), packets_published(0), dropped(0)
+{
+}
+
+ShmPublisher::~ShmPublisher()
+{
+	ring_destroy(&frames);
+	ring_destroy(&packets);
+}
+
+int shm_publisher_open(ShmPublisher *publisher, const OutputUtils *out_state)
+{
+	if (!publisher->publish_packets)
+		return 0;
+
+	ShmRing *ring = &publisher->packets;
+	int ret = ring_create(ring, publisher->name + kind_suffix(SHM_RING_PACKETS), SHM_RING_PACKETS,
+		publisher->slot_count, shm_packet_slot_size);
+	if (ret < 0)
+		return ret;
+
+	// Readers need the codec and its extradata to decode the packets
+	const AVCodecParameters *params = out_state->output_stream->codecpar;
+	ShmRingHeader *header = ring->header;
+	header->time_base_num = out_state->packet_time_base.num;
+	header->time_base_den = out_state->packet_time_base.den;
+	header->codec_id = params->codec_id;
+	header->width = params->width;
+	header->height = params->height;
+	if (params->extradata_size > 0 && (size_t)params->extradata_size <= shm_extradata_max) {
+		memcpy(header->extradata, params->extradata, params->extradata_size);
+		header->extradata_size = params->extradata_size;
+	}
+	else if (params->extradata_size > 0)
+		log_message(LOG_LEVEL_WARNING, "Codec extradata of %d bytes does not fit the shared memory header, left out\n", params->extradata_size);
+	ring_ready(ring);
+	return 0;
+}
+
+void shm_publish_frame(ShmPublisher *publisher, const AVFrame *frame)
+{
+	if (!publisher->publish_frames || publisher->frame_ring_failed)
+		return;
+	ShmRing *ring = &publisher->frames;
+	enum AVPixelFormat format = (enum AVPixelFormat)frame->format;
+
+	// Sized for the first frame, the pixel format is only known once one is decoded
+	if (!ring->base) {
+		int size = av_image_get_buffer_size(format, frame->width, frame->height, 1);
+		if (size < 0 || ring_create(ring, publisher->name + kind_suffix(SHM_RING_FRAMES), SHM_RING_FRAMES,
+				publisher->slot_count, size) < 0) {
+			log_message(LOG_LEVEL_ERROR, "Decoded frames are not published to shared memory\n");
+			publisher->frame_ring_failed = true;
+			return;
+		}
+		ShmRingHeader *header = ring->header;
+		header->time_base_num = publisher->frame_time_base.num;
+		header->time_base_den = publisher->frame_time_base.den;
+		header->width = frame->width;
+		header->height = frame->height;
+		header->format = format;
+		ring_ready(ring);
+	}
+
+	// Readers rely on the geometry of the header, a changed stream is not published
+	const ShmRingHeader *header = ring->header;
+	if (frame->width != header->width || frame->height != header->height || frame->format != header->format) {
+		publisher->dropped++;
+		return;
+	}
+
+	ShmSlot *slot = ring_begin(ring);
+	uint8_t *base = (uint8_t *)(slot + 1);
+	uint8_t *data[4] = {NULL};
+	int linesize[4] = {0};
+	int size = av_image_fill_arrays(data, linesize, base, format, frame->width, frame->height, 1);
+	av_image_copy(data, linesize, (const uint8_t **)frame->data, frame->linesize, format, frame->width, frame->height);
+	for (int i = 0; i < 4; ++i) {
+		slot->linesize[i] = linesize[i];
+		slot->offset[i] = data[i] ? (uint32_t)(data[i] - base) : 0;
+	}
+	slot->size = size;
+	slot->flags = frame->pict_type == AV_PICTURE_TYPE_I ? AV_PKT_FLAG_KEY : 0;
+	slot->pts = frame->best_effort_timestamp != AV_NOPTS_VALUE ? frame->best_effort_timestamp : frame->pts;
+	slot->dts = AV_NOPTS_VALUE;
+	ring_commit(ring, slot);
+	publisher->frames_published++;
+}
+
+void shm_publish_packet(ShmPublisher *publisher, const AVPacket *packet)
+{
+	ShmRing *ring = &publisher->packets;
+	if (!ring->base)
+		return;
+	if ((size_t)packet->size > shm_packet_slot_size) {
+		publisher->dropped++;
+		return;
+	}
+
+	ShmSlot *slot = ring_begin(ring);
+	memcpy((uint8_t *)(slot + 1), packet->data, packet->size);
+	slot->size = packet->size;
+	slot->flags = packet->flags;
+	slot->pts = packet->pts;
+	slot->dts = packet->dts;
+	ring_commit(ring, slot);
+	publisher->packets_published++;
+}
+
+void shm_publisher_report(const ShmPublisher *publisher)
+{
+	log_message(LOG_LEVEL_INFO, "Shared memory %s: %llu frames, %llu packets published, %llu dropped\n",
+		publisher->name.c_str(), (unsigned long long)publisher->frames_published.load(),
+		(unsigned long long)publisher->packets_published.load(), (unsigned long long)publisher->dropped.load());
+}
+
+int shm_ring_open(ShmRingReader *reader, const char *name, ShmRingKind kind)
+{
+	std::string path = std::string("/") + name + kind_suffix(kind);
+	struct stat info;
+
+	*reader = {};
+	reader->fd = shm_open(path.c_str(), O_RDONLY, 0);
+	if (reader->fd < 0)
+		return AVERROR(errno);
+	if (fstat(reader->fd, &info) != 0 || (size_t)info.st_size < header_bytes) {
+		close(reader->fd);
+		return AVERROR_INVALIDDATA;
+	}
+	reader->size = info.st_size;
+	void *base = mmap(NULL, reader->size, PROT_READ, MAP_SHARED, reader->fd, 0);
+	if (base == MAP_FAILED) {
+		int ret = AVERROR(errno);
+		close(reader->fd);
+		return ret;
+	}
+	reader->base = (const uint8_t *)base;
+	reader->header = (const ShmRingHeader *)base;
+
+	// A ring still being set up does not carry the magic yet
+	const ShmRingHeader *header = reader->header;
+	bool valid = header->magic == shm_ring_magic && header->version == shm_ring_version && header->kind == (uint32_t)kind &&
+		header->slot_count > 0 && header_bytes + header->slot_count * header->slot_size <= reader->size;
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (!valid) {
+		shm_ring_close(reader);
+		return AVERROR(EAGAIN);
+	}
+
+	uint64_t written = header->written.load(std::memory_order_acquire);
+	reader->next = written ? written - 1 : 0;
+	return 0;
+}
+
+const ShmSlot *shm_ring_next(ShmRingReader *reader, uint64_t *sequence)
+{
+	const ShmRingHeader *header = reader->header;
+
+	for (;;) {
+		uint64_t written = header->written.load(std::memory_order_acquire);
+		if (reader->next >= written)
+			return NULL;
+
+		// More than a ring behind: the older items are gone, go on with the oldest kept
+		if (written - reader->next > header->slot_count) {
+			reader->skipped += written - header->slot_count - reader->next;
+			reader->next = written - header->slot_count;
+		}
+
+		const ShmSlot *slot = ring_slot(reader->base, header, reader->next);
+		if (slot->sequence.load(std::memory_order_acquire) == 2 * reader->next + 2) {
+			*sequence = reader->next++;
+			return slot;
+		}
+		// Overwritten since written was loaded, the publisher lapped this reader
+		reader->skipped++;
+		reader->next++;
+	}
+}
+
+bool shm_ring_valid(const ShmSlot *slot, uint64_t sequence)
+{
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return slot->sequence.load(std::memory_order_relaxed) == 2 * sequence + 2;
+}
+
+void shm_ring_close(ShmRingReader *reader)
+{
+	if (reader->base)
+		munmap((void *)reader->base, reader->size);
+	if (reader->fd >= 0)
+		close(reader->fd);
+	*reader = {};
+	reader->fd = -1;
+}
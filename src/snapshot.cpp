@@ -0,0 +1,277 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : JPEG/PNG thumbnails decoded from keyframes only
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#include "../include/snapshot.hpp"
+#include "../include/media_pool.hpp"
+#include "../include/logger.hpp"
+#include <cstdio>
+#include <cstring>
+
+Snapshotter::Snapshotter(const InputUtils *in, const TranscodeOptions *opts)
+	: in_state(), encoder_ctx(NULL), sws(NULL),
+	  frame(av_frame_alloc()), picture(av_frame_alloc()), packet(av_packet_alloc()),
+	  queue(1), busy(false), closing(false),
+	  codec_id(strcmp(opts->snapshot_format, "png") == 0 ? AV_CODEC_ID_PNG : AV_CODEC_ID_MJPEG),
+	  pattern(opts->snapshot_filename ? opts->snapshot_filename : ""),
+	  width(opts->snapshot_width), height(opts->snapshot_height),
+	  last_pts(AV_NOPTS_VALUE), index(0), written(0), failed(0), skipped(0)
+{
+	// Same stream as the recording, the decoder is opened by snapshot_open()
+	in_state.input_stream = in->input_stream;
+	in_state.input_codec_params = in->input_codec_params;
+	in_state.input_codec = in->input_codec;
+	in_state.input_framerate = in->input_framerate;
+	in_state.video_stream_idx = in->video_stream_idx;
+
+	interval = av_rescale_q((int64_t)(opts->snapshot_interval * AV_TIME_BASE), AV_TIME_BASE_Q, in->input_stream->time_base);
+}
+
+Snapshotter::~Snapshotter()
+{
+	// A snapshot in progress is finished, one still queued is not taken
+	closing = true;
+	queue.close();
+	if (thread.joinable())
+		thread.join();
+	AVPacket *queued;
+	while (queue.try_pop(queued))
+		av_packet_free(&queued);
+
+	avcodec_free_context(&in_state.input_codec_ctx);
+	frame_buffer_pool_free(&in_state.frame_buffer_pool);
+	avcodec_free_context(&encoder_ctx);
+	sws_freeContext(sws);
+	av_frame_free(&frame);
+	av_frame_free(&picture);
+	av_packet_free(&packet);
+}
+
+static void snapshot_take(Snapshotter *snapshotter, const AVPacket *packet);
+
+static void snapshot_thread(Snapshotter *snapshotter)
+{
+	AVPacket *packet;
+	while (snapshotter->queue.pop(packet, snapshotter->closing)) {
+		snapshot_take(snapshotter, packet);
+		av_packet_free(&packet);
+		snapshotter->busy = false;
+	}
+}
+
+int snapshot_open(Snapshotter *snapshotter, const char *main_filename)
+{
+	const char *extension = snapshotter->codec_id == AV_CODEC_ID_PNG ? ".png" : ".jpg";
+
+	// "cam.mp4" -> "cam_snapshot.jpg"
+	if (snapshotter->pattern.empty()) {
+		std::string filename = main_filename;
+		size_t dot = filename.rfind('.');
+		size_t slash = filename.rfind('/');
+		if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+			filename.erase(dot);
+		snapshotter->pattern = filename + "_snapshot" + extension;
+	}
+
+	// One thread: a snapshot is a single picture and must come out right away
+	if (setup_decoder(&snapshotter->in_state, 1, AVDISCARD_NONKEY) != 0)
+		return 1;
+
+	snapshotter->thread = std::thread(snapshot_thread, snapshotter);
+	log_message(LOG_LEVEL_INFO, "Snapshots every %.1f s to %s\n",
+		snapshotter->interval * av_q2d(snapshotter->in_state.input_stream->time_base), snapshotter->pattern.c_str());
+	return 0;
+}
+
+// Decodes a single keyframe. The decoder is drained if it holds the picture
+// back for reordering, then reset so the next keyframe starts clean.
+static int snapshot_decode(Snapshotter *snapshotter, const AVPacket *packet)
+{
+	AVCodecContext *decoder_ctx = snapshotter->in_state.input_codec_ctx;
+
+	int ret = avcodec_send_packet(decoder_ctx, packet);
+	if (ret >= 0) {
+		ret = avcodec_receive_frame(decoder_ctx, snapshotter->frame);
+		if (ret == AVERROR(EAGAIN)) {
+			avcodec_send_packet(decoder_ctx, NULL);
+			ret = avcodec_receive_frame(decoder_ctx, snapshotter->frame);
+		}
+	}
+	avcodec_flush_buffers(decoder_ctx);
+	return ret;
+}
+
+// Opened on the first picture and again only when the input size changes
+static int snapshot_encoder(Snapshotter *snapshotter)
+{
+	const AVFrame *frame = snapshotter->frame;
+	int width = snapshotter->width;
+	int height = snapshotter->height;
+	scaled_size(frame->width, frame->height, &width, &height);
+
+	if (snapshotter->encoder_ctx && snapshotter->encoder_ctx->width == width && snapshotter->encoder_ctx->height == height)
+		return 0;
+
+	avcodec_free_context(&snapshotter->encoder_ctx);
+	av_frame_unref(snapshotter->picture);
+
+	const AVCodec *codec = avcodec_find_encoder(snapshotter->codec_id);
+	if (!codec)
+		return AVERROR_ENCODER_NOT_FOUND;
+
+	AVCodecContext *encoder_ctx = avcodec_alloc_context3(codec);
+	if (!encoder_ctx)
+		return AVERROR(ENOMEM);
+	encoder_ctx->width = width;
+	encoder_ctx->height = height;
+	encoder_ctx->time_base = AVRational{1, 1};
+	encoder_ctx->thread_count = 1;
+	if (snapshotter->codec_id == AV_CODEC_ID_PNG)
+		encoder_ctx->pix_fmt = AV_PIX_FMT_RGB24;
+	else {
+		encoder_ctx->pix_fmt = AV_PIX_FMT_YUVJ420P;
+		// fixed quantizer, 2 is best and 31 worst
+		encoder_ctx->flags |= AV_CODEC_FLAG_QSCALE;
+		encoder_ctx->global_quality = FF_QP2LAMBDA * 3;
+	}
+	snapshotter->encoder_ctx = encoder_ctx;
+
+	int ret = avcodec_open2(encoder_ctx, codec, NULL);
+	if (ret < 0)
+		return ret;
+
+	AVFrame *picture = snapshotter->picture;
+	picture->width = width;
+	picture->height = height;
+	picture->format = encoder_ctx->pix_fmt;
+	return av_frame_get_buffer(picture, 0);
+}
+
+static std::string snapshot_filename(const Snapshotter *snapshotter)
+{
+	std::string filename = snapshotter->pattern;
+	size_t number = filename.find("%d");
+	if (number != std::string::npos)
+		filename.replace(number, 2, std::to_string(snapshotter->index));
+	return filename;
+}
+
+// The rename keeps readers from seeing half an image
+static int snapshot_write(Snapshotter *snapshotter)
+{
+	std::string filename = snapshot_filename(snapshotter);
+	std::string temp_filename = filename + ".tmp";
+
+	FILE *file = fopen(temp_filename.c_str(), "wb");
+	if (!file)
+		return AVERROR(errno);
+	size_t written = fwrite(snapshotter->packet->data, 1, snapshotter->packet->size, file);
+	if (fclose(file) != 0 || written != (size_t)snapshotter->packet->size) {
+		remove(temp_filename.c_str());
+		return AVERROR(EIO);
+	}
+	if (rename(temp_filename.c_str(), filename.c_str()) != 0)
+		return AVERROR(errno);
+	return 0;
+}
+
+static int snapshot_encode(Snapshotter *snapshotter)
+{
+	AVFrame *frame = snapshotter->frame;
+	AVFrame *picture = snapshotter->picture;
+
+	int ret = snapshot_encoder(snapshotter);
+	if (ret < 0)
+		return ret;
+
+	snapshotter->sws = sws_getCachedContext(snapshotter->sws, frame->width, frame->height, (AVPixelFormat)frame->format,
+		picture->width, picture->height, (AVPixelFormat)picture->format, SWS_BILINEAR, NULL, NULL, NULL);
+	if (!snapshotter->sws)
+		return AVERROR(EINVAL);
+
+	// The encoder may still hold the previous picture
+	ret = av_frame_make_writable(picture);
+	if (ret < 0)
+		return ret;
+	sws_scale(snapshotter->sws, frame->data, frame->linesize, 0, frame->height, picture->data, picture->linesize);
+	picture->pts = snapshotter->index;
+
+	ret = avcodec_send_frame(snapshotter->encoder_ctx, picture);
+	if (ret >= 0)
+		ret = avcodec_receive_packet(snapshotter->encoder_ctx, snapshotter->packet);
+	if (ret >= 0) {
+		ret = snapshot_write(snapshotter);
+		av_packet_unref(snapshotter->packet);
+	}
+	return ret;
+}
+
+void snapshot_packet(Snapshotter *snapshotter, const AVPacket *packet)
+{
+	if (!(packet->flags & AV_PKT_FLAG_KEY))
+		return;
+
+	// A timestamp going backwards is a new clock, take a snapshot right away
+	int64_t pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+	if (snapshotter->last_pts != AV_NOPTS_VALUE && pts != AV_NOPTS_VALUE &&
+			pts >= snapshotter->last_pts && pts - snapshotter->last_pts < snapshotter->interval)
+		return;
+	// Still due, the next keyframe gets another chance
+	if (snapshotter->busy) {
+		snapshotter->skipped++;
+		return;
+	}
+
+	// A reference, the demuxed packet goes on to the recording untouched
+	AVPacket *reference = av_packet_clone(packet);
+	if (!reference)
+		return;
+	snapshotter->busy = true;
+	if (!snapshotter->queue.try_push(reference)) {
+		snapshotter->busy = false;
+		av_packet_free(&reference);
+		return;
+	}
+	snapshotter->last_pts = pts;
+}
+
+// Snapshot thread: decode, scale, encode and write one keyframe
+static void snapshot_take(Snapshotter *snapshotter, const AVPacket *packet)
+{
+	char errorBuff[80];
+
+	uint64_t start = latency_now();
+	int ret = snapshot_decode(snapshotter, packet);
+	if (ret >= 0) {
+		ret = snapshot_encode(snapshotter);
+		av_frame_unref(snapshotter->frame);
+	}
+	snapshotter->latency.record_since(start);
+
+	if (ret < 0) {
+		snapshotter->failed++;
+		log_message(LOG_LEVEL_WARNING, "Snapshot failed: %s\n", av_make_error_string(errorBuff, 80, ret));
+		return;
+	}
+	snapshotter->written++;
+	snapshotter->index++;
+}
+
+void snapshot_report(const Snapshotter *snapshotter)
+{
+	LatencySnapshot snapshot;
+	snapshotter->latency.snapshot(&snapshot);
+
+	log_message(LOG_LEVEL_INFO, "Snapshots: %llu written, %llu failed, %llu skipped while busy, p50 %.2f ms, max %.2f ms\n",
+		(unsigned long long)snapshotter->written.load(), (unsigned long long)snapshotter->failed.load(),
+		(unsigned long long)snapshotter->skipped.load(),
+		snapshot.percentile(50) / 1e6, snapshot.max() / 1e6);
+}
@@ -0,0 +1,313 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ *
+ * @Brief   : Packets of the output written to further containers, without encoding them again
+ *
+ * @Created : 17-Oct-2026
+ *
+ * @Updated : 17-Oct-2026
+ *
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#include "../include/tee_output.hpp"
+#include "../include/logger.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The AVIO write callback lost its non-const buffer in libavformat 61
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+typedef const uint8_t avio_write_buffer;
+#else
+typedef uint8_t avio_write_buffer;
+#endif
+
+static const size_t tee_queue_depth = 512;     // packets, audio included
+static const auto linger_time = std::chrono::seconds(5);   // for the queued packets and the trailer at the end
+static const int pipe_poll_ms = 100;           // how soon a sink stuck on a pipe notices closing
+static const int avio_buffer_size = 32 * 1024;
+
+// "[f=mpegts]pipe:1", the format is optional
+TeeSink::TeeSink(const std::string &spec)
+	: url(spec), fmt_ctx(NULL), fd(-1), queue(tee_queue_depth), keyframe_wait(true),
+	  closing(false), failed(false), finished(false), queued(0), packets(0), bytes(0), dropped(0)
+{
+	size_t end = spec.find(']');
+	if (spec.compare(0, 3, "[f=") == 0 && end != std::string::npos) {
+		format = spec.substr(3, end - 3);
+		url = spec.substr(end + 1);
+	}
+}
+
+TeeSink::~TeeSink()
+{
+	AVPacket *packet;
+	while (queue.try_pop(packet))
+		av_packet_free(&packet);
+	if (fd >= 0) {
+		if (fmt_ctx && fmt_ctx->pb) {
+			av_freep(&fmt_ctx->pb->buffer);
+			avio_context_free(&fmt_ctx->pb);
+		}
+		close(fd);
+	}
+	else if (fmt_ctx && !(fmt_ctx->oformat->flags & AVFMT_NOFILE))
+		avio_closep(&fmt_ctx->pb);
+	avformat_free_context(fmt_ctx);
+}
+
+// Network protocols give up a blocked write once the sink is closing
+static int sink_interrupt(void *opaque)
+{
+	return ((TeeSink *)opaque)->closing;
+}
+
+// The file protocol blocks in open() on a FIFO without a reader and in
+// write() on a full pipe, the interrupt callback never gets a say. Pipes and
+// FIFOs are written through an AVIOContext of their own that polls instead.
+static bool sink_is_pipe(const TeeSink *sink, std::string *fifo)
+{
+	if (sink->url.compare(0, 5, "pipe:") == 0)
+		return true;
+	std::string path = sink->url.compare(0, 5, "file:") == 0 ? sink->url.substr(5) : sink->url;
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0 || !S_ISFIFO(st.st_mode))
+		return false;
+	*fifo = path;
+	return true;
+}
+
+// "pipe:1" is a copy of the descriptor, a FIFO is opened once it has a reader
+static int pipe_open(TeeSink *sink, const std::string &fifo)
+{
+	if (fifo.empty()) {
+		const char *number = sink->url.c_str() + 5;
+		int fd = fcntl(*number ? atoi(number) : STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+		return fd < 0 ? AVERROR(errno) : fd;
+	}
+	// With O_NONBLOCK, ENXIO says there is no reader yet instead of waiting for one
+	while (!sink->closing) {
+		int fd = open(fifo.c_str(), O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+		if (fd >= 0)
+			return fd;
+		if (errno != ENXIO && errno != EINTR)
+			return AVERROR(errno);
+		std::this_thread::sleep_for(std::chrono::milliseconds(pipe_poll_ms));
+	}
+	return AVERROR_EXIT;
+}
+
+static int pipe_write(void *opaque, avio_write_buffer *buffer, int buffer_size)
+{
+	TeeSink *sink = (TeeSink *)opaque;
+	int written = 0;
+
+	while (written < buffer_size) {
+		struct pollfd pfd = {sink->fd, POLLOUT, 0};
+		int ready = poll(&pfd, 1, pipe_poll_ms);
+		if (sink->closing)
+			return AVERROR_EXIT;
+		if (ready < 0 && errno != EINTR)
+			return AVERROR(errno);
+		if (ready <= 0)
+			continue;
+		// A pipe that polled writable takes PIPE_BUF bytes without blocking, blocking descriptor or not
+		ssize_t ret = write(sink->fd, buffer + written, std::min(buffer_size - written, PIPE_BUF));
+		if (ret < 0 && (errno == EINTR || errno == EAGAIN))
+			continue;
+		if (ret < 0)
+			return AVERROR(errno);
+		written += ret;
+	}
+	return written;
+}
+
+static int sink_open(TeeSink *sink)
+{
+	AVFormatContext *ctx = sink->fmt_ctx;
+	char errorBuff[80];
+	std::string fifo;
+	int ret = 0;
+
+	ctx->interrupt_callback.callback = sink_interrupt;
+	ctx->interrupt_callback.opaque = sink;
+	// Opened here and not by tee_open(): a FIFO waits for its reader
+	if (!(ctx->oformat->flags & AVFMT_NOFILE) && sink_is_pipe(sink, &fifo)) {
+		ret = pipe_open(sink, fifo);
+		if (ret >= 0) {
+			sink->fd = ret;
+			uint8_t *buffer = (uint8_t *)av_malloc(avio_buffer_size);
+			ctx->pb = buffer ? avio_alloc_context(buffer, avio_buffer_size, 1, sink, NULL, pipe_write, NULL) : NULL;
+			if (!ctx->pb) {
+				av_free(buffer);
+				ret = AVERROR(ENOMEM);
+			}
+		}
+	}
+	else if (!(ctx->oformat->flags & AVFMT_NOFILE))
+		ret = avio_open2(&ctx->pb, sink->url.c_str(), AVIO_FLAG_WRITE, &ctx->interrupt_callback, NULL);
+	if (ret >= 0)
+		ret = avformat_write_header(ctx, NULL);
+	if (ret < 0)
+		log_message(LOG_LEVEL_ERROR, "Could not open tee output %s: %s, the other outputs go on\n", sink->url.c_str(), av_make_error_string(errorBuff, 80, ret));
+	else
+		log_message(LOG_LEVEL_INFO, "Tee output %s (%s)\n", sink->url.c_str(), ctx->oformat->name);
+	return ret;
+}
+
+static int sink_write(TeeSink *sink, AVPacket *packet)
+{
+	int index = sink->stream_map[packet->stream_index];
+	AVStream *stream = sink->fmt_ctx->streams[index];
+	int64_t &last_dts = sink->last_dts[index];
+
+	av_packet_rescale_ts(packet, sink->time_base[packet->stream_index], stream->time_base);
+	packet->stream_index = index;
+	// Two DTS of the main output can round to one in a coarser time base
+	if (packet->dts != AV_NOPTS_VALUE && last_dts != AV_NOPTS_VALUE && packet->dts <= last_dts) {
+		packet->dts = last_dts + 1;
+		if (packet->pts != AV_NOPTS_VALUE && packet->pts < packet->dts)
+			packet->pts = packet->dts;
+	}
+	if (packet->dts != AV_NOPTS_VALUE)
+		last_dts = packet->dts;
+
+	sink->bytes += packet->size;
+	return av_interleaved_write_frame(sink->fmt_ctx, packet);
+}
+
+static void sink_thread(TeeSink *sink)
+{
+	AVPacket *packet;
+	char errorBuff[80];
+
+	int ret = sink_open(sink);
+	bool opened = ret >= 0;
+	while (ret >= 0 && sink->queue.pop(packet, sink->closing)) {
+		ret = sink_write(sink, packet);
+		av_packet_free(&packet);
+		if (ret >= 0)
+			sink->packets++;
+		else
+			log_message(LOG_LEVEL_ERROR, "Tee output %s failed: %s, the other outputs go on\n", sink->url.c_str(), av_make_error_string(errorBuff, 80, ret));
+	}
+	if (opened && ret >= 0 && !sink->closing)
+		ret = av_write_trailer(sink->fmt_ctx);
+	if (ret < 0)
+		sink->failed = true;
+	sink->finished = true;
+}
+
+int tee_open(OutputUtils *out_state, const TranscodeOptions *opts)
+{
+	if (opts->tee_outputs.empty())
+		return 0;
+
+	const AVFormatContext *main_ctx = out_state->output_fmt_ctx;
+	TeeOutput *tee = new TeeOutput();
+	tee->video_index = out_state->output_stream->index;
+	out_state->tee = tee;
+
+	for (auto &spec : opts->tee_outputs) {
+		std::unique_ptr<TeeSink> sink(new TeeSink(spec));
+		avformat_alloc_output_context2(&sink->fmt_ctx, NULL, sink->format.empty() ? NULL : sink->format.c_str(), sink->url.c_str());
+		if (!sink->fmt_ctx) {
+			log_message(LOG_LEVEL_ERROR, "Could not deduce the format of tee output %s, leaving it out (use [f=<format>]).\n", sink->url.c_str());
+			continue;
+		}
+
+		// The streams of the main output after its header, with the time bases its packets carry
+		for (unsigned i = 0; i < main_ctx->nb_streams; ++i) {
+			const AVStream *main_stream = main_ctx->streams[i];
+			const AVCodecParameters *params = main_stream->codecpar;
+			sink->time_base.push_back(main_stream->time_base);
+			if (avformat_query_codec(sink->fmt_ctx->oformat, params->codec_id, FF_COMPLIANCE_NORMAL) == 0) {
+				log_message(LOG_LEVEL_WARNING, "%s cannot hold the %s stream, tee output %s goes on without it\n",
+					sink->fmt_ctx->oformat->name, avcodec_get_name(params->codec_id), sink->url.c_str());
+				sink->stream_map.push_back(-1);
+				continue;
+			}
+			AVStream *stream = avformat_new_stream(sink->fmt_ctx, NULL);
+			if (!stream || avcodec_parameters_copy(stream->codecpar, params) < 0)
+				return 1;
+			stream->codecpar->codec_tag = 0;
+			stream->time_base = main_stream->time_base;
+			sink->stream_map.push_back(stream->index);
+			sink->last_dts.push_back(AV_NOPTS_VALUE);
+		}
+		if (sink->stream_map[tee->video_index] < 0)
+			continue;
+
+		sink->thread = std::thread(sink_thread, sink.get());
+		tee->sinks.push_back(std::move(sink));
+	}
+	return 0;
+}
+
+void tee_write(TeeOutput *tee, const AVPacket *packet)
+{
+	bool keyframe = packet->stream_index == tee->video_index && (packet->flags & AV_PKT_FLAG_KEY);
+
+	for (auto &entry : tee->sinks) {
+		TeeSink *sink = entry.get();
+		if (sink->failed || sink->stream_map[packet->stream_index] < 0)
+			continue;
+		// A sink starts, and after a full queue goes on, with a decodable GOP
+		if (sink->keyframe_wait && !keyframe) {
+			if (sink->queued)
+				sink->dropped++;
+			continue;
+		}
+
+		// A reference, every sink shares the data of the encoded packet
+		AVPacket *reference = av_packet_clone(packet);
+		if (reference && sink->queue.try_push(reference)) {
+			sink->keyframe_wait = false;
+			sink->queued++;
+			continue;
+		}
+		av_packet_free(&reference);
+		sink->dropped++;
+		if (!sink->keyframe_wait)
+			log_message(sink->dropped == 1 ? LOG_LEVEL_WARNING : LOG_LEVEL_DEBUG,
+				"Tee output %s is %zu packets behind, dropping up to the next keyframe\n", sink->url.c_str(), sink->queue.capacity());
+		sink->keyframe_wait = true;
+	}
+}
+
+void tee_close(OutputUtils *out_state)
+{
+	TeeOutput *tee = out_state->tee;
+	if (!tee)
+		return;
+
+	// Every sink writes what is queued and its trailer, one still busy after
+	// the linger time is interrupted
+	for (auto &sink : tee->sinks)
+		sink->queue.close();
+	auto deadline = std::chrono::steady_clock::now() + linger_time;
+	for (auto &sink : tee->sinks) {
+		while (!sink->finished && std::chrono::steady_clock::now() < deadline)
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		if (!sink->finished)
+			sink->closing = true;
+		sink->thread.join();
+	}
+	delete tee;
+	out_state->tee = NULL;
+}
+
+void tee_report(const TeeOutput *tee)
+{
+	for (auto &sink : tee->sinks)
+		log_message(LOG_LEVEL_INFO, "Tee %s: %llu packets, %.2f MB, %llu dropped%s\n", sink->url.c_str(),
+			(unsigned long long)sink->packets.load(), sink->bytes.load() / 1e6,
+			(unsigned long long)sink->dropped.load(), sink->failed ? ", failed" : "");
+}
@@ -11,57 +11,51 @@
  */
 
 #include "../include/transcoder.hpp"
-
-
-volatile sig_atomic_t stop; // signal.h variable
-int ret;                    // return values of the functions
-char errorBuff[80];         // error string buffer  
-int video_stream_idx;       // video stream index
-
-// Time calculation based variables
-struct timespec start_time, end_time; 
-double total_elapsed;
-double avg_elapsed;
-
-void inthand(int signum) {
-    stop = 1;
+#include "../include/pipeline.hpp"
+#include "../include/logger.hpp"
+#include "../include/segmenter.hpp"
+#include "../include/probe_cache.hpp"
+#include "../include/aux_streams.hpp"
+#include "../include/async_writer.hpp"
+#include "../include/tee_output.hpp"
+#include <memory>
+#include <cstring>
+
+
+// The application decides what stops an input: Ctrl+C, RtspSession::stop() ...
+bool input_stopped(const InputUtils *in_state)
+{
+	return in_state->stop_request && in_state->stop_request->load();
 }
 
-void start_timer(){
-    clock_gettime(CLOCK_REALTIME, &start_time);
+// Lets blocking input calls give up when stopped or once their deadline
+// passed, so a camera that silently stopped sending is noticed
+static int input_interrupt(void *opaque)
+{
+	const InputUtils *in_state = (const InputUtils *)opaque;
+	if (input_stopped(in_state))
+		return 1;
+	return in_state->io_deadline && (int64_t)latency_now() > in_state->io_deadline;
 }
 
-void stop_timer(bool error=false)
+void input_arm_timeout(InputUtils *in_state)
 {
-	// Stop measuring time and calculate the elapsed time
-    clock_gettime(CLOCK_REALTIME, &end_time);
-	double elapsed;
-    long seconds;
-	long nanoseconds;
-
-	seconds = end_time.tv_sec - start_time.tv_sec;
-	nanoseconds = end_time.tv_nsec - start_time.tv_nsec;
-	
-	if (error) {
-		elapsed = 0;
-		total_elapsed += 0;
-		printf(", Error occured.. Time measured: %.3f ms.\n", elapsed);
-	}
-	else {
-		elapsed = seconds + nanoseconds*1e-9;
-		total_elapsed += elapsed*1000;
-		printf(", Time measured: %.3f ms.\n", elapsed*1000);
-	}
-}	
-
+	in_state->io_deadline = in_state->io_timeout ? latency_now() + in_state->io_timeout : 0;
+}
 
-int open_input_stream(InputUtils *in_state, const char *input_filename) 
+// hint, when set, holds the parameters of an earlier open and shortens the probe
+int open_input_stream(InputUtils *in_state, const char *input_filename, const ProbeInfo *hint) 
 {
 	// Liniking variables
 	auto &input_fmt_ctx = in_state->input_fmt_ctx;
+	uint64_t start = latency_now();
+	int ret;
 
     //Allocate context for input stream
     input_fmt_ctx = avformat_alloc_context();
+	input_fmt_ctx->interrupt_callback.callback = input_interrupt;
+	input_fmt_ctx->interrupt_callback.opaque = in_state;
+	input_arm_timeout(in_state);
 
 	AVDictionary *open_opts = NULL;
     av_dict_set(&open_opts, "rtsp_transport", "tcp", 0);
@@ -69,31 +63,44 @@ int open_input_stream(InputUtils *in_state, const char *input_filename)
 	//Open the input stream and read its header
 	ret = avformat_open_input(&input_fmt_ctx, input_filename, NULL, &open_opts);
 	if (ret < 0) {
-	std::cout << "Couldn't open the stream.\n";
+	log_message(LOG_LEVEL_ERROR, "Couldn't open the stream.\n");
 	return EXIT_FAILURE;
 	}
 	
+	if (hint)
+		probe_info_apply(hint, input_fmt_ctx);
 	ret = avformat_find_stream_info(input_fmt_ctx, NULL);
+	if (hint && (ret < 0 || !probe_info_matches(hint, input_fmt_ctx))) {
+		log_message(LOG_LEVEL_INFO, "Input differs from its cached stream parameters, probing it fully\n");
+		avformat_close_input(&input_fmt_ctx);
+		return open_input_stream(in_state, input_filename, NULL);
+	}
 	if (ret < 0){
-		std::cout << "Couldn't find stream info.\n";
+		log_message(LOG_LEVEL_ERROR, "Couldn't find stream info.\n");
 		return 1;
    	}
+	in_state->io_deadline = 0;
+	in_state->probe_cached = hint != NULL;
+	log_message(LOG_LEVEL_INFO, "Opened the input in %.0f ms (%s probe)\n",
+		(latency_now() - start) / 1e6, hint ? "short" : "full");
 	av_dump_format(input_fmt_ctx, 0, input_filename, 0);
 
     return 0;
 }
 
 
-int setup_decoder(InputUtils *in_state) 
+int find_video_stream(InputUtils *in_state)
 {
 	// Linking Variables
 	auto &input_fmt_ctx = in_state->input_fmt_ctx;
 	auto &input_codec_params = in_state->input_codec_params;
 	auto &input_codec = in_state->input_codec;
 	auto &input_stream = in_state->input_stream;
-	auto &input_codec_ctx = in_state->input_codec_ctx;
+	auto &input_framerate = in_state->input_framerate;
+	auto &video_stream_idx = in_state->video_stream_idx;
     
 	// Finding and selecting the Video Stream
+	video_stream_idx = -1;
 	for (int i = 0; i < input_fmt_ctx->nb_streams; ++i) {
 		input_codec_params = input_fmt_ctx->streams[i]->codecpar;
 		input_codec = avcodec_find_decoder(input_codec_params->codec_id);
@@ -105,23 +112,59 @@ int setup_decoder(InputUtils *in_state)
 		}
 	}
 	if (video_stream_idx == -1) {
-		std::cout << "Couldn't find the video stream.\n";
+		log_message(LOG_LEVEL_ERROR, "Couldn't find the video stream.\n");
 		return EXIT_FAILURE;
 	}
+	input_framerate = av_guess_frame_rate(input_fmt_ctx, input_stream, NULL);
+	in_state->input_time_base = input_stream->time_base;
+
+    return 0;
+}
+
+// skip_frame AVDISCARD_NONKEY makes a keyframe only decoder, used for snapshots
+int setup_decoder(InputUtils *in_state, int threads, enum AVDiscard skip_frame) 
+{
+	// Linking Variables
+	auto &input_codec_params = in_state->input_codec_params;
+	auto &input_codec = in_state->input_codec;
+	auto &input_codec_ctx = in_state->input_codec_ctx;
 
 	// Setting up the codec context for the decoder
 	input_codec_ctx = avcodec_alloc_context3(input_codec);
 	avcodec_parameters_to_context(input_codec_ctx, input_codec_params);
+	if (threads > 0)
+		input_codec_ctx->thread_count = threads;
+	input_codec_ctx->skip_frame = skip_frame;
+
+	// Decoded pictures come from a pool sized for the stream resolution
+	in_state->frame_buffer_pool = new FrameBufferPool();
+	frame_buffer_pool_attach(input_codec_ctx, in_state->frame_buffer_pool);
 	
 	// Opening the codec for decoding
 	if (avcodec_open2(input_codec_ctx, input_codec, NULL) < 0 ) {
-		std::cout << "Couldn't open decoder\n";
+		log_message(LOG_LEVEL_ERROR, "Couldn't open decoder\n");
 		return EXIT_FAILURE;
 	}
 
     return 0;
 }
 
+// Resolves a requested picture size: 0 keeps the input size, -1 on one side
+// follows the input aspect ratio, rounded to the even sizes 4:2:0 needs
+void scaled_size(int input_width, int input_height, int *width, int *height)
+{
+	if (*width < 0 && *height > 0)
+		*width = (int)av_rescale(*height, input_width, input_height) & ~1;
+	else if (*height < 0 && *width > 0)
+		*height = (int)av_rescale(*width, input_height, input_width) & ~1;
+	if (*width <= 0)
+		*width = input_width;
+	if (*height <= 0)
+		*height = input_height;
+}
+
+// An empty output_filename writes no file, the packets only go to the sink of
+// an embedding application
 int setup_output_stream(OutputUtils *out_state, const char *output_filename)
 {
 	//Linking Variables
@@ -129,206 +172,527 @@ int setup_output_stream(OutputUtils *out_state, const char *output_filename)
 	auto &output_stream = out_state->output_stream;
 
     // Allocating context for output file plus guessing the output file format
-	avformat_alloc_output_context2(&output_fmt_ctx, NULL, NULL, output_filename);
+	if (!*output_filename)
+		avformat_alloc_output_context2(&output_fmt_ctx, NULL, "null", NULL);
+	else
+		avformat_alloc_output_context2(&output_fmt_ctx, NULL, NULL, output_filename);
 	if (!output_fmt_ctx) {
-		printf("Could not deduce output format from file extension: using MP4.\n");
+		log_message(LOG_LEVEL_WARNING, "Could not deduce output format from file extension: using MP4.\n");
 		avformat_alloc_output_context2(&output_fmt_ctx, NULL, "mp4", output_filename);
 	}
     if (!output_fmt_ctx)
         return 1;
 
     output_stream = avformat_new_stream(output_fmt_ctx, NULL);
+	out_state->copy_ts_offset = AV_NOPTS_VALUE;
+	out_state->last_dts = AV_NOPTS_VALUE;
 
     return 0;
 }
 
-int setup_encoder(InputUtils *in_state, OutputUtils *out_state)
+bool use_stream_copy(InputUtils *in_state, const TranscodeOptions *opts)
+{
+	if (opts->copy_mode == COPY_ALWAYS)
+		return true;
+	if (opts->copy_mode == COPY_NEVER)
+		return false;
+	// Renditions and a resized output are encoded from the decoded frames
+	if (!opts->renditions.empty() || opts->width != 0 || opts->height != 0)
+		return false;
+
+	// Re-encoding to the codec the camera already sends only burns CPU
+	const AVCodec *encoder = avcodec_find_encoder_by_name(opts->encoder_name);
+	return encoder && encoder->id == in_state->input_codec_params->codec_id;
+}
+
+int setup_stream_copy(InputUtils *in_state, OutputUtils *out_state)
+{
+	// Linking variables
+	auto &input_stream = in_state->input_stream;
+	auto &input_codec_params = in_state->input_codec_params;
+	auto &output_stream = out_state->output_stream;
+	char errorBuff[80];
+
+	// Packets are passed through untouched, so the output stream simply
+	// takes over the codec parameters (and extradata) of the input
+	int ret = avcodec_parameters_copy(output_stream->codecpar, input_codec_params);
+	if (ret < 0) {
+		log_message(LOG_LEVEL_ERROR, "Could not copy codec parameters.\n%s\n", av_make_error_string(errorBuff, 80, ret));
+		return 1;
+	}
+	output_stream->codecpar->codec_tag = 0;   // let the muxer pick the tag of its container
+	output_stream->time_base = input_stream->time_base;
+
+	out_state->packet_time_base = input_stream->time_base;
+
+	log_message(LOG_LEVEL_INFO, "Stream copy: passing %s packets through without re-encoding.\n", avcodec_get_name(input_codec_params->codec_id));
+	return 0;
+}
+
+EncoderSettings main_encoder_settings(const TranscodeOptions *opts)
+{
+	return {opts->encoder_name, opts->width, opts->height, opts->crf, opts->preset, opts->codec_threads};
+}
+
+// Creates and opens the encoder only, also used to reopen it with other settings mid-stream
+int open_encoder(InputUtils *in_state, OutputUtils *out_state, const EncoderSettings *settings)
 {
 	// Linking variables
 	auto &input_framerate = in_state->input_framerate;
-	auto &input_fmt_ctx = in_state->input_fmt_ctx;
 	auto &input_codec_ctx = in_state->input_codec_ctx;
-	auto &input_stream = in_state->input_stream;
-	auto &input_codec = in_state->input_codec;
 	auto &output_codec = out_state->output_codec;
 	auto &output_codec_ctx = out_state->output_codec_ctx;
-	auto &output_stream = out_state->output_stream;
 	auto &output_fmt_ctx = out_state->output_fmt_ctx;
+	char errorBuff[80];
+	int ret;
     
     // Defining and setting up the encoder for output stream
 	// output_codec = avcodec_find_encoder(input_codec_ctx->codec_id);
-	output_codec = avcodec_find_encoder_by_name("libx264"); // x265 not supported always, x264 most versatile
+	output_codec = avcodec_find_encoder_by_name(settings->encoder_name); // x265 not supported always, x264 most versatile
 
 	if (output_codec == NULL) {
-		std::cout << "Could not find encoder the input stream using codec: " << avcodec_get_name(input_codec_ctx->codec_id) << std::endl;
+		log_message(LOG_LEVEL_ERROR, "Could not find encoder the input stream using codec: %s\n", avcodec_get_name(input_codec_ctx->codec_id));
         return 1;
     }
 	output_codec_ctx = avcodec_alloc_context3(output_codec);
+	if (settings->threads > 0)
+		output_codec_ctx->thread_count = settings->threads;
     
-    output_codec_ctx->height = input_codec_ctx->height;
-    output_codec_ctx->width = input_codec_ctx->width;
-	if (input_codec->pix_fmts)
-        output_codec_ctx->pix_fmt = output_codec->pix_fmts[0];
+    output_codec_ctx->height = settings->height > 0 ? settings->height : input_codec_ctx->height;
+    output_codec_ctx->width = settings->width > 0 ? settings->width : input_codec_ctx->width;
+	// The format of the encoder closest to what the decoder delivers, often the
+	// same one so the frames need no conversion (see FrameConverter)
+	if (output_codec->pix_fmts)
+        output_codec_ctx->pix_fmt = avcodec_find_best_pix_fmt_of_list(output_codec->pix_fmts, input_codec_ctx->pix_fmt, 0, NULL);
     else
         output_codec_ctx->pix_fmt = input_codec_ctx->pix_fmt;
 
 	// time base
-	input_framerate = av_guess_frame_rate(input_fmt_ctx, input_stream, NULL);
     output_codec_ctx->time_base = av_inv_q(input_framerate);
-    output_stream->time_base = output_codec_ctx->time_base;
-	
+
+    // disables the scene change detection and fix GOP on encoder_gop_size frames
+	char codec_priv_value[64];
+	snprintf(codec_priv_value, sizeof(codec_priv_value), "keyint=%d:min-keyint=%d:scenecut=0%s", encoder_gop_size, encoder_gop_size,
+		settings->repeat_headers ? ":repeat-headers=1" : "");
 
     // Setting options for encoder
 	if (output_codec_ctx->codec_id == AV_CODEC_ID_H265) {
 		const char *codec_priv_key = "x265-params";
-		// disables the scene change detection and fix GOP on 60 frames
-		const char *codec_priv_value = "keyint=60:min-keyint=60:scenecut=0";
 		av_opt_set(output_codec_ctx->priv_data, codec_priv_key, codec_priv_value, 0);
 		// crf range 0-51, 0 for lossless best quality, 51 for lossy worst quality, 28 is default
-		av_opt_set(output_codec_ctx->priv_data, "crf", "28", AV_OPT_SEARCH_CHILDREN);
+		av_opt_set(output_codec_ctx->priv_data, "crf", settings->crf ? settings->crf : "28", AV_OPT_SEARCH_CHILDREN);
 		av_opt_set(output_codec_ctx->priv_data, "tune", "zerolatency", 0);
-		av_opt_set(output_codec_ctx->priv_data, "preset", "veryfast", 0);
+		av_opt_set(output_codec_ctx->priv_data, "preset", settings->preset ? settings->preset : "veryfast", 0);
 	}
 	else if (output_codec_ctx->codec_id == AV_CODEC_ID_H264){
 		const char *codec_priv_key = "x264-params";
-		const char *codec_priv_value = "keyint=60:min-keyint=60:scenecut=0";
 		av_opt_set(output_codec_ctx->priv_data, codec_priv_key, codec_priv_value, 0);
 		// crf range 0-51, 0 for lossless best quality, 51 for lossy worst quality, 23 is default
-		av_opt_set(output_codec_ctx->priv_data, "crf", "23", AV_OPT_SEARCH_CHILDREN);
+		av_opt_set(output_codec_ctx->priv_data, "crf", settings->crf ? settings->crf : "23", AV_OPT_SEARCH_CHILDREN);
 		av_opt_set(output_codec_ctx->priv_data, "tune", "zerolatency", 0);
-		av_opt_set(output_codec_ctx->priv_data, "preset", "veryfast", 0);
+		av_opt_set(output_codec_ctx->priv_data, "preset", settings->preset ? settings->preset : "veryfast", 0);
+	}
+	else {
+		if (settings->crf)
+			av_opt_set(output_codec_ctx->priv_data, "crf", settings->crf, AV_OPT_SEARCH_CHILDREN);
+		if (settings->preset)
+			av_opt_set(output_codec_ctx->priv_data, "preset", settings->preset, 0);
 	}
 	// Some formats want stream headers to be separate.
 	if (output_fmt_ctx->oformat->flags & AVFMT_GLOBALHEADER)
   		output_fmt_ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
 
-    // filling codec parameters of the output stream based on output codec context
-	avcodec_parameters_from_context(output_stream->codecpar, output_codec_ctx);
-
     // Open the output_codec for encoding (encoder)
 	ret = avcodec_open2(output_codec_ctx, output_codec, NULL);
 	if (ret < 0) {
-		std::cout << "Could not open video codec (encoder).\n" << av_make_error_string(errorBuff,80,ret) << std::endl;
+		log_message(LOG_LEVEL_ERROR, "Could not open video codec (encoder).\n%s\n", av_make_error_string(errorBuff, 80, ret));
 		return 1;
 	}
 
     return 0;
 }
 
+int setup_encoder(InputUtils *in_state, OutputUtils *out_state, const EncoderSettings *settings)
+{
+	// Linking variables
+	auto &output_codec_ctx = out_state->output_codec_ctx;
+	auto &output_stream = out_state->output_stream;
+
+	if (open_encoder(in_state, out_state, settings) != 0)
+		return 1;
+
+    output_stream->time_base = output_codec_ctx->time_base;
+    out_state->packet_time_base = in_state->input_stream->time_base;
+
+    // filling codec parameters of the output stream based on output codec context
+	avcodec_parameters_from_context(output_stream->codecpar, output_codec_ctx);
+
+    return 0;
+}
+
+// A plain MP4 keeps the index of every sample in memory until the trailer and
+// is unplayable without it. Fragmented, each GOP goes out as a moof/mdat pair,
+// the muxer only holds the current fragment and the trailer is a small index.
+void setup_muxer_options(OutputUtils *out_state, const TranscodeOptions *opts)
+{
+	const char *name = out_state->output_fmt_ctx->oformat->name;
+
+	out_state->writer = &opts->writer;
+	if (!opts->fragmented)
+		return;
+	if (strcmp(name, "mp4") && strcmp(name, "mov")) {
+		log_message(LOG_LEVEL_WARNING, "Fragments need an MP4 or MOV output, writing %s as usual\n", name);
+		return;
+	}
+	av_dict_set(&out_state->muxer_options, "movflags", "+frag_keyframe+empty_moov+default_base_moof", 0);
+	// With frag_keyframe a fragment starts on the first keyframe after this
+	if (opts->fragment_time > 0)
+		av_dict_set_int(&out_state->muxer_options, "min_frag_duration", (int64_t)(opts->fragment_time * AV_TIME_BASE), 0);
+	out_state->fragmented = true;
+}
+
 int open_output_stream(OutputUtils *out_state, const char *output_filename) 
 {
 	// Linking Variables
 	auto &output_fmt_ctx = out_state->output_fmt_ctx;
+	char errorBuff[80];
+	int ret;
 
 	// print the output stream information in termina;
     av_dump_format(output_fmt_ctx, 0, output_filename, 1);
     	
 	// open the output file
     if (!(output_fmt_ctx->flags & AVFMT_NOFILE)) {
-        ret = avio_open(&output_fmt_ctx->pb, output_filename, AVIO_FLAG_WRITE);
-        if (ret < 0) {
-            std::cout << "Could not open outputfile" << av_make_error_string(errorBuff, 80, ret) << std::endl;
-            return 1;
-        }
+		// Local files are written by a thread of their own, the muxer never waits on the disk
+		if (out_state->writer && out_state->writer->async && async_writer_usable(output_filename)) {
+			if (async_writer_open(out_state, output_filename) != 0)
+				return 1;
+		}
+		else {
+			ret = avio_open(&output_fmt_ctx->pb, output_filename, AVIO_FLAG_WRITE);
+			if (ret < 0) {
+				log_message(LOG_LEVEL_ERROR, "Could not open outputfile %s\n", av_make_error_string(errorBuff, 80, ret));
+				return 1;
+			}
+		}
     }
-	ret = avformat_write_header(output_fmt_ctx, NULL);
-	if (ret < 0) 
-		std::cout << "Error occured when writing header" << av_make_error_string(errorBuff, 80, ret) << std::endl;
+	AVDictionary *options = NULL;
+	av_dict_copy(&options, out_state->muxer_options, 0);
+	ret = avformat_write_header(output_fmt_ctx, &options);
+	// What the muxer left in the dictionary it does not know, a mistyped flag would go unnoticed
+	const AVDictionaryEntry *entry = NULL;
+	while ((entry = av_dict_get(options, "", entry, AV_DICT_IGNORE_SUFFIX)))
+		log_message(LOG_LEVEL_WARNING, "%s ignored the muxer option %s=%s\n", output_fmt_ctx->oformat->name, entry->key, entry->value);
+	av_dict_free(&options);
+	if (ret < 0) {
+		log_message(LOG_LEVEL_ERROR, "Error occured when writing header %s\n", av_make_error_string(errorBuff, 80, ret));
+		close_output_file(out_state);
+		return 1;
+	}
 
     return 0;
 }
 
-int encode(InputUtils *in_state, OutputUtils *out_state, bool flush=false) 
+int decode(InputUtils *in_state, AVPacket *packet, Pipeline *pipeline)
 {
-	// Linking variable
+	// Linking variables
+	auto &input_codec_ctx = in_state->input_codec_ctx;
 	auto &input_frame = in_state->input_frame;
-	auto &input_stream = in_state->input_stream;
-	auto &output_fmt_ctx = out_state->output_fmt_ctx;
-	auto &output_codec_ctx = out_state->output_codec_ctx;
-	auto &output_stream = out_state->output_stream;
-	
-	if (flush) {
-		input_frame = NULL;
+	char errorBuff[80];
+
+	// Decoder time of this packet, the hand over to the encoder is not counted
+	uint64_t elapsed = 0;
+	uint64_t start = latency_now();
+
+	// Falling behind real time, the decoder skips the frames nothing refers to
+	Backpressure *backpressure = pipeline->backpressure.get();
+	if (backpressure)
+		input_codec_ctx->skip_frame = backpressure_skip_frame(backpressure);
+	// Counted from the bitstream: a packet without a picture may just be decoder delay
+	if (backpressure && packet && input_codec_ctx->skip_frame == AVDISCARD_NONREF &&
+			backpressure_nonref_packet(input_codec_ctx, packet))
+		backpressure->nonref_skipped++;
+
+	// A NULL packet drains the frames still buffered in the decoder
+	int ret = avcodec_send_packet(input_codec_ctx, packet);
+	if (ret < 0) {
+		log_message(LOG_LEVEL_ERROR, "Error sending packet to decoder: %s\n", av_make_error_string(errorBuff, 80, ret));
+		return ret;
 	}
+	while (ret >= 0) {
+		ret = avcodec_receive_frame(input_codec_ctx, input_frame);
+		if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+			break;
+		}
+		else if (ret < 0) {
+			log_message(LOG_LEVEL_ERROR, "Error in decoding process: %s\n", av_make_error_string(errorBuff, 80, ret));
+			return ret;
+		}
+		elapsed += latency_now() - start;
+
+		if (pipeline->frame_sink)
+			pipeline->frame_sink(input_frame);
+		if (pipeline->shm)
+			shm_publish_frame(pipeline->shm.get(), input_frame);
+
+		// hand the decoded picture over to the encoder thread, input_frame is reused
+		AVFrame *frame = pipeline->frame_pool.get();
+		av_frame_move_ref(frame, input_frame);
+		ret = pipeline_push_frame(pipeline, frame);
+		start = latency_now();
+	}
+	if (packet)
+		pipeline->latency[STAGE_DECODE].record(elapsed + latency_now() - start);
+	return (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) ? 0 : ret;
+}
+
+int encode(InputUtils *in_state, OutputUtils *out_state, AVFrame *frame, Pipeline *pipeline)
+{
+	// Linking variable
+	auto &output_codec_ctx = out_state->output_codec_ctx;
+
+	// Encoder time of this frame, the hand over to the muxer is not counted
+	uint64_t elapsed = 0;
+	uint64_t start = latency_now();
+
+	// A NULL frame flushes the encoder
+	int ret = avcodec_send_frame(output_codec_ctx, frame);
 
-    AVPacket *output_packet = av_packet_alloc();
-	ret = avcodec_send_frame(output_codec_ctx, input_frame);
-    
     while (ret >= 0) {
+        AVPacket *output_packet = pipeline->packet_pool.get();
 
         ret = avcodec_receive_packet(output_codec_ctx, output_packet);
         if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            pipeline->packet_pool.put(output_packet);
             break;
         } else if (ret < 0) {
-			stop_timer(true);
-			std::cout << "Error in encoding process.";
-            return EXIT_FAILURE;
+            pipeline->packet_pool.put(output_packet);
+			log_message(LOG_LEVEL_ERROR, "Error in encoding process.\n");
+            return ret;
         }
+		elapsed += latency_now() - start;
 		
-		std::cout <<"\nWriting frame number: " << output_codec_ctx->frame_number ;
+		log_message(LOG_LEVEL_DEBUG, "Writing frame number: %d\n", output_codec_ctx->frame_number);
 
-        output_packet->stream_index = video_stream_idx;
-		output_packet->duration = av_rescale_q(output_packet->duration, output_codec_ctx->time_base, input_stream->time_base);
+		// Timestamps stay in the input time base, write_packet() rescales them
+		output_packet->duration = av_rescale_q(output_packet->duration, output_codec_ctx->time_base, in_state->input_time_base);
         
-		av_packet_rescale_ts(output_packet, input_stream->time_base, output_stream->time_base);
-        ret = av_interleaved_write_frame(output_fmt_ctx, output_packet);
+        ret = pipeline_push_packet(pipeline, output_packet);
+        start = latency_now();
     }
-    av_packet_unref(output_packet);
-    av_packet_free(&output_packet);
-    return 0;
+    if (frame) {
+        elapsed += latency_now() - start;
+        pipeline->latency[STAGE_ENCODE].record(elapsed);
+        if (pipeline->encoder_control)
+            encoder_control_frame(pipeline->encoder_control.get(), out_state, elapsed);
+    }
+    return (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) ? 0 : ret;
+}
+
+int rebase_packet(InputUtils *in_state, OutputUtils *out_state, AVPacket *packet)
+{
+	// Linking variables
+	auto &ts_offset = out_state->copy_ts_offset;
+
+	// Nothing before the first keyframe can be decoded by a player
+	if (ts_offset == AV_NOPTS_VALUE) {
+		if (!(packet->flags & AV_PKT_FLAG_KEY))
+			return AVERROR(EAGAIN);
+		ts_offset = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+	}
+
+	// Shift the camera clock so the recording starts at zero
+	if (packet->pts != AV_NOPTS_VALUE)
+		packet->pts -= ts_offset;
+	if (packet->dts != AV_NOPTS_VALUE)
+		packet->dts -= ts_offset;
+	packet->pos = -1;
+	return 0;
 }
 
-int transcode(InputUtils *in_state, OutputUtils *out_state)
+int write_packet(OutputUtils *out_state, AVPacket *packet)
+{
+	// Linking variables
+	auto &last_dts = out_state->last_dts;
+	char errorBuff[80];
+	int ret;
+
+	// A failed segment cut left no file to write to
+	if (out_state->trailer_written)
+		return AVERROR(EIO);
+	// Segment boundaries are decided on the packet's own clock, before rescaling
+	if (out_state->segmenter) {
+		ret = segmenter_check(out_state, packet);
+		if (ret < 0)
+			return ret;
+	}
+
+	// Looked up here and not by the encoder: a segment cut replaces the output stream
+	auto &output_stream = out_state->output_stream;
+	packet->stream_index = output_stream->index;
+	av_packet_rescale_ts(packet, out_state->packet_time_base, output_stream->time_base);
+
+	// Muxers refuse non increasing DTS, nudge the odd late packet forward
+	if (packet->dts != AV_NOPTS_VALUE && last_dts != AV_NOPTS_VALUE && packet->dts <= last_dts) {
+		packet->dts = last_dts + 1;
+		if (packet->pts != AV_NOPTS_VALUE && packet->pts < packet->dts)
+			packet->pts = packet->dts;
+	}
+	if (packet->dts != AV_NOPTS_VALUE)
+		last_dts = packet->dts;
+
+	// Before the muxer takes the packet, a failed write to the main output leaves the sinks alone
+	if (out_state->tee)
+		tee_write(out_state->tee, packet);
+
+	// A keyframe closes the previous fragment, pushing it to the kernel keeps
+	// the file playable up to there even if the process gets killed
+	bool flush = out_state->fragmented && (packet->flags & AV_PKT_FLAG_KEY);
+	ret = av_interleaved_write_frame(out_state->output_fmt_ctx, packet);
+	if (ret < 0)
+		log_message(LOG_LEVEL_ERROR, "Error muxing packet: %s\n", av_make_error_string(errorBuff, 80, ret));
+	else if (flush && out_state->output_fmt_ctx->pb)
+		avio_flush(out_state->output_fmt_ctx->pb);
+	if (ret >= 0 && out_state->start_time) {
+		log_message(LOG_LEVEL_INFO, "Time to first frame: %.0f ms after opening the input\n", (latency_now() - out_state->start_time) / 1e6);
+		out_state->start_time = 0;
+	}
+	return ret;
+}
+
+// latency, when set, receives the STAGE_COUNT stage histograms of the run
+int transcode(InputUtils *in_state, OutputUtils *out_state, const TranscodeOptions *opts,
+		LatencySnapshot latency[])
 {
 	auto &input_frame = in_state->input_frame;
-	auto &input_fmt_ctx = in_state->input_fmt_ctx;
-	auto &input_codec_ctx = in_state->input_codec_ctx;
 	auto &input_packet = in_state->input_packet;
 	
 	input_frame = av_frame_alloc();
 	input_packet = av_packet_alloc();
 
-	while (!stop) {
-		start_timer();
-		
-		ret = av_read_frame(input_fmt_ctx, input_packet);
-		if (ret < 0)
-			break;
-		if (input_packet->stream_index != video_stream_idx) {
+	std::unique_ptr<Pipeline> pipeline(new Pipeline(in_state, out_state, opts));
+	if (pipeline_setup(pipeline.get()) != 0)
+		return EXIT_FAILURE;
+	int ret = pipeline_run(pipeline.get());
+	pipeline_report(pipeline.get(), false);
+	if (latency)
+		for (int stage = 0; stage < STAGE_COUNT; ++stage)
+			pipeline->latency[stage].snapshot(&latency[stage]);
 
-			av_packet_unref(input_packet);
-			continue;
-		}
-        ret = avcodec_send_packet(input_codec_ctx, input_packet);
-        if (ret < 0) {
-            std::cerr << "Error sending packet to decoder: " << av_make_error_string(errorBuff, 80, ret) << std::endl;
-            return ret;
-        }
-        while (ret >= 0) {
-            ret = avcodec_receive_frame(input_codec_ctx, input_frame);
-            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
-				stop_timer(true);
-                break;
-            } 
-            else if (ret < 0) {
-                return ret;
-            }
-
-            if (ret >= 0) {
-				input_frame->pict_type = AV_PICTURE_TYPE_NONE;   // let encoder set the picture type by its own.
-                if (encode(in_state, out_state, false) != 0) 
-					return EXIT_FAILURE;
-            }
-			stop_timer();
-            av_frame_unref(input_frame);
-        }
-        av_packet_unref(input_packet);     
-    
-    }
+	return ret;
+}
 
+int setup_streams(InputUtils *in_state, OutputUtils *out_state, TranscodeOptions *opts,
+		const char *input_filename, const char *output_filename)
+{
+	// Parameters probed by an earlier run spare most of avformat_find_stream_info()
+	ProbeInfo cached;
+	const ProbeInfo *hint = NULL;
+	if (opts->probe_cache && probe_cache_load(opts->probe_cache, input_filename, &cached))
+		hint = &cached;
+
+	out_state->start_time = latency_now();
+	in_state->io_timeout = (int64_t)(opts->read_timeout * 1000000000);
+	if (open_input_stream(in_state, input_filename, hint) != 0){
+		return EXIT_FAILURE;
+	}
+	if (find_video_stream(in_state) != 0) {
+		return EXIT_FAILURE;
+	}
+	if (opts->probe_cache && !in_state->probe_cached)
+		probe_cache_store(opts->probe_cache, input_filename, in_state);
+	if (setup_output_stream(out_state, output_filename) != 0) {
+		return EXIT_FAILURE;
+	}
+	setup_muxer_options(out_state, opts);
+	opts->stream_copy = use_stream_copy(in_state, opts);
+	if (opts->stream_copy && opts->motion_detect)
+		log_message(LOG_LEVEL_WARNING, "Motion detection needs decoded frames, it is off in stream copy mode (use --encode).\n");
+	if (opts->stream_copy) {
+		if (setup_stream_copy(in_state, out_state) != 0) {
+			return EXIT_FAILURE;
+		}
+	}
+	else {
+		if (setup_decoder(in_state, opts->codec_threads, AVDISCARD_DEFAULT) != 0) {
+			return EXIT_FAILURE;
+		}
+		// Resolved once, the encoder is reopened with the same size by the adaptive controller
+		if (opts->width != 0 || opts->height != 0)
+			scaled_size(in_state->input_codec_ctx->width, in_state->input_codec_ctx->height, &opts->width, &opts->height);
+		EncoderSettings settings = main_encoder_settings(opts);
+		if (setup_encoder(in_state, out_state, &settings) != 0) {
+			return EXIT_FAILURE;
+		}
+	}
+	if (aux_streams_setup(in_state, out_state, opts) != 0) {
+		return EXIT_FAILURE;
+	}
+	// Segmented recording opens numbered files instead of output_filename
+	if (segmenter_enabled(opts)) {
+		if (segmenter_init(out_state, output_filename, opts) != 0) {
+			return EXIT_FAILURE;
+		}
+		output_filename = out_state->segmenter->filename.c_str();
+	}
+	if (open_output_stream(out_state, output_filename) != 0){
+		return EXIT_FAILURE;
+	}
+	// The sinks copy the streams of the main output, as its header left them
+	if (tee_open(out_state, opts) != 0) {
+		return EXIT_FAILURE;
+	}
 	return 0;
 }
 
+void print_output_size(const char *output_filename)
+{
+	// Calculating output video file size
+	std::error_code error;
+	std::uintmax_t size = std::experimental::filesystem::file_size(output_filename, error);
+	if (error)
+		return;
+	float new_size = size;
+	if (new_size/1000000 < 1) {
+		log_message(LOG_LEVEL_INFO, "\nOutput Video File size (%s): %.2f KB\n\n", output_filename, new_size/1000);
+	}
+	else {
+		log_message(LOG_LEVEL_INFO, "\nOutput Video File size (%s): %.2f MB\n\n", output_filename, new_size/1000000);
+	}
+}
+
+// After the trailer, the file of the current output context
+void close_output_file(OutputUtils *out_state)
+{
+	auto &output_fmt_ctx = out_state->output_fmt_ctx;
+
+	if (out_state->async_writer)
+		async_writer_close(out_state);
+	else if (!(output_fmt_ctx->oformat->flags & AVFMT_NOFILE))
+		avio_closep(&output_fmt_ctx->pb);
+}
+
+// Writes the trailer and frees the encoder and muxer of one output
+void close_output_stream(OutputUtils *out_state)
+{
+	// Linking Variables
+	auto &output_fmt_ctx = out_state->output_fmt_ctx;
+	auto &output_codec_ctx = out_state->output_codec_ctx;
+
+	if (!out_state->trailer_written) {
+		av_write_trailer(output_fmt_ctx);
+		close_output_file(out_state);
+	}
+	tee_close(out_state);
+	segmenter_finish(out_state);
+	aux_streams_free(out_state);
+	av_dict_free(&out_state->muxer_options);
+
+	avcodec_free_context(&output_codec_ctx);
+	avformat_free_context(output_fmt_ctx);
+	output_fmt_ctx = NULL;
+}
+
 void close_streams(InputUtils *in_state, OutputUtils *out_state) 
 {
 	// Linking Variables	
@@ -336,22 +700,38 @@ void close_streams(InputUtils *in_state, OutputUtils *out_state)
 	auto &input_fmt_ctx = in_state->input_fmt_ctx;
 	auto &input_codec_ctx = in_state->input_codec_ctx;
 	auto &input_packet = in_state->input_packet;
-	auto &output_fmt_ctx = out_state->output_fmt_ctx;
-	auto &output_codec_ctx = out_state->output_codec_ctx;
 
-	printf("\nAverage Frame Write Time: %.3f ms.\n", total_elapsed/((output_codec_ctx->frame_number)-1));
-	
-	// Flush encoder by giving NULL frame to signal the end of stream
-    encode(in_state, out_state, true);
-    std::cout << "\nClosing input and saving the data to container\n" << std::endl;
-	av_write_trailer(output_fmt_ctx);
+    // Encoder was already flushed by the pipeline
+    log_message(LOG_LEVEL_INFO, "\nClosing input and saving the data to container\n\n");
+	close_output_stream(out_state);
 
 	// Closing and freeing the memory
 	avcodec_free_context(&input_codec_ctx);
-    avcodec_free_context(&output_codec_ctx);
+	frame_buffer_pool_free(&in_state->frame_buffer_pool);
 	av_frame_free(&input_frame);
 	av_packet_free(&input_packet);
 	avformat_close_input(&input_fmt_ctx);
 	avformat_free_context(input_fmt_ctx);
-	avformat_free_context(output_fmt_ctx);
-}
\ No newline at end of file
+}
+
+// Frees what setup_streams() got to before it failed, nothing was written
+void free_streams(InputUtils *in_state, OutputUtils *out_state)
+{
+	if (out_state->output_fmt_ctx) {
+		close_output_file(out_state);
+		avformat_free_context(out_state->output_fmt_ctx);
+		out_state->output_fmt_ctx = NULL;
+	}
+	tee_close(out_state);
+	delete out_state->segmenter;
+	out_state->segmenter = NULL;
+	aux_streams_free(out_state);
+	av_dict_free(&out_state->muxer_options);
+	avcodec_free_context(&out_state->output_codec_ctx);
+
+	avcodec_free_context(&in_state->input_codec_ctx);
+	frame_buffer_pool_free(&in_state->frame_buffer_pool);
+	av_frame_free(&in_state->input_frame);
+	av_packet_free(&in_state->input_packet);
+	avformat_close_input(&in_state->input_fmt_ctx);
+}
@@ -0,0 +1,75 @@
+/**
+ * @Project : RTSP stream Transcoding and Storing using FFmpeg
+ * 
+ * @Brief   : Fixed size pool of worker threads shared by all camera sessions
+ * 
+ * @Created : 17-Oct-2026
+ * 
+ * @Updated : 17-Oct-2026
+ * 
+ * @Author  : Keshav Choudhary <keshav.choudhary0@gmail.com>
+ */
+
+#include "../include/worker_pool.hpp"
+
+
+WorkerPool::WorkerPool(unsigned threads)
+	: active(0), shutdown(false)
+{
+	if (threads == 0)
+		threads = std::thread::hardware_concurrency();
+	if (threads == 0)
+		threads = 1;
+
+	for (unsigned i = 0; i < threads; ++i)
+		workers.emplace_back(&WorkerPool::worker_loop, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		shutdown = true;
+	}
+	task_ready.notify_all();
+	for (auto &worker : workers)
+		worker.join();
+}
+
+void WorkerPool::submit(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		tasks.push_back(std::move(task));
+	}
+	task_ready.notify_one();
+}
+
+void WorkerPool::wait_idle()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	idle.wait(guard, [this] { return tasks.empty() && active == 0; });
+}
+
+void WorkerPool::worker_loop()
+{
+	std::unique_lock<std::mutex> guard(lock);
+
+	while (true) {
+		task_ready.wait(guard, [this] { return shutdown || !tasks.empty(); });
+		if (tasks.empty())
+			return;   // shutting down with nothing left to run
+
+		std::function<void()> task = std::move(tasks.front());
+		tasks.pop_front();
+		active++;
+
+		guard.unlock();
+		task();
+		guard.lock();
+
+		active--;
+		if (tasks.empty() && active == 0)
+			idle.notify_all();
+	}
+}